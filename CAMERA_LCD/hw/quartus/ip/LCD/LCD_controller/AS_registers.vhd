@@ -27,6 +27,7 @@ entity AS_registers is
 		AM_ctl_go 		: out std_logic;
 		AM_ctl_stop		: out std_logic;
 		AM_ctl_pause 	: out std_logic;
+		ST_enable 		: out std_logic; -- FIFO is written by the stream sink instead
 		-- status
 		AM_stat_done 	: in std_logic;
 		AM_stat_busy 	: in std_logic;
@@ -35,6 +36,11 @@ entity AS_registers is
 		AM_rd_len		: out std_logic_vector(31 downto 0);
 		AM_burstcount 	: out	std_logic_vector(6 downto 0);
 
+		-- camera display trigger, a completed frame to show
+		TRIG_go 			: in std_logic;
+		TRIG_address 	: in std_logic_vector(31 downto 0);
+		TRIG_busy 		: out std_logic; -- the frame is being read, the camera must keep it
+
 		-- Avalon Slace (AS) interface
 		address			: in std_logic_vector(2 downto 0);
 		write 			: in std_logic;
@@ -73,6 +79,8 @@ architecture AS of AS_registers is
 	signal LCD_cmd_en_r, LCD_cmd_en_n 		: std_logic;
 	signal LCD_data_en_r, LCD_data_en_n 	: std_logic;
 	signal state_r, state_n						: state_type;
+	signal trig_pend_r, trig_pend_n 			: std_logic; -- go held until master_control starts
+	signal busy_prev_r, busy_prev_n 			: std_logic;
 
 begin
 	-----------------------------------------------------------------------------
@@ -86,9 +94,11 @@ begin
 	LCD_cmd_en 	<= LCD_cmd_en_r;
 	LCD_data_en <= LCD_data_en_r;
 	-- master control
-	AM_ctl_go 		<= iReg_control_r(0);
+	AM_ctl_go 		<= iReg_control_r(0) or trig_pend_r;
+	TRIG_busy 		<= trig_pend_r or AM_stat_busy;
 	AM_ctl_stop 	<= iReg_control_r(1);
 	AM_ctl_pause 	<= iReg_control_r(2);
+	ST_enable 		<= iReg_control_r(3);
 	AM_rd_add 		<= iReg_readdadress_r;
 	AM_rd_len		<= iReg_length_r;
 	AM_burstcount 	<= iReg_burstcount_r(6 downto 0);
@@ -110,6 +120,8 @@ begin
 			LCD_cmd_en_r 			<= '0';
 			LCD_data_en_r 			<= '0';
 			state_r					<= IDLE;
+			trig_pend_r 			<= '0';
+			busy_prev_r 			<= '0';
 		elsif rising_edge(clk) then
 			iReg_readdadress_r	<= iReg_readdadress_n after 1 ns;
 			iReg_length_r			<= iReg_length_n after 1 ns;
@@ -123,12 +135,14 @@ begin
 			LCD_cmd_en_r 			<= LCD_cmd_en_n after 1 ns;
 			LCD_data_en_r 			<= LCD_data_en_n after 1 ns;
 			state_r					<= state_n after 1 ns;
+			trig_pend_r 			<= trig_pend_n after 1 ns;
+			busy_prev_r 			<= busy_prev_n after 1 ns;
 		end if;
 	end process;
 
 	-----------------------------------------------------------------------------
 	-- next-state logic
-	NSL : process(state_r, readdata_r, address, read, write, LCD_ack, AM_stat_done, AM_stat_busy)
+	NSL : process(state_r, readdata_r, address, read, write, LCD_ack, AM_stat_done, AM_stat_busy, TRIG_go, TRIG_address, trig_pend_r, busy_prev_r)
 	begin
 		-- default assignment 
 		iReg_readdadress_n	<= iReg_readdadress_r;
@@ -146,7 +160,19 @@ begin
 		iReg_status_n(0)		<= AM_stat_done;
 		iReg_status_n(1)		<= AM_stat_busy;
 		iReg_status_n(2)		<= LCD_ack;
-		iReg_status_n(31 downto 3) <= iReg_status_r(31 downto 3); -- unused bits
+		iReg_status_n(3)		<= trig_pend_r;
+		iReg_status_n(31 downto 4) <= iReg_status_r(31 downto 4); -- unused bits
+
+		-- display trigger, enabled by CONTROL bit 4. A frame completed while
+		-- the previous one is still read replaces it, the newest one is shown
+		busy_prev_n <= AM_stat_busy;
+		trig_pend_n <= trig_pend_r;
+		if TRIG_go = '1' and iReg_control_r(4) = '1' then
+			iReg_readdadress_n 	<= TRIG_address;
+			trig_pend_n 			<= '1';
+		elsif AM_stat_busy = '1' and busy_prev_r = '0' then -- transfer started
+			trig_pend_n 			<= '0';
+		end if;
 
 		case state_r is
 			when IDLE => 
@@ -33,6 +33,19 @@ entity LCD_controller_top is
 		AM_readdata 				: in std_logic_vector(31 downto 0);
 		AM_waitrequest 			: in std_logic;
 
+		-- Avalon Streaming (ST) sink, camera preview, ready latency 0, one
+		-- packet per frame
+		ST_data 				: in std_logic_vector(31 downto 0);
+		ST_valid 			: in std_logic;
+		ST_ready 			: out std_logic;
+		ST_startofpacket 	: in std_logic;
+		ST_endofpacket 	: in std_logic;
+
+		-- Conduit from the camera, starts the read of a completed frame
+		TRIG_go 			: in std_logic;
+		TRIG_address 	: in std_logic_vector(31 downto 0);
+		TRIG_busy 		: out std_logic;
+
 		-- Conduit to LT24 peripheral
 		LCD_CS_N 	: out std_logic;
 		LCD_RS 		: out std_logic;
@@ -61,6 +74,13 @@ architecture comp of LCD_controller_top is
 	);
 	end component;
 
+	-----------------------------------------------------------------------------
+	-- Stream sink states: words are discarded until the start of a frame, which
+	-- waits for the previous frame to be displayed and restarts the display at
+	-- its first pixel with a memory write command before it is taken
+	type ST_state_type is (ST_HUNT, ST_DRAIN, ST_CMD, ST_CMD_WAIT, ST_FIRST, ST_PASS);
+	constant CMD_MEM_WRITE : std_logic_vector(15 downto 0) := std_logic_vector(to_unsigned(16#002C#, 16));
+
 	-----------------------------------------------------------------------------
 	-- Internal signals ---------------------------------------------------------
 	-- AS_registers <=> LCD_controller interface
@@ -73,14 +93,27 @@ architecture comp of LCD_controller_top is
 	signal AM_go_i			: std_logic;
 	signal AM_stop_i		: std_logic;
 	signal AM_pause_i	 	: std_logic;
+	signal ST_enable_i 	: std_logic;
 	signal AM_done_i	 	: std_logic;
 	signal AM_busy_i	 	: std_logic;
 	signal AM_rd_add_i 	: std_logic_vector(31 downto 0);
 	signal AM_rd_len_i	: std_logic_vector(31 downto 0);
 	signal AM_burstcount_i : std_logic_vector(6 downto 0);
 	-- master_control <=> FIFO_LCD
+	signal AM_FIFO_data_i 	: std_logic_vector(31 downto 0);
+	signal AM_FIFO_wrreq_i	: std_logic;
+	-- FIFO_LCD write port, from master_control or from the ST sink
 	signal FIFO_data_i 	: std_logic_vector(31 downto 0);
 	signal FIFO_wrreq_i	: std_logic;
+	signal ST_ready_i 	: std_logic;
+	signal ST_state_reg, ST_state_next : ST_state_type;
+	signal ST_write_i 	: std_logic; -- a word of the frame goes to the FIFO
+	signal ST_flush_i 	: std_logic; -- a line left incomplete by a torn frame is read out
+	signal ST_cmd_i 		: std_logic; -- memory write command of a new frame
+	-- LCD_controller command, from AS_registers or from the ST sink
+	signal CTL_cmd_i 		: std_logic_vector(15 downto 0);
+	signal CTL_cmd_en_i 	: std_logic;
+	signal CTL_FIFO_rdreq_i : std_logic;
 	signal FIFO_full_i	: std_logic;
 	signal FIFO_al_full_i : std_logic;
 	-- LCD_controller <=> FIFO_LCD
@@ -109,11 +142,15 @@ begin
 		AM_ctl_go 		=> AM_go_i,
 		AM_ctl_stop		=> AM_stop_i,
 		AM_ctl_pause 	=> AM_pause_i,
+		ST_enable 		=> ST_enable_i,
 		AM_stat_done 	=> AM_done_i,
 		AM_stat_busy 	=> AM_busy_i,
 		AM_rd_add		=> AM_rd_add_i,
 		AM_rd_len		=> AM_rd_len_i,
 		AM_burstcount 	=> AM_burstcount_i,
+		TRIG_go 			=> TRIG_go,
+		TRIG_address 	=> TRIG_address,
+		TRIG_busy 		=> TRIG_busy,
 		address			=> AS_address,
 		write 			=> AS_write,
 		writedata		=> AS_writedata,
@@ -135,8 +172,8 @@ begin
 		in_length 		=> AM_rd_len_i,
 		in_address		=> AM_rd_add_i,
 		in_burstcount 	=> AM_burstcount_i,
-		FIFO_data 		=> FIFO_data_i,
-		FIFO_wrreq 		=> FIFO_wrreq_i,
+		FIFO_data 		=> AM_FIFO_data_i,
+		FIFO_wrreq 		=> AM_FIFO_wrreq_i,
 		FIFO_full		=> FIFO_full_i,
 		FIFO_al_full 	=> FIFO_al_full_i,
 		address 					=> AM_address,
@@ -153,15 +190,15 @@ begin
 	port map (
 		clk 			 => clk,
 		nReset	 	 => nReset,
-		wr_cmd_en 	 => LCD_cmd_en_i, 
+		wr_cmd_en 	 => CTL_cmd_en_i, 
 		wr_data_en   => LCD_data_en_i,	
 		wr_ack 		 => LCD_ack_i,
-		command 		 => LCD_cmd_i,
+		command 		 => CTL_cmd_i,
 		command_data => LCD_cmd_d_i,
 		FIFO_data 	 => FIFO_q_i,
 		FIFO_empty	 => FIFO_empty_i,
 		FIFO_al_empty => FIFO_al_empty_i,
-		FIFO_rdreq 	 => FIFO_rdreq_i,
+		FIFO_rdreq 	 => CTL_FIFO_rdreq_i,
 		LCD_CS_N 	 => LCD_CS_N,
 		LCD_RS 		 => LCD_RS,
 		LCD_WR_N		 => LCD_WR_N,
@@ -169,6 +206,82 @@ begin
 		LCD_data 	 => LCD_data
 		);
 
+	-----------------------------------------------------------------------------
+	-- FIFO write port: in preview mode the camera stream fills the FIFO and
+	-- master_control is left idle
+	process(clk, nReset)
+	begin
+		if nReset = '0' then
+			ST_state_reg <= ST_HUNT;
+		elsif rising_edge(clk) then
+			if ST_enable_i = '0' then
+				ST_state_reg <= ST_HUNT after 1 ns;
+			else
+				ST_state_reg <= ST_state_next after 1 ns;
+			end if;
+		end if;
+	end process;
+
+	ST_NSL : process(ST_state_reg, ST_valid, ST_ready_i, ST_startofpacket, ST_endofpacket, FIFO_empty_i, LCD_ack_i)
+	begin
+		ST_state_next <= ST_state_reg;
+
+		case ST_state_reg is
+			when ST_HUNT =>
+				if ST_valid = '1' and ST_startofpacket = '1' then
+					ST_state_next <= ST_DRAIN;
+				end if;
+			when ST_DRAIN =>
+				-- the LCD controller is between two lines and the FIFO is empty
+				if LCD_ack_i = '1' and FIFO_empty_i = '1' then
+					ST_state_next <= ST_CMD;
+				end if;
+			when ST_CMD =>
+				ST_state_next <= ST_CMD_WAIT;
+			when ST_CMD_WAIT =>
+				if LCD_ack_i = '1' then
+					ST_state_next <= ST_FIRST;
+				end if;
+			when ST_FIRST =>
+				-- the start of the frame itself
+				if ST_valid = '1' and ST_ready_i = '1' then
+					if ST_endofpacket = '1' then
+						ST_state_next <= ST_HUNT;
+					else
+						ST_state_next <= ST_PASS;
+					end if;
+				end if;
+			when ST_PASS =>
+				-- a new frame before the end of this one, the rest was dropped
+				if ST_valid = '1' and ST_startofpacket = '1' then
+					ST_state_next <= ST_DRAIN;
+				elsif ST_valid = '1' and ST_ready_i = '1' and ST_endofpacket = '1' then
+					ST_state_next <= ST_HUNT;
+				end if;
+		end case;
+	end process ST_NSL;
+
+	ST_ready_i 		<= '0' when ST_enable_i = '0' else
+							'1' when ST_state_reg = ST_HUNT and ST_startofpacket = '0' else -- discarded
+							not FIFO_full_i when ST_state_reg = ST_FIRST else
+							not FIFO_full_i when ST_state_reg = ST_PASS and ST_startofpacket = '0' else
+							'0';
+	ST_ready 		<= ST_ready_i;
+	ST_write_i 		<= ST_valid and ST_ready_i when ST_state_reg = ST_FIRST or ST_state_reg = ST_PASS else
+							'0';
+	-- what is left is less than the line the LCD controller waits for
+	ST_flush_i 		<= '1' when ST_enable_i = '1' and ST_state_reg = ST_DRAIN and LCD_ack_i = '1' and
+										FIFO_al_empty_i = '1' and FIFO_empty_i = '0' else
+							'0';
+	ST_cmd_i 		<= '1' when ST_enable_i = '1' and ST_state_reg = ST_CMD else
+							'0';
+
+	FIFO_data_i 	<= ST_data when ST_enable_i = '1' else AM_FIFO_data_i;
+	FIFO_wrreq_i 	<= ST_write_i when ST_enable_i = '1' else AM_FIFO_wrreq_i;
+	FIFO_rdreq_i 	<= CTL_FIFO_rdreq_i or ST_flush_i;
+	CTL_cmd_i 		<= CMD_MEM_WRITE when ST_cmd_i = '1' else LCD_cmd_i;
+	CTL_cmd_en_i 	<= LCD_cmd_en_i or ST_cmd_i;
+
 	-----------------------------------------------------------------------------
 
 	FIFO : FIFO_LCD PORT MAP (
@@ -38,11 +38,14 @@ architecture simple of AS_registers_tb is
 	signal AM_ctl_go 		: std_logic;
 	signal AM_ctl_stop	: std_logic;
 	signal AM_ctl_pause 	: std_logic;
+	signal ST_enable 		: std_logic;
 	signal AM_stat_done 	: std_logic;
 	signal AM_stat_busy 	: std_logic;
 	signal AM_rd_add		: std_logic_vector(31 downto 0);
 	signal AM_rd_len		: std_logic_vector(31 downto 0);
 	signal AM_burstcount : std_logic_vector(6 downto 0); 
+	signal TRIG_go 		: std_logic := '0';
+	signal TRIG_address 	: std_logic_vector(31 downto 0) := (others => '0');
 	-- LCD
 	signal LCD_cmd 		: std_logic_vector(15 downto 0);
 	signal LCD_cmd_d 		: std_logic_vector(15 downto 0);
@@ -66,11 +69,14 @@ begin
 		AM_ctl_go 		=> AM_ctl_go,
 		AM_ctl_stop		=> AM_ctl_stop,
 		AM_ctl_pause 	=> AM_ctl_pause,
+		ST_enable 		=> ST_enable,
 		AM_stat_done 	=> AM_stat_done,
 		AM_stat_busy 	=> AM_stat_busy,
 		AM_rd_add		=> AM_rd_add,
 		AM_rd_len		=> AM_rd_len,
 		AM_burstcount 	=> AM_burstcount,
+		TRIG_go 			=> TRIG_go,
+		TRIG_address 	=> TRIG_address,
 		address			=> AS_address,
 		write 			=> AS_write,
 		writedata		=> AS_writedata,
@@ -54,6 +54,9 @@ architecture simple of LCD_controller_top_tb is
 	constant CTRL_GO 			: std_logic_vector(31 downto 0) := std_logic_vector(to_unsigned(16#1#,32));
 	constant CTRL_STOP	 	: std_logic_vector(31 downto 0) := std_logic_vector(to_unsigned(16#2#,32));
 	constant CTRL_PAUSE		: std_logic_vector(31 downto 0) := std_logic_vector(to_unsigned(16#4#,32));
+	constant CTRL_STREAM		: std_logic_vector(31 downto 0) := std_logic_vector(to_unsigned(16#8#,32));
+	constant CTRL_TRIG 		: std_logic_vector(31 downto 0) := std_logic_vector(to_unsigned(16#10#,32));
+	constant TRIG_ADD 		: std_logic_vector(31 downto 0) := std_logic_vector(to_unsigned(16#2000#,32));
 	constant ALL0_32b 		: std_logic_vector(31 downto 0) := (others => '0');
 	
 	-----------------------------------------------------------------------------
@@ -71,6 +74,19 @@ architecture simple of LCD_controller_top_tb is
 	signal AM_readdatavalid			: std_logic;
 	signal AM_readdata 				: std_logic_vector(31 downto 0);
 	signal AM_waitrequest 			: std_logic;
+	-- Avalon Streaming (ST) sink
+	signal ST_data 		: std_logic_vector(31 downto 0);
+	signal ST_valid 		: std_logic;
+	signal ST_ready 		: std_logic;
+	signal ST_startofpacket : std_logic;
+	signal ST_endofpacket 	: std_logic;
+	-- memory write commands and pixels sent to the LCD
+	signal lcd_mem_writes 	: natural := 0;
+	signal lcd_pixels 		: natural := 0;
+	-- camera display trigger
+	signal TRIG_go 		: std_logic;
+	signal TRIG_address 	: std_logic_vector(31 downto 0);
+	signal TRIG_busy 		: std_logic;
 	-- AS
 	signal AS_address 		: std_logic_vector(2 downto 0);
 	signal AS_write 			: std_logic;
@@ -105,6 +121,14 @@ begin
 		AM_readdatavalid		 => AM_readdatavalid,
 		AM_readdata 			 => AM_readdata,
 		AM_waitrequest 		 => AM_waitrequest,
+		ST_data 		 => ST_data,
+		ST_valid 	 => ST_valid,
+		ST_ready 	 => ST_ready,
+		ST_startofpacket => ST_startofpacket,
+		ST_endofpacket 	 => ST_endofpacket,
+		TRIG_go 		 => TRIG_go,
+		TRIG_address => TRIG_address,
+		TRIG_busy 	 => TRIG_busy,
 		LCD_CS_N 	 => LCD_CS_N,
 		LCD_RS 		 => LCD_RS,
 		LCD_WR_N		 => LCD_WR_N,
@@ -126,9 +150,25 @@ begin
 		end if;
 	end process CLK_GEN;
 
+	-----------------------------------------------------------------------------
+	-- LCD writes, sampled at the end of the write pulse -------------------------
+	LCD_MON : process(LCD_WR_N)
+	begin
+		if rising_edge(LCD_WR_N) and LCD_CS_N = '0' then
+			if LCD_RS = '0' and LCD_data = CMD_MEM_WRITE(15 downto 0) then
+				lcd_mem_writes <= lcd_mem_writes + 1;
+			elsif LCD_RS = '1' then
+				lcd_pixels <= lcd_pixels + 1;
+			end if;
+		end if;
+	end process LCD_MON;
+
 	-----------------------------------------------------------------------------
 	-- simulation ---------------------------------------------------------------
 	SIM : process	
+		variable mem_writes_before : natural;
+		variable pixels_before : natural;
+
 		--------------------------------------------------------------------------
 		-- RESET --
 		procedure async_reset is
@@ -202,6 +242,32 @@ begin
 			AM_readdatavalid <= '0';
 		end procedure DDR3_response;
 		--------------------------------------------------------------------------
+		-- camera stream, words of a frame with its packet boundaries
+		procedure st_send(	constant words : in natural;
+									constant sop	: in boolean;
+									constant eop	: in boolean) is
+		begin
+			for I in 0 to words-1 loop
+				ST_data 	<= std_logic_vector(to_unsigned(I, ST_data'length));
+				ST_valid <= '1';
+				if sop and I = 0 then
+					ST_startofpacket <= '1';
+				else
+					ST_startofpacket <= '0';
+				end if;
+				if eop and I = words-1 then
+					ST_endofpacket <= '1';
+				else
+					ST_endofpacket <= '0';
+				end if;
+				wait until rising_edge(clk) and ST_ready = '1';
+				assert AM_read = '0' report "DDR3 read in stream mode" severity error;
+			end loop;
+			ST_valid 			<= '0';
+			ST_startofpacket 	<= '0';
+			ST_endofpacket 	<= '0';
+		end procedure st_send;
+		--------------------------------------------------------------------------
 	begin
 		--------------------------------------------------------------------------
 		-- default value
@@ -213,6 +279,12 @@ begin
 		AM_readdatavalid <= '0';
 		AM_readdata 	<= (others => '0');
 		AM_waitrequest <= '0';
+		ST_data 			<= (others => '0');
+		ST_valid 		<= '0';
+		ST_startofpacket <= '0';
+		ST_endofpacket <= '0';
+		TRIG_go 			<= '0';
+		TRIG_address 	<= (others => '0');
 
 		wait for CLK_PER;
 		-- reset
@@ -247,6 +319,50 @@ begin
 		wait until rising_edge(clk);
 		wait for 240*5*CLK_PER; -- let LCD_controller send all pixels
 
+		----------------------------------------------------------------------------
+		-- preview stream: frames of two lines pushed by the camera, no DDR3 read.
+		-- The end of a frame enabled in its middle is discarded, a torn frame
+		-- leaves half a line that is never displayed, and every frame starts
+		-- with its own memory write command
+		wait for 256*10*CLK_PER; -- let LCD_controller empty the FIFO
+		mem_writes_before := lcd_mem_writes;
+		pixels_before 		:= lcd_pixels;
+		as_wr(ADD_CONTROL, CTRL_STREAM);
+		st_send(50, false, true);
+		st_send(240, true, true);
+		st_send(60, true, false);
+		st_send(240, true, true);
+		wait for 240*10*CLK_PER; -- let LCD_controller send all pixels
+		assert lcd_mem_writes = mem_writes_before + 3
+			report "Memory write not sent at each frame start" severity error;
+		assert lcd_pixels = pixels_before + 2*240*2
+			report "Unexpected number of pixels from the stream" severity error;
+		as_wr(ADD_CONTROL, ALL0_32b);
+
+		----------------------------------------------------------------------------
+		-- display trigger: the camera starts the read of its completed buffer
+		as_wr(ADD_LENGTH, std_logic_vector(to_unsigned(2*BURSTLEN_int, 32)));
+		as_wr(ADD_CONTROL, CTRL_TRIG);
+		wait until rising_edge(clk);
+		TRIG_address 	<= TRIG_ADD;
+		TRIG_go 			<= '1';
+		wait until rising_edge(clk);
+		TRIG_go 			<= '0';
+		wait for CLK_PER/4;
+		assert TRIG_busy = '1' report "Triggered buffer not held" severity error;
+		if AM_read = '0' then
+			wait until AM_read = '1';
+		end if;
+		assert AM_address = TRIG_ADD report "Trigger did not start the read at the camera buffer" severity error;
+		DDR3_response;
+		if AM_read = '0' then
+			wait until AM_read = '1';
+		end if;
+		DDR3_response;
+		as_wr(ADD_CONTROL, ALL0_32b);
+		wait for 2*BURSTLEN_int*10*CLK_PER; -- let LCD_controller send all pixels
+		assert TRIG_busy = '0' report "Triggered buffer still held after its read" severity error;
+
 		----------------------------------------------------------------------------
 
 		--as_wr(ADD_CONTROL, CTRL_GO);
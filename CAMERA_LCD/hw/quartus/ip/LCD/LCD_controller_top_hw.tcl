@@ -175,3 +175,44 @@ add_interface_port LT24_interface LCD_RD_N rd_n Output 1
 add_interface_port LT24_interface LCD_RS rs Output 1
 add_interface_port LT24_interface LCD_WR_N wr_n Output 1
 add_interface_port LT24_interface LCD_data d Output 16
+
+
+# 
+# connection point st
+# 
+add_interface st avalon_streaming end
+set_interface_property st associatedClock clock
+set_interface_property st associatedReset reset_sink
+set_interface_property st dataBitsPerSymbol 32
+set_interface_property st errorDescriptor ""
+set_interface_property st firstSymbolInHighOrderBits true
+set_interface_property st maxChannel 0
+set_interface_property st readyLatency 0
+set_interface_property st ENABLED true
+set_interface_property st EXPORT_OF ""
+set_interface_property st PORT_NAME_MAP ""
+set_interface_property st CMSIS_SVD_VARIABLES ""
+set_interface_property st SVD_ADDRESS_GROUP ""
+
+add_interface_port st ST_data data Input 32
+add_interface_port st ST_valid valid Input 1
+add_interface_port st ST_ready ready Output 1
+add_interface_port st ST_startofpacket startofpacket Input 1
+add_interface_port st ST_endofpacket endofpacket Input 1
+
+
+# 
+# connection point trigger
+# 
+add_interface trigger conduit end
+set_interface_property trigger associatedClock clock
+set_interface_property trigger associatedReset reset_sink
+set_interface_property trigger ENABLED true
+set_interface_property trigger EXPORT_OF ""
+set_interface_property trigger PORT_NAME_MAP ""
+set_interface_property trigger CMSIS_SVD_VARIABLES ""
+set_interface_property trigger SVD_ADDRESS_GROUP ""
+
+add_interface_port trigger TRIG_go go Input 1
+add_interface_port trigger TRIG_address address Input 32
+add_interface_port trigger TRIG_busy busy Output 1
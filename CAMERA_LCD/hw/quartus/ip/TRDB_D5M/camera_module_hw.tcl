@@ -41,11 +41,23 @@ set_fileset_property QUARTUS_SYNTH ENABLE_RELATIVE_INCLUDE_PATHS false
 set_fileset_property QUARTUS_SYNTH ENABLE_FILE_OVERWRITE_MODE false
 add_fileset_file acq.vhd VHDL PATH hdl/acq.vhd
 add_fileset_file camera_module.vhd VHDL PATH hdl/camera_module.vhd TOP_LEVEL_FILE
+add_fileset_file camera_pkg.vhd VHDL PATH hdl/camera_pkg.vhd
+add_fileset_file conv.vhd VHDL PATH hdl/conv.vhd
 add_fileset_file debay.vhd VHDL PATH hdl/debay.vhd
+add_fileset_file decimate.vhd VHDL PATH hdl/decimate.vhd
+add_fileset_file depacketize.vhd VHDL PATH hdl/depacketize.vhd
 add_fileset_file dma.vhd VHDL PATH hdl/dma.vhd
 add_fileset_file end_fifo.vhd VHDL PATH hdl/end_fifo.vhd
 add_fileset_file global_controller.vhd VHDL PATH hdl/global_controller.vhd
+add_fileset_file line_fifo.vhd VHDL PATH hdl/line_fifo.vhd
+add_fileset_file motion.vhd VHDL PATH hdl/motion.vhd
+add_fileset_file motion_fifo.vhd VHDL PATH hdl/motion_fifo.vhd
+add_fileset_file pack.vhd VHDL PATH hdl/pack.vhd
+add_fileset_file packetize.vhd VHDL PATH hdl/packetize.vhd
+add_fileset_file rice.vhd VHDL PATH hdl/rice.vhd
 add_fileset_file row_fifo.vhd VHDL PATH hdl/row_fifo.vhd
+add_fileset_file stats.vhd VHDL PATH hdl/stats.vhd
+add_fileset_file timestamp.vhd VHDL PATH hdl/timestamp.vhd
 
 
 # 
@@ -65,15 +77,15 @@ set_parameter_property screen_height TYPE NATURAL
 set_parameter_property screen_height UNITS None
 set_parameter_property screen_height ALLOWED_RANGES 0:2147483647
 set_parameter_property screen_height HDL_PARAMETER true
-add_parameter burst_count NATURAL 10
-set_parameter_property burst_count DEFAULT_VALUE 10
+add_parameter burst_count NATURAL 128
+set_parameter_property burst_count DEFAULT_VALUE 128
 set_parameter_property burst_count DISPLAY_NAME burst_count
 set_parameter_property burst_count TYPE NATURAL
 set_parameter_property burst_count UNITS None
 set_parameter_property burst_count ALLOWED_RANGES 0:2147483647
 set_parameter_property burst_count HDL_PARAMETER true
-add_parameter burst_bitwidth NATURAL 4
-set_parameter_property burst_bitwidth DEFAULT_VALUE 4
+add_parameter burst_bitwidth NATURAL 8
+set_parameter_property burst_bitwidth DEFAULT_VALUE 8
 set_parameter_property burst_bitwidth DISPLAY_NAME burst_bitwidth
 set_parameter_property burst_bitwidth TYPE NATURAL
 set_parameter_property burst_bitwidth UNITS None
@@ -126,7 +138,7 @@ set_interface_property avalon_slave PORT_NAME_MAP ""
 set_interface_property avalon_slave CMSIS_SVD_VARIABLES ""
 set_interface_property avalon_slave SVD_ADDRESS_GROUP ""
 
-add_interface_port avalon_slave AS_address address Input 4
+add_interface_port avalon_slave AS_address address Input 11
 add_interface_port avalon_slave AS_write write Input 1
 add_interface_port avalon_slave AS_read read Input 1
 add_interface_port avalon_slave AS_writedata writedata Input 32
@@ -171,6 +183,41 @@ add_interface_port avalon_master AM_write write Output 1
 add_interface_port avalon_master AM_waitRequest waitrequest Input 1
 
 
+# 
+# connection point motion_master
+# 
+add_interface motion_master avalon start
+set_interface_property motion_master addressUnits SYMBOLS
+set_interface_property motion_master associatedClock clock
+set_interface_property motion_master associatedReset reset_sink
+set_interface_property motion_master bitsPerSymbol 8
+set_interface_property motion_master burstOnBurstBoundariesOnly false
+set_interface_property motion_master burstcountUnits WORDS
+set_interface_property motion_master doStreamReads false
+set_interface_property motion_master doStreamWrites false
+set_interface_property motion_master holdTime 0
+set_interface_property motion_master linewrapBursts false
+set_interface_property motion_master maximumPendingReadTransactions 0
+set_interface_property motion_master maximumPendingWriteTransactions 0
+set_interface_property motion_master readLatency 0
+set_interface_property motion_master readWaitTime 1
+set_interface_property motion_master setupTime 0
+set_interface_property motion_master timingUnits Cycles
+set_interface_property motion_master writeWaitTime 0
+set_interface_property motion_master ENABLED true
+set_interface_property motion_master EXPORT_OF ""
+set_interface_property motion_master PORT_NAME_MAP ""
+set_interface_property motion_master CMSIS_SVD_VARIABLES ""
+set_interface_property motion_master SVD_ADDRESS_GROUP ""
+
+add_interface_port motion_master MM_address address Output 32
+add_interface_port motion_master MM_burstCount burstcount Output burst_bitwidth
+add_interface_port motion_master MM_read read Output 1
+add_interface_port motion_master MM_readData readdata Input 32
+add_interface_port motion_master MM_readDataValid readdatavalid Input 1
+add_interface_port motion_master MM_waitRequest waitrequest Input 1
+
+
 # 
 # connection point reset_sink
 # 
@@ -200,6 +247,21 @@ set_interface_property camera_pixclk SVD_ADDRESS_GROUP ""
 add_interface_port camera_pixclk camera_pixclk clk Input 1
 
 
+# 
+# connection point pixel_reset
+# 
+add_interface pixel_reset reset end
+set_interface_property pixel_reset associatedClock camera_pixclk
+set_interface_property pixel_reset synchronousEdges DEASSERT
+set_interface_property pixel_reset ENABLED true
+set_interface_property pixel_reset EXPORT_OF ""
+set_interface_property pixel_reset PORT_NAME_MAP ""
+set_interface_property pixel_reset CMSIS_SVD_VARIABLES ""
+set_interface_property pixel_reset SVD_ADDRESS_GROUP ""
+
+add_interface_port pixel_reset pix_rst_n reset_n Input 1
+
+
 # 
 # connection point camera
 # 
@@ -217,3 +279,110 @@ add_interface_port camera camera_line_valid camera_line_valid Input 1
 add_interface_port camera camera_pixel_data camera_pixel_data Input 12
 add_interface_port camera camera_trigger camera_trigger Output 1
 
+
+# 
+# connection point interrupt_sender
+# 
+add_interface interrupt_sender interrupt end
+set_interface_property interrupt_sender associatedAddressablePoint avalon_slave
+set_interface_property interrupt_sender associatedClock clock
+set_interface_property interrupt_sender associatedReset reset_sink
+set_interface_property interrupt_sender bridgedReceiverOffset ""
+set_interface_property interrupt_sender bridgesToReceiver ""
+set_interface_property interrupt_sender ENABLED true
+set_interface_property interrupt_sender EXPORT_OF ""
+set_interface_property interrupt_sender PORT_NAME_MAP ""
+set_interface_property interrupt_sender CMSIS_SVD_VARIABLES ""
+set_interface_property interrupt_sender SVD_ADDRESS_GROUP ""
+
+add_interface_port interrupt_sender irq irq Output 1
+
+
+
+# 
+# connection point preview_source
+# 
+add_interface preview_source avalon_streaming start
+set_interface_property preview_source associatedClock clock
+set_interface_property preview_source associatedReset reset_sink
+set_interface_property preview_source dataBitsPerSymbol 32
+set_interface_property preview_source errorDescriptor ""
+set_interface_property preview_source firstSymbolInHighOrderBits true
+set_interface_property preview_source maxChannel 0
+set_interface_property preview_source readyLatency 0
+set_interface_property preview_source ENABLED true
+set_interface_property preview_source EXPORT_OF ""
+set_interface_property preview_source PORT_NAME_MAP ""
+set_interface_property preview_source CMSIS_SVD_VARIABLES ""
+set_interface_property preview_source SVD_ADDRESS_GROUP ""
+
+add_interface_port preview_source ST_data data Output 32
+add_interface_port preview_source ST_valid valid Output 1
+add_interface_port preview_source ST_ready ready Input 1
+add_interface_port preview_source ST_startofpacket startofpacket Output 1
+add_interface_port preview_source ST_endofpacket endofpacket Output 1
+
+
+# 
+# connection point pixel_source
+# 
+add_interface pixel_source avalon_streaming start
+set_interface_property pixel_source associatedClock camera_pixclk
+set_interface_property pixel_source associatedReset pixel_reset
+set_interface_property pixel_source dataBitsPerSymbol 32
+set_interface_property pixel_source errorDescriptor ""
+set_interface_property pixel_source firstSymbolInHighOrderBits true
+set_interface_property pixel_source maxChannel 0
+set_interface_property pixel_source readyLatency 0
+set_interface_property pixel_source ENABLED true
+set_interface_property pixel_source EXPORT_OF ""
+set_interface_property pixel_source PORT_NAME_MAP ""
+set_interface_property pixel_source CMSIS_SVD_VARIABLES ""
+set_interface_property pixel_source SVD_ADDRESS_GROUP ""
+
+add_interface_port pixel_source SRC_data data Output 32
+add_interface_port pixel_source SRC_valid valid Output 1
+add_interface_port pixel_source SRC_ready ready Input 1
+add_interface_port pixel_source SRC_startofpacket startofpacket Output 1
+add_interface_port pixel_source SRC_endofpacket endofpacket Output 1
+
+
+# 
+# connection point pixel_sink
+# 
+add_interface pixel_sink avalon_streaming end
+set_interface_property pixel_sink associatedClock camera_pixclk
+set_interface_property pixel_sink associatedReset pixel_reset
+set_interface_property pixel_sink dataBitsPerSymbol 32
+set_interface_property pixel_sink errorDescriptor ""
+set_interface_property pixel_sink firstSymbolInHighOrderBits true
+set_interface_property pixel_sink maxChannel 0
+set_interface_property pixel_sink readyLatency 0
+set_interface_property pixel_sink ENABLED true
+set_interface_property pixel_sink EXPORT_OF ""
+set_interface_property pixel_sink PORT_NAME_MAP ""
+set_interface_property pixel_sink CMSIS_SVD_VARIABLES ""
+set_interface_property pixel_sink SVD_ADDRESS_GROUP ""
+
+add_interface_port pixel_sink SNK_data data Input 32
+add_interface_port pixel_sink SNK_valid valid Input 1
+add_interface_port pixel_sink SNK_ready ready Output 1
+add_interface_port pixel_sink SNK_startofpacket startofpacket Input 1
+add_interface_port pixel_sink SNK_endofpacket endofpacket Input 1
+
+
+# 
+# connection point display_trigger
+# 
+add_interface display_trigger conduit end
+set_interface_property display_trigger associatedClock clock
+set_interface_property display_trigger associatedReset reset_sink
+set_interface_property display_trigger ENABLED true
+set_interface_property display_trigger EXPORT_OF ""
+set_interface_property display_trigger PORT_NAME_MAP ""
+set_interface_property display_trigger CMSIS_SVD_VARIABLES ""
+set_interface_property display_trigger SVD_ADDRESS_GROUP ""
+
+add_interface_port display_trigger disp_go go Output 1
+add_interface_port display_trigger disp_address address Output 32
+add_interface_port display_trigger disp_busy busy Input 1
@@ -1,12 +1,10 @@
 library ieee;
 use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
 
 -- Latency of the module: 0 cycle
 
 entity acq is
-    generic (
-        screen_width : natural := 640
-    );
     port(
     clk : in std_logic;
     nReset : in std_logic;
@@ -21,11 +19,28 @@ entity acq is
     deb_row_even : out std_logic;
     deb_valid    : out std_logic;
     deb_pixel_data: out std_logic_vector(11 downto 0);
+    -- Clears the debayer row state when re-aligning after a dropped frame
+    deb_resync   : out std_logic;
+
+    -- end_fifo Interface
+    -- A pixel write was refused by the full FIFO
+    end_overflow : in std_logic;
+    -- Rest of the frame is discarded, held until the next frame is locked
+    end_drop     : out std_logic;
 
     -- Global Controller Interface
     glob_start :  in std_logic;
     glob_start_done : out std_logic;
     glob_busy  : out std_logic;
+    -- When set, re-arm for the next frame instead of going back to idle
+    glob_continuous : in std_logic;
+    -- Sensor is free running: no trigger, lock on the next frame_valid rise
+    glob_video : in std_logic;
+    -- Captured window, in sensor pixels, offsets and sizes must be even
+    glob_width  : in std_logic_vector(11 downto 0);
+    glob_height : in std_logic_vector(11 downto 0);
+    glob_roi_x  : in std_logic_vector(11 downto 0);
+    glob_roi_y  : in std_logic_vector(11 downto 0);
 
     -- System Soft Reset
     sys_soft_rst : out std_logic
@@ -36,32 +51,110 @@ architecture arch of acq is
     type state_t is (idle, ready, even, odd);
     signal state_reg, state_next : state_t;
 
-    signal count_reg, count_next : natural range 0 to screen_width - 1;
+    -- Column and row of the current sensor pixel
+    signal count_reg, count_next : natural range 0 to 4095;
+    signal row_reg, row_next : natural range 0 to 4095;
+    signal line_valid_prev : std_logic;
+    -- Current pixel lies inside the captured window
+    signal col_in, row_in : std_logic;
+    signal col_last : std_logic;
     signal sys_soft_rst_internal : std_logic;
+    -- Streaming mode sampled at start, so a stop only takes effect between frames
+    signal stream_reg, stream_next : std_logic;
+    signal frame_valid_prev : std_logic;
+    signal frame_start : std_logic;
+    signal drop_reg, drop_next : std_logic;
+    -- The next frame is locked, entering even from ready
+    signal frame_lock : std_logic;
+    signal capture : std_logic;
+    -- Controls of the global controller, on clk, synchronised to the pixel
+    -- clock. A stop can come at any time.
+    signal start_sync : std_logic_vector(1 downto 0);
+    signal continuous_sync : std_logic_vector(1 downto 0);
+    signal video_sync : std_logic_vector(1 downto 0);
+    signal start : std_logic;
+    signal continuous : std_logic;
+    signal video : std_logic;
 begin
     process(clk,nReset)
     begin
         if nReset = '0' then
             count_reg <= 0;
+            row_reg <= 0;
             state_reg <= idle;
+            stream_reg <= '0';
+            drop_reg <= '0';
+            frame_valid_prev <= '1';
+            line_valid_prev <= '0';
+            start_sync <= (others => '0');
+            continuous_sync <= (others => '0');
+            video_sync <= (others => '0');
         elsif rising_edge(clk) then
             count_reg <= count_next;
+            row_reg <= row_next;
+            line_valid_prev <= camera_line_valid;
             state_reg <= state_next;
+            stream_reg <= stream_next;
+            drop_reg <= drop_next;
+            frame_valid_prev <= camera_frame_valid;
+            start_sync <= start_sync(0) & glob_start;
+            continuous_sync <= continuous_sync(0) & glob_continuous;
+            video_sync <= video_sync(0) & glob_video;
        end if;
     end process;
 
+    start <= start_sync(1);
+    continuous <= continuous_sync(1);
+    video <= video_sync(1);
+
+    -- Until streaming is seen the mode still follows the controller, the
+    -- start and the mode may cross a cycle apart
+    stream_next <= continuous when state_reg = idle or (state_reg = ready and stream_reg = '0') else
+                   '0' when continuous = '0' else
+                   stream_reg;
+
+    -- In snapshot mode the frame follows our trigger, in video mode only a
+    -- rising edge guarantees we do not start in the middle of a frame
+    frame_start <= (camera_frame_valid and not frame_valid_prev) when video = '1' else
+                   camera_frame_valid;
+
+    frame_lock <= '1' when state_reg = ready and frame_start = '1' and
+                           not (stream_reg = '1' and continuous = '0') else
+                  '0';
+
+    -- A torn frame is never passed on: once a pixel is lost the remaining
+    -- ones are discarded and capture resumes with the next frame
+    drop_next <= '0' when (sys_soft_rst_internal = '1') or (frame_lock = '1') else
+                 '1' when end_overflow = '1' else
+                 drop_reg;
+
     count_next <= 0 when sys_soft_rst_internal = '1' else
-                  0 when (count_reg + 1 = screen_width) and (camera_line_valid = '1' and camera_frame_valid = '1') else
-                  (count_reg + 1) when (camera_line_valid='1' and camera_frame_valid='1') else
+                  0 when camera_line_valid = '0' else
+                  (count_reg + 1) when (camera_line_valid='1' and camera_frame_valid='1' and count_reg /= 4095) else
                   count_reg;
 
-    process(camera_line_valid, camera_frame_valid, glob_start, count_reg, state_reg, clk)
+    row_next <= 0 when (sys_soft_rst_internal = '1') or (camera_frame_valid = '0') else
+                (row_reg + 1) when (line_valid_prev = '1' and camera_line_valid = '0' and row_reg /= 4095) else
+                row_reg;
+
+    col_in <= '1' when (count_reg >= to_integer(unsigned(glob_roi_x))) and
+                       (count_reg < to_integer(unsigned(glob_roi_x)) + to_integer(unsigned(glob_width))) else
+              '0';
+    row_in <= '1' when (row_reg >= to_integer(unsigned(glob_roi_y))) and
+                       (row_reg < to_integer(unsigned(glob_roi_y)) + to_integer(unsigned(glob_height))) else
+              '0';
+    -- Last pixel of a captured line
+    col_last <= '1' when (count_reg = to_integer(unsigned(glob_roi_x)) + to_integer(unsigned(glob_width)) - 1) and
+                         (row_in = '1') and (camera_line_valid = '1') else
+                '0';
+
+    process(camera_line_valid, camera_frame_valid, frame_start, start, continuous, stream_reg, col_last, state_reg, clk)
     begin
         sys_soft_rst_internal <= '0';
 
         case state_reg is
             when idle =>
-                if glob_start = '1' then
+                if start = '1' then
                     state_next <= ready;
                     sys_soft_rst_internal <= '1';
                 else
@@ -69,16 +162,20 @@ begin
                 end if;
                 glob_busy <= '0';
             when ready =>
-                if camera_frame_valid = '1' then
+                if stream_reg = '1' and continuous = '0' then
+                    state_next <= idle;
+                elsif frame_start = '1' then
                     state_next <= even;
                 else
                     state_next <= ready;
                 end if;
                 glob_busy <= '1';
             when even =>
-                if camera_frame_valid = '0' then
+                if camera_frame_valid = '0' and stream_reg = '1' and continuous = '1' then
+                    state_next <= ready;
+                elsif camera_frame_valid = '0' then
                     state_next <= idle;
-                elsif (count_reg = screen_width-1) and (camera_line_valid = '1') then
+                elsif col_last = '1' then
                     state_next <= odd;
                 else
                     state_next <= even;
@@ -86,9 +183,11 @@ begin
 
                 glob_busy <= '1';
             when odd =>
-                if camera_frame_valid <= '0' then
+                if camera_frame_valid = '0' and stream_reg = '1' and continuous = '1' then
+                    state_next <= ready;
+                elsif camera_frame_valid <= '0' then
                     state_next <= idle;
-                elsif (count_reg = screen_width-1) and (camera_line_valid = '1') then
+                elsif col_last = '1' then
                     state_next <= even;
                 else
                     state_next <= odd;
@@ -100,12 +199,17 @@ begin
 
     deb_row_even <= '0' when state_reg=odd else
                     '1';
-    camera_trigger <= '0' when state_reg=ready else
+    camera_trigger <= '0' when state_reg=ready and video='0' else
                       '1';
     glob_start_done <= '0' when state_reg=idle else
                        '1';
 
-    deb_valid <= camera_frame_valid and camera_line_valid;
+    -- A free running sensor keeps sending pixels between captures
+    capture <= '1' when state_reg = even or state_reg = odd else
+               '0';
+    deb_valid <= camera_frame_valid and camera_line_valid and col_in and row_in and capture and (not drop_reg);
+    deb_resync <= frame_lock and drop_reg;
+    end_drop <= drop_reg;
 
     deb_pixel_data <= camera_pixel_data;
 
@@ -1,25 +1,32 @@
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
+use work.camera_pkg.all;
 
 entity camera_module is
     generic(
         screen_width : natural := 640;
         screen_height : natural := 480;
-        burst_count : natural := 10;
-        burst_bitwidth : natural := 4
+        -- Longest DMA burst, the burst length register selects up to this
+        burst_count : natural := 128;
+        burst_bitwidth : natural := 8
     );
 	port(
 		clk : in std_logic;
 		rst_n : in std_logic;
 
         -- Avalon Slave Interface
-        AS_address : in std_logic_vector(3 downto 0);
+        -- 0x000-0x0FF global_controller, 0x100-0x1FF timestamp, 0x200-0x3FF stats,
+        -- 0x400-0x4FF motion
+        AS_address : in std_logic_vector(10 downto 0);
         AS_write : in std_logic;
         AS_read : in std_logic;
         AS_writedata : in std_logic_vector(31 downto 0);
         AS_readdata : out std_logic_vector(31 downto 0);
 
+        -- Interrupt Sender
+        irq : out std_logic;
+
         -- Avalon Interface
         AM_address      : out std_logic_vector(31 downto 0);
         AM_dataWrite    : out std_logic_vector(31 downto 0);
@@ -27,6 +34,44 @@ entity camera_module is
         AM_write        : out std_logic;
         AM_waitRequest  : in  std_logic;
 
+        -- Avalon Interface, reads of the previous frame by motion
+        MM_address       : out std_logic_vector(31 downto 0);
+        MM_burstCount    : out std_logic_vector(burst_bitwidth - 1 downto 0);
+        MM_read          : out std_logic;
+        MM_readData      : in  std_logic_vector(31 downto 0);
+        MM_readDataValid : in  std_logic;
+        MM_waitRequest   : in  std_logic;
+
+        -- Avalon-ST Source to the LCD controller, used in preview mode, one
+        -- packet per frame
+        ST_data          : out std_logic_vector(31 downto 0);
+        ST_valid         : out std_logic;
+        ST_ready         : in  std_logic;
+        ST_startofpacket : out std_logic;
+        ST_endofpacket   : out std_logic;
+
+        -- Avalon-ST Source and Sink on camera_pixclk, one packet per frame.
+        -- The pixel words leave the pipeline on SRC and are written to
+        -- end_fifo from SNK, stages can be inserted between both.
+        SRC_data          : out std_logic_vector(31 downto 0);
+        SRC_valid         : out std_logic;
+        SRC_ready         : in  std_logic;
+        SRC_startofpacket : out std_logic;
+        SRC_endofpacket   : out std_logic;
+        SNK_data          : in  std_logic_vector(31 downto 0);
+        SNK_valid         : in  std_logic;
+        SNK_ready         : out std_logic;
+        SNK_startofpacket : in  std_logic;
+        SNK_endofpacket   : in  std_logic;
+        -- Reset of the camera_pixclk domain, deasserted synchronously to it
+        pix_rst_n         : in  std_logic;
+
+        -- Display trigger to the LCD controller, one pulse per completed frame,
+        -- the buffer is held until the LCD controller is no longer busy
+        disp_go      : out std_logic;
+        disp_address : out std_logic_vector(31 downto 0);
+        disp_busy    : in  std_logic;
+
         -- Camera Interface
         camera_pixclk      : in std_logic;
         camera_frame_valid : in std_logic;
@@ -40,35 +85,83 @@ end camera_module;
 architecture arch_camera_module of camera_module is
 
 component global_controller is
+    generic(
+        screen_width : natural := 640;
+        screen_height : natural := 480
+    );
     port(
         clk : in std_logic;
         nReset : in std_logic;
 
         -- Avalon Interface
-        AS_address : in std_logic_vector(3 downto 0);
+        AS_address : in std_logic_vector(7 downto 0);
         AS_write : in std_logic;
         AS_read : in std_logic;
 
         AS_writedata : in std_logic_vector(31 downto 0);
         AS_readdata : out std_logic_vector(31 downto 0);
 
+        -- Interrupt Sender
+        irq : out std_logic;
+
         -- Acquisition Interface
         acq_start : out std_logic;
         acq_start_done : in std_logic;
+        acq_continuous : out std_logic;
+        acq_video : out std_logic;
+        acq_width : out std_logic_vector(11 downto 0);
+        acq_height : out std_logic_vector(11 downto 0);
+        acq_roi_x : out std_logic_vector(11 downto 0);
+        acq_roi_y : out std_logic_vector(11 downto 0);
+
+        -- Decimation Interface
+        dec_scale : out std_logic_vector(1 downto 0);
+        pack_format : out std_logic_vector(2 downto 0);
+        pack_yuv : out std_logic_vector(1 downto 0);
+        rice_enable : out std_logic;
+        rice_k : out std_logic_vector(1 downto 0);
+        snk_frame_length : out std_logic_vector(23 downto 0);
+        conv_mode : out std_logic_vector(1 downto 0);
+        conv_shift : out std_logic_vector(3 downto 0);
+        conv_k0 : out std_logic_vector(71 downto 0);
+        conv_k1 : out std_logic_vector(71 downto 0);
+        conv_line_words : out std_logic_vector(10 downto 0);
+        conv_lines : out std_logic_vector(11 downto 0);
 
         -- DMA Interface
         dma_address : out std_logic_vector(31 downto 0);
+        dma_frame_length : out std_logic_vector(31 downto 0);
+        dma_burst_length : out std_logic_vector(7 downto 0);
+        dma_fifo_threshold : out std_logic_vector(7 downto 0);
+        dma_line_length : out std_logic_vector(23 downto 0);
+        dma_stride : out std_logic_vector(31 downto 0);
+        dma_frame_done : in std_logic;
+        dma_stall : in std_logic;
+        dma_drop : out std_logic;
+        dma_stream : out std_logic;
+
+        -- Display Interface
+        disp_go : out std_logic;
+        disp_address : out std_logic_vector(31 downto 0);
+        disp_busy : in std_logic;
 
         -- System Interface
         system_busy : in std_logic;
-        end_fifo_busy : in std_logic
+        end_fifo_busy : in std_logic;
+        end_fifo_level : in std_logic_vector(8 downto 0);
+
+        -- Camera clock domain
+        pix_clk : in std_logic;
+        pix_frame_valid : in std_logic;
+        pix_fifo_write : in std_logic;
+        pix_fifo_full : in std_logic;
+        pix_drop : in std_logic;
+        pix_frame_words : in std_logic_vector(23 downto 0);
+        pix_frame_toggle : in std_logic
     );
 end component;
 
 component acq is
-    generic (
-        screen_width : natural := 640
-    );
     port(
         clk : in std_logic;
         nReset : in std_logic;
@@ -83,11 +176,22 @@ component acq is
         deb_row_even : out std_logic;
         deb_valid    : out std_logic;
         deb_pixel_data: out std_logic_vector(11 downto 0);
+        deb_resync   : out std_logic;
+
+        -- end_fifo Interface
+        end_overflow : in std_logic;
+        end_drop     : out std_logic;
 
         -- Global Controller Interface
         glob_start :  in std_logic;
         glob_start_done : out std_logic;
         glob_busy  : out std_logic;
+        glob_continuous : in std_logic;
+        glob_video : in std_logic;
+        glob_width  : in std_logic_vector(11 downto 0);
+        glob_height : in std_logic_vector(11 downto 0);
+        glob_roi_x  : in std_logic_vector(11 downto 0);
+        glob_roi_y  : in std_logic_vector(11 downto 0);
 
         -- System Interface
         sys_soft_rst : out std_logic
@@ -99,17 +203,271 @@ component debay is
 		clk : in std_logic;
 		rst_n : in std_logic;
 
-        acq_pixeldata : in std_logic_vector(4 downto 0);
+        acq_pixeldata : in std_logic_vector(11 downto 0);
 		acq_row_even : in std_logic;
 		acq_valid : in std_logic;
 
 		end_rgb_pixeldata_x2 : out std_logic_vector(31 downto 0);
+        end_luma_x2 : out std_logic_vector(15 downto 0);
+        end_rgb888_x2 : out std_logic_vector(47 downto 0);
         end_write : out std_logic;
 
         sys_soft_rst : in std_logic
 	);
 end component;
 
+component decimate is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Debayerization Interface
+        deb_rgb_pixeldata_x2 : in std_logic_vector(31 downto 0);
+        deb_luma_x2 : in std_logic_vector(15 downto 0);
+        deb_rgb888_x2 : in std_logic_vector(47 downto 0);
+        deb_write : in std_logic;
+        deb_row_even : in std_logic;
+
+        -- end_fifo Interface
+        end_rgb_pixeldata_x2 : out std_logic_vector(31 downto 0);
+        end_luma_x2 : out std_logic_vector(15 downto 0);
+        end_rgb888_x2 : out std_logic_vector(47 downto 0);
+        end_write : out std_logic;
+
+        -- Global Controller Interface
+        glob_scale : in std_logic_vector(1 downto 0);
+
+        sys_soft_rst : in std_logic
+    );
+end component;
+
+component conv is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Decimation Interface
+        dec_rgb_pixeldata_x2 : in std_logic_vector(31 downto 0);
+        dec_luma_x2 : in std_logic_vector(15 downto 0);
+        dec_rgb888_x2 : in std_logic_vector(47 downto 0);
+        dec_write : in std_logic;
+
+        -- Acquisition Interface
+        acq_frame_valid : in std_logic;
+
+        -- pack Interface
+        pack_rgb_pixeldata_x2 : out std_logic_vector(31 downto 0);
+        pack_luma_x2 : out std_logic_vector(15 downto 0);
+        pack_rgb888_x2 : out std_logic_vector(47 downto 0);
+        pack_write : out std_logic;
+
+        -- Global Controller Interface
+        glob_mode : in std_logic_vector(1 downto 0);
+        glob_shift : in std_logic_vector(3 downto 0);
+        glob_k0 : in std_logic_vector(71 downto 0);
+        glob_k1 : in std_logic_vector(71 downto 0);
+        glob_line_words : in std_logic_vector(10 downto 0);
+        glob_lines : in std_logic_vector(11 downto 0);
+        glob_busy : out std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end component;
+
+component pack is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Debayerization Interface, after decimation
+        rgb_pixeldata_x2 : in std_logic_vector(31 downto 0);
+        luma_x2 : in std_logic_vector(15 downto 0);
+        rgb888_x2 : in std_logic_vector(47 downto 0);
+        rgb_write : in std_logic;
+
+        -- Acquisition Interface
+        raw_pixel_data : in std_logic_vector(11 downto 0);
+        raw_valid : in std_logic;
+
+        -- end_fifo Interface
+        end_data : out std_logic_vector(31 downto 0);
+        end_write : out std_logic;
+
+        -- Global Controller Interface
+        glob_format : in std_logic_vector(2 downto 0);
+        glob_yuv : in std_logic_vector(1 downto 0);
+
+        sys_soft_rst : in std_logic
+    );
+end component;
+
+component rice is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- pack Interface
+        pack_data : in std_logic_vector(31 downto 0);
+        pack_write : in std_logic;
+
+        -- Acquisition Interface
+        acq_frame_valid : in std_logic;
+
+        -- end_fifo Interface
+        end_data : out std_logic_vector(31 downto 0);
+        end_write : out std_logic;
+
+        -- Global Controller Interface
+        glob_enable : in std_logic;
+        glob_k : in std_logic_vector(1 downto 0);
+        glob_busy : out std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end component;
+
+component stats is
+    port(
+        clk : in std_logic;
+        nReset : in std_logic;
+
+        -- Avalon Interface
+        AS_address : in std_logic_vector(8 downto 0);
+        AS_read : in std_logic;
+        AS_readdata : out std_logic_vector(31 downto 0);
+
+        -- Camera clock domain
+        pix_clk : in std_logic;
+        pix_frame_valid : in std_logic;
+
+        -- Debayerization Interface
+        deb_rgb_pixeldata_x2 : in std_logic_vector(31 downto 0);
+        deb_write : in std_logic;
+
+        acq_drop : in std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end component;
+
+component timestamp is
+    port(
+        clk : in std_logic;
+        nReset : in std_logic;
+
+        -- Avalon Interface
+        AS_address : in std_logic_vector(7 downto 0);
+        AS_write : in std_logic;
+        AS_read : in std_logic;
+        AS_readdata : out std_logic_vector(31 downto 0);
+
+        -- Camera clock domain
+        pix_clk : in std_logic;
+        pix_frame_valid : in std_logic;
+        pix_fifo_write : in std_logic;
+        pix_drop : in std_logic;
+
+        -- DMA Interface
+        dma_frame_done : in std_logic
+    );
+end component;
+
+component motion is
+    generic(
+        burst_count : integer := 128;
+        burst_bitwidth : integer := 8
+    );
+    port(
+        clk : in std_logic;
+        nReset : in std_logic;
+
+        -- Avalon Interface
+        AS_address : in std_logic_vector(7 downto 0);
+        AS_write : in std_logic;
+        AS_read : in std_logic;
+        AS_writedata : in std_logic_vector(31 downto 0);
+        AS_readdata : out std_logic_vector(31 downto 0);
+
+        -- Avalon Master
+        AM_address      : out std_logic_vector(31 downto 0);
+        AM_burstCount   : out std_logic_vector(burst_bitwidth - 1 downto 0);
+        AM_read         : out std_logic;
+        AM_readData     : in  std_logic_vector(31 downto 0);
+        AM_readDataValid : in  std_logic;
+        AM_waitRequest  : in  std_logic;
+
+        -- DMA Interface
+        dma_address : in std_logic_vector(31 downto 0);
+        dma_data : in std_logic_vector(31 downto 0);
+        dma_beat : in std_logic;
+        dma_frame_done : in std_logic;
+        dma_drop : in std_logic;
+
+        -- Global Controller Interface
+        glob_format : in std_logic_vector(2 downto 0);
+        glob_line_words : in std_logic_vector(10 downto 0);
+        glob_lines : in std_logic_vector(11 downto 0)
+    );
+end component;
+
+component packetize is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Pixel pipeline Interface
+        pipe_data : in std_logic_vector(31 downto 0);
+        pipe_write : in std_logic;
+        pipe_busy : in std_logic;
+
+        -- Acquisition Interface
+        acq_frame_valid : in std_logic;
+
+        -- Avalon-ST Source
+        ST_data          : out std_logic_vector(31 downto 0);
+        ST_valid         : out std_logic;
+        ST_ready         : in  std_logic;
+        ST_startofpacket : out std_logic;
+        ST_endofpacket   : out std_logic;
+
+        overflow : out std_logic;
+        busy : out std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end component;
+
+component depacketize is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Avalon-ST Sink
+        ST_data          : in  std_logic_vector(31 downto 0);
+        ST_valid         : in  std_logic;
+        ST_ready         : out std_logic;
+        ST_startofpacket : in  std_logic;
+        ST_endofpacket   : in  std_logic;
+
+        -- end_fifo Interface
+        end_data : out std_logic_vector(31 downto 0);
+        end_write : out std_logic;
+        end_full : in std_logic;
+
+        -- Acquisition Interface
+        acq_drop : in std_logic;
+
+        -- Global Controller Interface
+        glob_frame_length : in std_logic_vector(23 downto 0);
+        glob_frame_words : out std_logic_vector(23 downto 0);
+        glob_frame_toggle : out std_logic;
+
+        overflow : out std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end component;
+
 component end_fifo is
 	port(
         aclr        : in std_logic := '0';
@@ -120,18 +478,19 @@ component end_fifo is
 		wrreq		: in std_logic ;
 		q		: out std_logic_vector (31 downto 0);
 		rdempty		: out std_logic ;
-		rdusedw		: out std_logic_vector (7 downto 0)
+		rdfull		: out std_logic ;
+		rdusedw		: out std_logic_vector (7 downto 0);
+		wrfull		: out std_logic
 	);
 end component;
 
 component dma is
     generic(
-        -- Unit of frame_length is in avalon transfer
+        -- Largest frame supported, unit of frame_length is in avalon transfer
         frame_length : integer := (320*240)/2;
-        -- Must divide evenly screen_width and screen_height
-        burst_count : integer := 10;
-        burst_bitwidth : integer := 4
-
+        -- Longest burst supported, in avalon transfers
+        burst_count : integer := 128;
+        burst_bitwidth : integer := 8
     );
     port(
         clk : in std_logic;
@@ -139,11 +498,22 @@ component dma is
 
         -- end_fifo Interface
         fifo_RGB2_pixel  : in  std_logic_vector(31 downto 0);
-        fifo_almost_full : in  std_logic;
+        fifo_usedw       : in  std_logic_vector(7 downto 0);
+        fifo_full        : in  std_logic;
+        fifo_empty       : in  std_logic;
         fifo_read        : out std_logic;
 
         -- Global Controller Interface
         glob_address : in std_logic_vector(31 downto 0);
+        glob_frame_length : in std_logic_vector(31 downto 0);
+        glob_frame_done : out std_logic;
+        glob_burst_length : in std_logic_vector(7 downto 0);
+        glob_fifo_threshold : in std_logic_vector(7 downto 0);
+        glob_line_length : in std_logic_vector(23 downto 0);
+        glob_stride : in std_logic_vector(31 downto 0);
+        glob_stall : out std_logic;
+        glob_drop : in std_logic;
+        glob_stream : in std_logic;
 
         -- Avalon Interface
         AM_address      : out std_logic_vector(31 downto 0);
@@ -152,13 +522,58 @@ component dma is
         AM_write        : out std_logic;
         AM_waitRequest  : in  std_logic;
 
+        -- Avalon-ST Source
+        ST_data          : out std_logic_vector(31 downto 0);
+        ST_valid         : out std_logic;
+        ST_ready         : in  std_logic;
+        ST_startofpacket : out std_logic;
+        ST_endofpacket   : out std_logic;
+
         -- System Interface
         sys_soft_rst : in std_logic
     );
 end component;
 
+-- Avalon slave decoding
+signal glob_cs : std_logic;
+signal ts_cs : std_logic;
+signal stats_cs : std_logic;
+signal mot_cs : std_logic;
+signal glob_write : std_logic;
+signal glob_read : std_logic;
+signal ts_write : std_logic;
+signal ts_read : std_logic;
+signal stats_read : std_logic;
+signal mot_write : std_logic;
+signal mot_read : std_logic;
+signal glob_readdata : std_logic_vector(31 downto 0);
+signal ts_readdata : std_logic_vector(31 downto 0);
+signal stats_readdata : std_logic_vector(31 downto 0);
+signal mot_readdata : std_logic_vector(31 downto 0);
+
+-- Words written by the DMA, compared by motion
+signal dma_am_address : std_logic_vector(31 downto 0);
+signal dma_am_data : std_logic_vector(31 downto 0);
+signal dma_am_write : std_logic;
+signal dma2mot_beat : std_logic;
+
 signal glob2acq_start : std_logic;
+signal glob2acq_continuous : std_logic;
+signal glob2acq_video : std_logic;
+signal glob2acq_width : std_logic_vector(11 downto 0);
+signal glob2acq_height : std_logic_vector(11 downto 0);
+signal glob2acq_roi_x : std_logic_vector(11 downto 0);
+signal glob2acq_roi_y : std_logic_vector(11 downto 0);
 signal glob2dma_address: std_logic_vector(31 downto 0);
+signal glob2dma_frame_length : std_logic_vector(31 downto 0);
+signal glob2dma_burst_length : std_logic_vector(7 downto 0);
+signal glob2dma_fifo_threshold : std_logic_vector(7 downto 0);
+signal glob2dma_line_length : std_logic_vector(23 downto 0);
+signal glob2dma_stride : std_logic_vector(31 downto 0);
+signal dma2glob_frame_done : std_logic;
+signal dma2glob_stall : std_logic;
+signal glob2dma_drop : std_logic;
+signal glob2dma_stream : std_logic;
 signal system_busy : std_logic;
 
 signal acq2sys_soft_rst : std_logic;
@@ -166,52 +581,146 @@ signal acq2glob_start_done : std_logic;
 signal acq2deb_row_even : std_logic;
 signal acq2deb_valid : std_logic;
 signal acq2deb_pixel_data : std_logic_vector(11 downto 0);
+signal acq2deb_resync : std_logic;
+signal acq2end_drop : std_logic;
+signal deb_rst : std_logic;
 signal acq_busy : std_logic;
 
-signal deb2end_rgb_pixel_data_x2 : std_logic_vector(31 downto 0);
-signal deb2end_write : std_logic;
+signal deb2dec_rgb_pixel_data_x2 : std_logic_vector(31 downto 0);
+signal deb2dec_luma_x2 : std_logic_vector(15 downto 0);
+signal deb2dec_rgb888_x2 : std_logic_vector(47 downto 0);
+signal deb2dec_write : std_logic;
+signal glob2dec_scale : std_logic_vector(1 downto 0);
+
+signal dec2conv_rgb_pixel_data_x2 : std_logic_vector(31 downto 0);
+signal dec2conv_luma_x2 : std_logic_vector(15 downto 0);
+signal dec2conv_rgb888_x2 : std_logic_vector(47 downto 0);
+signal dec2conv_write : std_logic;
+signal glob2conv_mode : std_logic_vector(1 downto 0);
+signal glob2conv_shift : std_logic_vector(3 downto 0);
+signal glob2conv_k0 : std_logic_vector(71 downto 0);
+signal glob2conv_k1 : std_logic_vector(71 downto 0);
+signal glob2conv_line_words : std_logic_vector(10 downto 0);
+signal glob2conv_lines : std_logic_vector(11 downto 0);
+
+signal conv2pack_rgb_pixel_data_x2 : std_logic_vector(31 downto 0);
+signal conv2pack_luma_x2 : std_logic_vector(15 downto 0);
+signal conv2pack_rgb888_x2 : std_logic_vector(47 downto 0);
+signal conv2pack_write : std_logic;
+signal glob2pack_format : std_logic_vector(2 downto 0);
+signal glob2pack_yuv : std_logic_vector(1 downto 0);
+
+signal pack2rice_data : std_logic_vector(31 downto 0);
+signal pack2rice_write : std_logic;
+signal glob2rice_enable : std_logic;
+signal glob2rice_k : std_logic_vector(1 downto 0);
+signal rice_busy : std_logic;
+
+signal conv_busy : std_logic;
+
+signal rice2pkt_data : std_logic_vector(31 downto 0);
+signal rice2pkt_write : std_logic;
+signal pipe_busy : std_logic;
+signal pkt_overflow : std_logic;
+signal pkt_busy : std_logic;
+signal snk2end_data : std_logic_vector(31 downto 0);
+signal snk_overflow : std_logic;
+signal glob2snk_frame_length : std_logic_vector(23 downto 0);
+signal snk2glob_frame_words : std_logic_vector(23 downto 0);
+signal snk2glob_frame_toggle : std_logic;
+-- Pixel writes reaching end_fifo, none while a frame is dropped
+signal end_write : std_logic;
+signal end_overflow : std_logic;
 
 signal end2dma_RGB_pixel_data_x2 : std_logic_vector(31 downto 0);
-signal end2dma_almost_full : std_logic;
 signal dma2end_read : std_logic;
 
 signal end_empty : std_logic;
 signal end_usage : std_logic_vector(7 downto 0);
+signal end_full : std_logic;
+signal end_wrfull : std_logic;
+-- Words in end_fifo, usedw reads 0 when full
+signal end_level : std_logic_vector(8 downto 0);
 
 
 begin
 
-GLOB_CTRL_INST: global_controller
-port map(
+GLOB_CTRL_INST: global_controller generic map(
+    screen_width => screen_width,
+    screen_height => screen_height
+) port map(
     clk => clk,
     nReset => rst_n,
 
     -- Avalon Interface
-    AS_address => AS_address,
-    AS_write => AS_write,
-    AS_read => AS_read,
+    AS_address => AS_address(7 downto 0),
+    AS_write => glob_write,
+    AS_read => glob_read,
     AS_writedata => AS_writedata,
-    AS_readdata => AS_readdata,
+    AS_readdata => glob_readdata,
+
+    irq => irq,
 
     -- Acquisition Interface
     acq_start => glob2acq_start,
     acq_start_done => acq2glob_start_done,
+    acq_continuous => glob2acq_continuous,
+    acq_video => glob2acq_video,
+    acq_width => glob2acq_width,
+    acq_height => glob2acq_height,
+    acq_roi_x => glob2acq_roi_x,
+    acq_roi_y => glob2acq_roi_y,
+
+    -- Decimation Interface
+    dec_scale => glob2dec_scale,
+    pack_format => glob2pack_format,
+    pack_yuv => glob2pack_yuv,
+    rice_enable => glob2rice_enable,
+    rice_k => glob2rice_k,
+    snk_frame_length => glob2snk_frame_length,
+    conv_mode => glob2conv_mode,
+    conv_shift => glob2conv_shift,
+    conv_k0 => glob2conv_k0,
+    conv_k1 => glob2conv_k1,
+    conv_line_words => glob2conv_line_words,
+    conv_lines => glob2conv_lines,
 
     -- DMA Interface
     dma_address => glob2dma_address,
+    dma_frame_length => glob2dma_frame_length,
+    dma_burst_length => glob2dma_burst_length,
+    dma_fifo_threshold => glob2dma_fifo_threshold,
+    dma_line_length => glob2dma_line_length,
+    dma_stride => glob2dma_stride,
+    dma_frame_done => dma2glob_frame_done,
+    dma_stall => dma2glob_stall,
+    dma_drop => glob2dma_drop,
+    dma_stream => glob2dma_stream,
+
+    -- Display Interface
+    disp_go => disp_go,
+    disp_address => disp_address,
+    disp_busy => disp_busy,
 
     -- System Interface
     system_busy => system_busy,
-    end_fifo_busy => end_empty
-);
+    end_fifo_busy => end_empty,
+    end_fifo_level => end_level,
 
-ACQ_INST: acq generic map(
-    screen_width => screen_width
+    -- Camera clock domain
+    pix_clk => camera_pixclk,
+    pix_frame_valid => camera_frame_valid,
+    pix_fifo_write => end_write,
+    pix_fifo_full => end_wrfull,
+    pix_drop => acq2end_drop,
+    pix_frame_words => snk2glob_frame_words,
+    pix_frame_toggle => snk2glob_frame_toggle
+);
 
-) port map(
+ACQ_INST: acq port map(
 
     clk => camera_pixclk,
-    nReset => rst_n,
+    nReset => pix_rst_n,
 
     -- Camera Interface
     camera_frame_valid => camera_frame_valid,
@@ -223,46 +732,258 @@ ACQ_INST: acq generic map(
     deb_row_even => acq2deb_row_even,
     deb_valid    => acq2deb_valid,
     deb_pixel_data => acq2deb_pixel_data,
+    deb_resync => acq2deb_resync,
+
+    -- end_fifo Interface
+    end_overflow => end_overflow,
+    end_drop => acq2end_drop,
 
     -- Global Controller Interface
     glob_start => glob2acq_start,
     glob_start_done => acq2glob_start_done,
     glob_busy => acq_busy,
+    glob_continuous => glob2acq_continuous,
+    glob_video => glob2acq_video,
+    glob_width => glob2acq_width,
+    glob_height => glob2acq_height,
+    glob_roi_x => glob2acq_roi_x,
+    glob_roi_y => glob2acq_roi_y,
     sys_soft_rst => acq2sys_soft_rst
 );
 
 DEBAY_INST: debay port map(
 	clk => camera_pixclk,
-	rst_n => rst_n,
+	rst_n => pix_rst_n,
 
-    acq_pixeldata => acq2deb_pixel_data(11 downto 7),
+    acq_pixeldata => acq2deb_pixel_data,
 	acq_row_even => acq2deb_row_even,
 	acq_valid => acq2deb_valid,
 
-	end_rgb_pixeldata_x2 => deb2end_rgb_pixel_data_x2,
-    end_write => deb2end_write,
+	end_rgb_pixeldata_x2 => deb2dec_rgb_pixel_data_x2,
+    end_luma_x2 => deb2dec_luma_x2,
+    end_rgb888_x2 => deb2dec_rgb888_x2,
+    end_write => deb2dec_write,
+    sys_soft_rst => deb_rst
+);
+
+DEC_INST: decimate port map(
+    clk => camera_pixclk,
+    rst_n => pix_rst_n,
+
+    deb_rgb_pixeldata_x2 => deb2dec_rgb_pixel_data_x2,
+    deb_luma_x2 => deb2dec_luma_x2,
+    deb_rgb888_x2 => deb2dec_rgb888_x2,
+    deb_write => deb2dec_write,
+    deb_row_even => acq2deb_row_even,
+
+    end_rgb_pixeldata_x2 => dec2conv_rgb_pixel_data_x2,
+    end_luma_x2 => dec2conv_luma_x2,
+    end_rgb888_x2 => dec2conv_rgb888_x2,
+    end_write => dec2conv_write,
+
+    glob_scale => glob2dec_scale,
+    sys_soft_rst => deb_rst
+);
+
+CONV_INST: conv port map(
+    clk => camera_pixclk,
+    rst_n => pix_rst_n,
+
+    dec_rgb_pixeldata_x2 => dec2conv_rgb_pixel_data_x2,
+    dec_luma_x2 => dec2conv_luma_x2,
+    dec_rgb888_x2 => dec2conv_rgb888_x2,
+    dec_write => dec2conv_write,
+
+    acq_frame_valid => camera_frame_valid,
+
+    pack_rgb_pixeldata_x2 => conv2pack_rgb_pixel_data_x2,
+    pack_luma_x2 => conv2pack_luma_x2,
+    pack_rgb888_x2 => conv2pack_rgb888_x2,
+    pack_write => conv2pack_write,
+
+    glob_mode => glob2conv_mode,
+    glob_shift => glob2conv_shift,
+    glob_k0 => glob2conv_k0,
+    glob_k1 => glob2conv_k1,
+    glob_line_words => glob2conv_line_words,
+    glob_lines => glob2conv_lines,
+    glob_busy => conv_busy,
+    sys_soft_rst => deb_rst
+);
+
+STATS_INST: stats port map(
+    clk => clk,
+    nReset => rst_n,
+
+    AS_address => AS_address(8 downto 0),
+    AS_read => stats_read,
+    AS_readdata => stats_readdata,
+
+    pix_clk => camera_pixclk,
+    pix_frame_valid => camera_frame_valid,
+
+    deb_rgb_pixeldata_x2 => deb2dec_rgb_pixel_data_x2,
+    deb_write => deb2dec_write,
+
+    acq_drop => acq2end_drop,
+
+    sys_soft_rst => deb_rst
+);
+
+TS_INST: timestamp port map(
+    clk => clk,
+    nReset => rst_n,
+
+    AS_address => AS_address(7 downto 0),
+    AS_write => ts_write,
+    AS_read => ts_read,
+    AS_readdata => ts_readdata,
+
+    pix_clk => camera_pixclk,
+    pix_frame_valid => camera_frame_valid,
+    pix_fifo_write => end_write,
+    pix_drop => acq2end_drop,
+
+    dma_frame_done => dma2glob_frame_done
+);
+
+MOT_INST: motion generic map(
+    burst_count => burst_count,
+    burst_bitwidth => burst_bitwidth
+) port map(
+    clk => clk,
+    nReset => rst_n,
+
+    AS_address => AS_address(7 downto 0),
+    AS_write => mot_write,
+    AS_read => mot_read,
+    AS_writedata => AS_writedata,
+    AS_readdata => mot_readdata,
+
+    AM_address => MM_address,
+    AM_burstCount => MM_burstCount,
+    AM_read => MM_read,
+    AM_readData => MM_readData,
+    AM_readDataValid => MM_readDataValid,
+    AM_waitRequest => MM_waitRequest,
+
+    dma_address => dma_am_address,
+    dma_data => dma_am_data,
+    dma_beat => dma2mot_beat,
+    dma_frame_done => dma2glob_frame_done,
+    dma_drop => glob2dma_drop,
+
+    glob_format => glob2pack_format,
+    glob_line_words => glob2conv_line_words,
+    glob_lines => glob2conv_lines
+);
+
+PACK_INST: pack port map(
+    clk => camera_pixclk,
+    rst_n => pix_rst_n,
+
+    rgb_pixeldata_x2 => conv2pack_rgb_pixel_data_x2,
+    luma_x2 => conv2pack_luma_x2,
+    rgb888_x2 => conv2pack_rgb888_x2,
+    rgb_write => conv2pack_write,
+
+    raw_pixel_data => acq2deb_pixel_data,
+    raw_valid => acq2deb_valid,
+
+    end_data => pack2rice_data,
+    end_write => pack2rice_write,
+
+    glob_format => glob2pack_format,
+    glob_yuv => glob2pack_yuv,
+    sys_soft_rst => deb_rst
+);
+
+RICE_INST: rice port map(
+    clk => camera_pixclk,
+    rst_n => pix_rst_n,
+
+    pack_data => pack2rice_data,
+    pack_write => pack2rice_write,
+
+    acq_frame_valid => camera_frame_valid,
+
+    end_data => rice2pkt_data,
+    end_write => rice2pkt_write,
+
+    glob_enable => glob2rice_enable,
+    glob_k => glob2rice_k,
+    glob_busy => rice_busy,
+
+    sys_soft_rst => acq2sys_soft_rst
+);
+
+PKT_INST: packetize port map(
+    clk => camera_pixclk,
+    rst_n => pix_rst_n,
+
+    pipe_data => rice2pkt_data,
+    pipe_write => rice2pkt_write,
+    pipe_busy => pipe_busy,
+
+    acq_frame_valid => camera_frame_valid,
+
+    ST_data => SRC_data,
+    ST_valid => SRC_valid,
+    ST_ready => SRC_ready,
+    ST_startofpacket => SRC_startofpacket,
+    ST_endofpacket => SRC_endofpacket,
+
+    overflow => pkt_overflow,
+    busy => pkt_busy,
+
+    sys_soft_rst => acq2sys_soft_rst
+);
+
+SNK_INST: depacketize port map(
+    clk => camera_pixclk,
+    rst_n => pix_rst_n,
+
+    ST_data => SNK_data,
+    ST_valid => SNK_valid,
+    ST_ready => SNK_ready,
+    ST_startofpacket => SNK_startofpacket,
+    ST_endofpacket => SNK_endofpacket,
+
+    end_data => snk2end_data,
+    end_write => end_write,
+    end_full => end_wrfull,
+
+    acq_drop => acq2end_drop,
+
+    glob_frame_length => glob2snk_frame_length,
+    glob_frame_words => snk2glob_frame_words,
+    glob_frame_toggle => snk2glob_frame_toggle,
+
+    overflow => snk_overflow,
+
     sys_soft_rst => acq2sys_soft_rst
 );
 
 END_FIFO_INST: end_fifo port map(
     aclr => acq2sys_soft_rst,
-	data => deb2end_rgb_pixel_data_x2,
+	data => snk2end_data,
 	rdclk => clk,
 	rdreq => dma2end_read,
 	rdempty => end_empty,
+	rdfull => end_full,
 	rdusedw => end_usage,
+	wrfull => end_wrfull,
 
 	wrclk => camera_pixclk,
-	wrreq => deb2end_write,
+	wrreq => end_write,
 	q => end2dma_RGB_pixel_data_x2
 
 );
 
 
 DMA_INST: dma generic map(
-    -- Unit of frame_length is in avalon transfer
-    frame_length => (screen_width/2*screen_height/2)/2,
-    -- Must divide evenly screen_width and screen_height
+    -- Largest frame, a RAW12 capture of the largest window
+    frame_length => FRAME_WORDS_MAX,
     burst_count => burst_count,
     burst_bitwidth => burst_bitwidth
 ) port map(
@@ -272,25 +993,78 @@ DMA_INST: dma generic map(
 
     -- end_fifo Interface
     fifo_RGB2_pixel  => end2dma_RGB_pixel_data_x2,
-    fifo_almost_full => end2dma_almost_full,
+    fifo_usedw       => end_usage,
+    fifo_full        => end_full,
+    fifo_empty       => end_empty,
     fifo_read        => dma2end_read,
 
     -- Global Controller Interface
     glob_address => glob2dma_address,
+    glob_frame_length => glob2dma_frame_length,
+    glob_frame_done => dma2glob_frame_done,
+    glob_burst_length => glob2dma_burst_length,
+    glob_fifo_threshold => glob2dma_fifo_threshold,
+    glob_line_length => glob2dma_line_length,
+    glob_stride => glob2dma_stride,
+    glob_stall => dma2glob_stall,
+    glob_drop => glob2dma_drop,
+    glob_stream => glob2dma_stream,
 
     -- Avalon Interface
-    AM_address      => AM_address,
-    AM_dataWrite    => AM_dataWrite,
+    AM_address      => dma_am_address,
+    AM_dataWrite    => dma_am_data,
     AM_burstCount   => AM_burstCount,
-    AM_write        => AM_write,
+    AM_write        => dma_am_write,
     AM_waitRequest  => AM_waitRequest,
 
+    -- Avalon-ST Source
+    ST_data          => ST_data,
+    ST_valid         => ST_valid,
+    ST_ready         => ST_ready,
+    ST_startofpacket => ST_startofpacket,
+    ST_endofpacket   => ST_endofpacket,
+
     sys_soft_rst => acq2sys_soft_rst
 );
 
-system_busy <= acq_busy or (not end_empty);
+AM_address <= dma_am_address;
+AM_dataWrite <= dma_am_data;
+AM_write <= dma_am_write;
+dma2mot_beat <= dma_am_write and (not AM_waitRequest);
+
+system_busy <= acq_busy or rice_busy or pkt_busy or (not end_empty);
+
+glob_cs <= '1' when AS_address(10 downto 8) = "000" else
+           '0';
+ts_cs <= '1' when AS_address(10 downto 8) = "001" else
+         '0';
+stats_cs <= '1' when AS_address(10 downto 9) = "01" else
+            '0';
+mot_cs <= AS_address(10);
+
+glob_write <= AS_write and glob_cs;
+glob_read <= AS_read and glob_cs;
+ts_write <= AS_write and ts_cs;
+ts_read <= AS_read and ts_cs;
+stats_read <= AS_read and stats_cs;
+mot_write <= AS_write and mot_cs;
+mot_read <= AS_read and mot_cs;
+
+AS_readdata <= mot_readdata when mot_cs = '1' else
+               stats_readdata when stats_cs = '1' else
+               ts_readdata when ts_cs = '1' else
+               glob_readdata when glob_cs = '1' else
+               (others => '0');
+
+deb_rst <= acq2sys_soft_rst or acq2deb_resync;
+
+pipe_busy <= conv_busy or rice_busy;
+
+-- A word refused on the source is lost like one written to a full end_fifo,
+-- neither counts while the frame is dropped
+end_overflow <= (pkt_overflow and (not acq2end_drop)) or snk_overflow;
 
-end2dma_almost_full <= '1' when (unsigned(end_usage) >= burst_count) else
-                       '0';
+end_level <= "100000000" when end_full = '1' else
+             '0' & end_usage;
 
 end arch_camera_module;
@@ -11,6 +11,7 @@ use ieee.numeric_std.all;
 use std.textio.all;
 use ieee.std_logic_textio.all;
 use ieee.math_real.all;
+use work.camera_pkg.all;
 
 entity camera_module_tb is
 end camera_module_tb;
@@ -41,8 +42,23 @@ constant screen_height : natural := 120;
 constant burst_count : natural := 2;
 constant burst_bitwidth : natural := 10;
 
+-- Streaming through a ring of frame buffers
+constant ring_size : natural := 3;
+constant frame_count : natural := 4;
+constant frame_words : natural := (screen_width/2*screen_height/2)/2;
+constant frame_bytes : natural := frame_words*4;
+constant ring_base : natural := 16#1000#;
+
+-- Centered region of interest, half the sensor window in each direction
+constant roi_width : natural := screen_width/2;
+constant roi_height : natural := screen_height/2;
+constant roi_words : natural := (roi_width/2*roi_height/2)/2;
+
 signal clk    : std_logic := '0';
 signal rst_n  : std_logic := '1';
+-- rst_n released on camera_pixclk, as the system reset controller does
+signal pix_rst_sync : std_logic_vector(1 downto 0) := "11";
+signal pix_rst_n : std_logic;
 
     -- Camera Interface
 signal camera_frame_valid : std_logic := '0';
@@ -51,12 +67,14 @@ signal camera_pixel_data  : std_logic_vector(11 downto 0) := (others => '0');
 signal camera_trigger     : std_logic;
 signal camera_pixclk      : std_logic;
 
-signal AS_address : std_logic_vector(3 downto 0);
+signal AS_address : std_logic_vector(10 downto 0);
 signal AS_write : std_logic;
 signal AS_read : std_logic;
 signal AS_writedata : std_logic_vector(31 downto 0);
 signal AS_readdata : std_logic_vector(31 downto 0);
 
+signal irq : std_logic;
+
 signal AM_address      : std_logic_vector(31 downto 0);
 signal AM_dataWrite    : std_logic_vector(31 downto 0);
 signal AM_burstCount   : std_logic_vector(burst_bitwidth - 1 downto 0);
@@ -65,12 +83,75 @@ signal AM_waitRequest  : std_logic;
 
 signal am_write_prev : std_logic;
 
+-- Reads of motion, every word of memory reads as mm_fill
+signal MM_address       : std_logic_vector(31 downto 0);
+signal MM_burstCount    : std_logic_vector(burst_bitwidth - 1 downto 0);
+signal MM_read          : std_logic;
+signal MM_readDataValid : std_logic := '0';
+signal MM_waitRequest   : std_logic;
+signal mm_fill : std_logic_vector(31 downto 0) := (others => '1');
+signal mm_left : natural := 0;
+-- Holds waitrequest to model a stalled bridge
+signal am_stall : std_logic := '0';
+
+signal ST_data  : std_logic_vector(31 downto 0);
+signal ST_valid : std_logic;
+signal ST_ready : std_logic := '0';
+signal ST_startofpacket : std_logic;
+signal ST_endofpacket : std_logic;
+-- Words, starts and ends of packet accepted on the preview stream
+signal st_beats : natural := 0;
+signal st_starts : natural := 0;
+signal st_ends : natural := 0;
+
+-- Pixel stream, looped back from the source to the sink
+signal pix_data  : std_logic_vector(31 downto 0);
+signal pix_valid : std_logic;
+signal pix_ready : std_logic;
+signal pix_sop   : std_logic;
+signal pix_eop   : std_logic;
+-- Stage in front of the sink, keeps every other word and the last one
+signal halve : boolean := false;
+signal halve_odd : std_logic := '0';
+signal snk_valid : std_logic;
+signal pix_packets : natural := 0;
+signal pix_in_packet : boolean := false;
+signal pix_errors : natural := 0;
+
+signal disp_go      : std_logic;
+signal disp_address : std_logic_vector(31 downto 0);
+signal disp_busy    : std_logic := '0';
+-- The display model reads each frame it is handed until this is cleared
+signal lcd_reading : boolean := false;
+-- Frames handed to the display and buffer of the last one
+signal disp_count : natural := 0;
+signal disp_last  : std_logic_vector(31 downto 0) := (others => '0');
+
+-- Words written in YUV422 must carry neutral chroma, the test frame is grey
+signal yuv_check : boolean := false;
+signal yuv_errors : natural := 0;
+-- Pixels written non zero by the convolution
+signal conv_check : boolean := false;
+signal conv_pixels : natural := 0;
+-- Words written that differ from word_expect
+signal word_check : boolean := false;
+signal word_expect : std_logic_vector(31 downto 0) := (others => '0');
+signal word_errors : natural := 0;
+
 file output : TEXT open WRITE_MODE is "out.ppm";
+-- Same frame in RGB565 ("p") and compressed ("c"), decoded by sim/rice_check.c
+file rice_file : TEXT open WRITE_MODE is "rice_frame.txt";
+-- 1 dumps the words written as RGB565, 2 as compressed words
+signal rice_dump : natural := 0;
 
 
 signal cnt : unsigned(4 downto 0) := (others => '0');
 signal cnt_total : integer := -1;
 
+type beat_count_t is array (0 to ring_size - 1) of natural;
+signal beats : beat_count_t := (others => 0);
+signal beats_total : natural := 0;
+
 component camera_module is
     generic(
         screen_width : natural := 640;
@@ -83,12 +164,15 @@ component camera_module is
 		rst_n : in std_logic;
 
         -- Avalon Slave Interface
-        AS_address : in std_logic_vector(3 downto 0);
+        AS_address : in std_logic_vector(10 downto 0);
         AS_write : in std_logic;
         AS_read : in std_logic;
         AS_writedata : in std_logic_vector(31 downto 0);
         AS_readdata : out std_logic_vector(31 downto 0);
 
+        -- Interrupt Sender
+        irq : out std_logic;
+
         -- Avalon Interface
         AM_address      : out std_logic_vector(31 downto 0);
         AM_dataWrite    : out std_logic_vector(31 downto 0);
@@ -96,6 +180,39 @@ component camera_module is
         AM_write        : out std_logic;
         AM_waitRequest  : in  std_logic;
 
+        -- Avalon Interface, motion reads
+        MM_address       : out std_logic_vector(31 downto 0);
+        MM_burstCount    : out std_logic_vector(burst_bitwidth - 1 downto 0);
+        MM_read          : out std_logic;
+        MM_readData      : in  std_logic_vector(31 downto 0);
+        MM_readDataValid : in  std_logic;
+        MM_waitRequest   : in  std_logic;
+
+        -- Avalon-ST Source
+        ST_data          : out std_logic_vector(31 downto 0);
+        ST_valid         : out std_logic;
+        ST_ready         : in  std_logic;
+        ST_startofpacket : out std_logic;
+        ST_endofpacket   : out std_logic;
+
+        -- Pixel stream
+        SRC_data          : out std_logic_vector(31 downto 0);
+        SRC_valid         : out std_logic;
+        SRC_ready         : in  std_logic;
+        SRC_startofpacket : out std_logic;
+        SRC_endofpacket   : out std_logic;
+        SNK_data          : in  std_logic_vector(31 downto 0);
+        SNK_valid         : in  std_logic;
+        SNK_ready         : out std_logic;
+        SNK_startofpacket : in  std_logic;
+        SNK_endofpacket   : in  std_logic;
+        pix_rst_n         : in  std_logic;
+
+        -- Display trigger
+        disp_go      : out std_logic;
+        disp_address : out std_logic_vector(31 downto 0);
+        disp_busy    : in  std_logic;
+
         -- Camera Interface
         camera_pixclk      : in std_logic;
         camera_frame_valid : in std_logic;
@@ -124,6 +241,8 @@ dut: camera_module generic map(
         AS_writedata => AS_writedata,
         AS_readdata => AS_readdata,
 
+        irq => irq,
+
         -- Avalon Interface
         AM_address      => AM_address,
         AM_dataWrite    => AM_dataWrite,
@@ -131,6 +250,37 @@ dut: camera_module generic map(
         AM_write        => AM_write,
         AM_waitRequest  => AM_waitRequest,
 
+        MM_address       => MM_address,
+        MM_burstCount    => MM_burstCount,
+        MM_read          => MM_read,
+        MM_readData      => mm_fill,
+        MM_readDataValid => MM_readDataValid,
+        MM_waitRequest   => MM_waitRequest,
+
+        -- Avalon-ST Source
+        ST_data          => ST_data,
+        ST_valid         => ST_valid,
+        ST_ready         => ST_ready,
+        ST_startofpacket => ST_startofpacket,
+        ST_endofpacket   => ST_endofpacket,
+
+        SRC_data          => pix_data,
+        SRC_valid         => pix_valid,
+        SRC_ready         => pix_ready,
+        SRC_startofpacket => pix_sop,
+        SRC_endofpacket   => pix_eop,
+        SNK_data          => pix_data,
+        SNK_valid         => snk_valid,
+        SNK_ready         => pix_ready,
+        SNK_startofpacket => pix_sop,
+        SNK_endofpacket   => pix_eop,
+        pix_rst_n         => pix_rst_n,
+
+        -- Display trigger
+        disp_go      => disp_go,
+        disp_address => disp_address,
+        disp_busy    => disp_busy,
+
         -- Camera Interface
         camera_pixclk      => camera_pixclk,
         camera_frame_valid => camera_frame_valid,
@@ -158,9 +308,156 @@ begin
     end loop;
 end process;
 
+p_pix_reset : process(camera_pixclk, rst_n)
+begin
+    if rst_n = '0' then
+        pix_rst_sync <= "00";
+    elsif rising_edge(camera_pixclk) then
+        pix_rst_sync <= pix_rst_sync(0) & '1';
+    end if;
+end process;
+pix_rst_n <= pix_rst_sync(1);
+
 p_stim: process
 
     variable out_line : line;
+    variable readback : std_logic_vector(31 downto 0);
+    variable beats_before : natural;
+    variable hist_total : natural;
+    variable level : natural;
+    variable ts_start, ts_last, ts_done : unsigned(31 downto 0);
+    variable beats_buf : beat_count_t;
+    variable disp_before : natural;
+
+    procedure as_write_reg(address : std_logic_vector; data : natural) is
+    begin
+        AS_address <= std_logic_vector(resize(unsigned(address), AS_address'length));
+        AS_writedata <= std_logic_vector(to_unsigned(data, 32));
+        AS_write <= '1';
+        wait for clock_period;
+        AS_write <= '0';
+        AS_writedata <= (others => '0');
+    end procedure;
+
+    procedure as_read_reg(address : std_logic_vector; data : out std_logic_vector(31 downto 0)) is
+    begin
+        AS_address <= std_logic_vector(resize(unsigned(address), AS_address'length));
+        AS_read <= '1';
+        wait for clock_period;
+        AS_read <= '0';
+        wait for clock_period/2;
+        data := AS_readdata;
+        wait for clock_period/2;
+    end procedure;
+
+    procedure send_frame is
+    begin
+        wait until rising_edge(camera_pixclk);
+        wait for 2*clock_period;
+        camera_frame_valid <= '0';
+
+        wait for clock_period;
+        camera_frame_valid <= '1';
+
+        wait for clock_period;
+
+        for J in 0 to screen_height-1 loop
+            for I in 0 to screen_width-1 loop
+                camera_line_valid <= '1';
+
+                if custom then
+                    if (J <= 3) and (I >= screen_width-4)then
+                        camera_pixel_data <= (others => '1');
+                    else
+                        camera_pixel_data <= (others => '0');
+                    end if;
+                elsif horiz then
+                    if (J mod 4 = 0) or (J mod 4 = 1) then
+                        camera_pixel_data <= (others => '1');
+                    else
+                        camera_pixel_data <= (others => '0');
+                    end if;
+                elsif square then
+                    if (I >= screen_width/2 - square_size/2) and (I < screen_width/2 + square_size/2) and
+                       (J >= screen_height/2- square_size/2) and (J < screen_height/2+ square_size/2) then
+                        if green and ((I mod 2 = 0 and J mod 2 = 0) or (I mod 2 = 1 and J mod 2 = 1)) then
+                            --camera_pixel_data <= std_logic_vector(cnt) & "0000000";
+                            camera_pixel_data <= std_logic_vector(to_unsigned(green_color,5))& "0000000";
+                        elsif red and (I mod 2 = 1 and J mod 2 = 0) then
+                            --camera_pixel_data <= std_logic_vector(cnt) & "0000000";
+                            camera_pixel_data <= std_logic_vector(to_unsigned(red_color,5))& "0000000";
+                        elsif blue and (I mod 2 = 0 and J mod 2 = 1) then
+                            camera_pixel_data <= std_logic_vector(to_unsigned(blue_color,5))&"0000000";
+                            --camera_pixel_data <= std_logic_vector(cnt) & "0000000";
+                        end if;
+                    else
+                            camera_pixel_data <= (others => '0');
+                    end if;
+                else
+                    if green and ((I mod 2 = 0 and J mod 2 = 0) or (I mod 2 = 1 and J mod 2 = 1)) then
+                        camera_pixel_data <= std_logic_vector(cnt) & "0000000";
+                        --camera_pixel_data <= std_logic_vector(to_unsigned(green_color,5))& "0000000";
+                    elsif red and (I mod 2 = 1 and J mod 2 = 0) then
+                        camera_pixel_data <= std_logic_vector(cnt) & "0000000";
+                        --camera_pixel_data <= std_logic_vector(to_unsigned(red_color,5))& "0000000";
+                    elsif blue and (I mod 2 = 0 and J mod 2 = 1) then
+                        --camera_pixel_data <= std_logic_vector(to_unsigned(blue_color,5))&"0000000";
+                        camera_pixel_data <= std_logic_vector(cnt) & "0000000";
+                    else
+                        camera_pixel_data <= (others => '0');
+                    end if;
+                end if;
+                cnt <= (cnt + 1) mod 32 ;
+                cnt_total <= cnt_total  + 1;
+                wait for clock_period;
+            end loop;
+            camera_line_valid <= '0';
+            wait for clock_period;
+        end loop;
+        camera_frame_valid <= '0';
+        wait for 100*clock_period;
+    end procedure;
+
+    -- Frame of a single colour, 12-bit samples on the Bayer pattern
+    procedure send_bayer(r, g, b : natural) is
+    begin
+        wait until rising_edge(camera_pixclk);
+        wait for 2*clock_period;
+        camera_frame_valid <= '0';
+        wait for clock_period;
+        camera_frame_valid <= '1';
+        wait for clock_period;
+
+        for J in 0 to screen_height-1 loop
+            for I in 0 to screen_width-1 loop
+                camera_line_valid <= '1';
+                if I mod 2 = J mod 2 then
+                    camera_pixel_data <= std_logic_vector(to_unsigned(g, 12));
+                elsif J mod 2 = 0 then
+                    camera_pixel_data <= std_logic_vector(to_unsigned(r, 12));
+                else
+                    camera_pixel_data <= std_logic_vector(to_unsigned(b, 12));
+                end if;
+                wait for clock_period;
+            end loop;
+            camera_line_valid <= '0';
+            wait for clock_period;
+        end loop;
+        camera_frame_valid <= '0';
+        wait for 100*clock_period;
+    end procedure;
+
+    -- Black lines of a frame already in progress
+    procedure send_lines(count : natural) is
+    begin
+        for J in 0 to count-1 loop
+            camera_line_valid <= '1';
+            camera_pixel_data <= (others => '0');
+            wait for screen_width*clock_period;
+            camera_line_valid <= '0';
+            wait for clock_period;
+        end loop;
+    end procedure;
 begin
 
     write(out_line, string'("P3"));
@@ -190,75 +487,542 @@ begin
     wait for clock_period/2;
 
     wait for 3*clock_period;
-    AS_address <= (others => '0');
-    AS_write <= '1';
-    wait for clock_period;
-    AS_write <= '0';
+    for I in 0 to ring_size-1 loop
+        as_write_reg(std_logic_vector(to_unsigned(16#20# + 4*I, 8)), ring_base + I*frame_bytes);
+    end loop;
+    as_write_reg(x"0C", ring_size);
+    as_write_reg(x"40", 1);
+    as_write_reg(x"00", 1);
 
-    wait until rising_edge(camera_pixclk);
-    wait for 2*clock_period;
-    camera_frame_valid <= '0';
+    -- While streaming, only the buffer being written keeps its address
+    wait for 4*clock_period;
+    as_write_reg(x"24", 16#55AA00#);
+    as_read_reg(x"24", readback);
+    assert to_integer(unsigned(readback)) = 16#55AA00#
+        report "Idle ring buffer not swapped while streaming" severity error;
+    as_write_reg(x"24", ring_base + frame_bytes);
+    as_write_reg(x"20", 16#55AA00#);
+    as_read_reg(x"20", readback);
+    assert to_integer(unsigned(readback)) = ring_base
+        report "Ring buffer being written was swapped" severity error;
 
-    wait for clock_period;
-    camera_frame_valid <= '1';
+    for F in 0 to frame_count-1 loop
+        send_frame;
+    end loop;
+
+    as_write_reg(x"00", 2);
 
+    assert irq = '1' report "Frame done interrupt not raised" severity error;
+    as_write_reg(x"44", 1);
     wait for clock_period;
+    assert irq = '0' report "Frame done interrupt not acknowledged" severity error;
 
-    for J in 0 to screen_height-1 loop
-        for I in 0 to screen_width-1 loop
-            camera_line_valid <= '1';
+    -- Every buffer got a frame, the first one twice
+    assert beats_total = frame_count*frame_words
+        report "Unexpected number of beats written" severity error;
+    for I in 0 to ring_size-1 loop
+        assert beats(I) = ((frame_count - 1 - I)/ring_size + 1)*frame_words
+            report "Unexpected number of beats in buffer " & integer'image(I) severity error;
+    end loop;
 
-            if custom then
-                if (J <= 3) and (I >= screen_width-4)then
-                    camera_pixel_data <= (others => '1');
-                else
-                    camera_pixel_data <= (others => '0');
-                end if;
-            elsif horiz then
-                if (J mod 4 = 0) or (J mod 4 = 1) then
-                    camera_pixel_data <= (others => '1');
-                else
-                    camera_pixel_data <= (others => '0');
-                end if;
-            elsif square then
-                if (I >= screen_width/2 - square_size/2) and (I < screen_width/2 + square_size/2) and
-                   (J >= screen_height/2- square_size/2) and (J < screen_height/2+ square_size/2) then
-                    if green and ((I mod 2 = 0 and J mod 2 = 0) or (I mod 2 = 1 and J mod 2 = 1)) then
-                        --camera_pixel_data <= std_logic_vector(cnt) & "0000000";
-                        camera_pixel_data <= std_logic_vector(to_unsigned(green_color,5))& "0000000";
-                    elsif red and (I mod 2 = 1 and J mod 2 = 0) then
-                        --camera_pixel_data <= std_logic_vector(cnt) & "0000000";
-                        camera_pixel_data <= std_logic_vector(to_unsigned(red_color,5))& "0000000";
-                    elsif blue and (I mod 2 = 0 and J mod 2 = 1) then
-                        camera_pixel_data <= std_logic_vector(to_unsigned(blue_color,5))&"0000000";
-                        --camera_pixel_data <= std_logic_vector(cnt) & "0000000";
-                    end if;
-                else
-                        camera_pixel_data <= (others => '0');
-                end if;
-            else
-                if green and ((I mod 2 = 0 and J mod 2 = 0) or (I mod 2 = 1 and J mod 2 = 1)) then
-                    camera_pixel_data <= std_logic_vector(cnt) & "0000000";
-                    --camera_pixel_data <= std_logic_vector(to_unsigned(green_color,5))& "0000000";
-                elsif red and (I mod 2 = 1 and J mod 2 = 0) then
-                    camera_pixel_data <= std_logic_vector(cnt) & "0000000";
-                    --camera_pixel_data <= std_logic_vector(to_unsigned(red_color,5))& "0000000";
-                elsif blue and (I mod 2 = 0 and J mod 2 = 1) then
-                    --camera_pixel_data <= std_logic_vector(to_unsigned(blue_color,5))&"0000000";
-                    camera_pixel_data <= std_logic_vector(cnt) & "0000000";
-                else
-                    camera_pixel_data <= (others => '0');
-                end if;
-            end if;
-            cnt <= (cnt + 1) mod 32 ;
-            cnt_total <= cnt_total  + 1;
-            wait for clock_period;
-        end loop;
-        camera_line_valid <= '0';
-        wait for clock_period;
+    as_read_reg(x"14", readback);
+    assert readback = std_logic_vector(to_unsigned((frame_count - 1) mod ring_size, 32) or x"80000000")
+        report "Wrong last completed index" severity error;
+    as_read_reg(x"10", readback);
+    assert to_integer(unsigned(readback)) = frame_count mod ring_size
+        report "Wrong write index" severity error;
+    as_read_reg(x"1C", readback);
+    assert to_integer(unsigned(readback)) = frame_count
+        report "Wrong frame sequence number" severity error;
+
+    -- Performance counters: snapshot and clear, then a second snapshot is empty
+    as_write_reg(x"64", 3);
+    as_read_reg(x"68", readback);
+    assert to_integer(unsigned(readback)) = frame_count
+        report "Wrong number of frames started" severity error;
+    as_read_reg(x"6C", readback);
+    assert to_integer(unsigned(readback)) = frame_count
+        report "Wrong number of frames completed" severity error;
+    as_read_reg(x"70", readback);
+    assert to_integer(unsigned(readback)) = 0
+        report "Unexpected end_fifo overflow" severity error;
+    as_read_reg(x"78", readback);
+    assert to_integer(unsigned(readback)) /= 0
+        report "DMA stalls not counted" severity error;
+    as_write_reg(x"64", 1);
+    as_read_reg(x"6C", readback);
+    assert to_integer(unsigned(readback)) = 0
+        report "Performance counters not cleared" severity error;
+
+    wait until rising_edge(clk);
+    wait for 100*clock_period;
+    as_read_reg(x"00", readback);
+    assert readback(0) = '0'
+        report "Camera still busy after stop" severity error;
+
+    -- Lines up to 2048 pixels, the 640x480 mode reads 1280, longer ones are
+    -- clamped to what debay buffers
+    as_write_reg(x"48", 1280);
+    as_read_reg(x"48", readback);
+    assert to_integer(unsigned(readback)) = 1280
+        report "Line of the 640x480 mode clamped" severity error;
+    as_write_reg(x"48", 4095);
+    as_read_reg(x"48", readback);
+    assert to_integer(unsigned(readback)) = 2048
+        report "Line width not clamped" severity error;
+
+    -- Single shot of a region of interest into the first buffer
+    as_write_reg(x"0C", 0);
+    as_write_reg(x"04", ring_base);
+    as_write_reg(x"48", roi_width);
+    as_write_reg(x"4C", roi_height);
+    as_write_reg(x"50", screen_width/4);
+    as_write_reg(x"54", screen_height/4);
+    as_read_reg(x"58", readback);
+    assert to_integer(unsigned(readback)) = roi_words
+        report "Wrong ROI frame length" severity error;
+
+    as_write_reg(x"00", 1);
+    send_frame;
+    as_read_reg(x"00", readback);
+    assert readback(0) = '0'
+        report "Camera still busy after ROI frame" severity error;
+    assert beats_total = frame_count*frame_words + roi_words
+        report "Unexpected number of beats for the ROI frame" severity error;
+
+    -- A bridge stalled for a whole frame overflows end_fifo, the frame is
+    -- dropped and the next one is captured whole
+    as_write_reg(x"44", 3);
+    am_stall <= '1';
+    as_write_reg(x"00", 1);
+    send_frame;
+    am_stall <= '0';
+    wait for 1000*clock_period;
+    as_read_reg(x"80", readback);
+    assert to_integer(unsigned(readback)) = 1
+        report "Dropped frame not counted" severity error;
+    as_read_reg(x"44", readback);
+    assert readback(1 downto 0) = "10"
+        report "Dropped frame not flagged" severity error;
+    as_read_reg(x"00", readback);
+    assert readback(0) = '0'
+        report "Camera still busy after dropped frame" severity error;
+
+    beats_before := beats_total;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    as_read_reg(x"1C", readback);
+    assert to_integer(unsigned(readback)) = 1
+        report "Frame after a drop not completed" severity error;
+    assert beats_total = beats_before + roi_words
+        report "Unexpected number of beats after a dropped frame" severity error;
+
+    -- Half size output, a quarter of the words
+    as_write_reg(x"84", 1);
+    as_read_reg(x"58", readback);
+    assert to_integer(unsigned(readback)) = roi_words/4
+        report "Wrong decimated frame length" severity error;
+    beats_before := beats_total;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    as_read_reg(x"1C", readback);
+    assert to_integer(unsigned(readback)) = 1
+        report "Decimated frame not completed" severity error;
+    assert beats_total = beats_before + roi_words/4
+        report "Unexpected number of beats for the decimated frame" severity error;
+
+    -- GRAY8, four pixels per word
+    as_write_reg(x"84", 0);
+    as_write_reg(x"88", 1);
+    as_read_reg(x"58", readback);
+    assert to_integer(unsigned(readback)) = roi_words/2
+        report "Wrong GRAY8 frame length" severity error;
+    beats_before := beats_total;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    assert beats_total = beats_before + roi_words/2
+        report "Unexpected number of beats for the GRAY8 frame" severity error;
+
+    -- The luminance is computed on the 12-bit samples: a grey below the
+    -- resolution of RGB565 is still seen
+    beats_before := beats_total;
+    word_expect <= x"04040404";
+    word_check <= true;
+    as_write_reg(x"00", 1);
+    send_bayer(16#040#, 16#040#, 16#040#);
+    wait for 100*clock_period;
+    word_check <= false;
+    assert beats_total = beats_before + roi_words/2
+        report "Unexpected number of beats for the dark GRAY8 frame" severity error;
+    assert word_errors = 0
+        report "GRAY8 not computed on the full samples" severity error;
+
+    -- RAW12, two Bayer samples per word
+    as_write_reg(x"88", 2);
+    as_read_reg(x"58", readback);
+    assert to_integer(unsigned(readback)) = roi_width*roi_height/2
+        report "Wrong RAW12 frame length" severity error;
+    beats_before := beats_total;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    assert beats_total = beats_before + roi_width*roi_height/2
+        report "Unexpected number of beats for the RAW12 frame" severity error;
+
+    -- Statistics of the last frame, debayered whatever the output format
+    as_read_reg(std_logic_vector(to_unsigned(16#304#, 10)), readback);
+    assert to_integer(unsigned(readback)) = roi_width/2*roi_height/2
+        report "Wrong number of pixels in the statistics" severity error;
+    hist_total := 0;
+    for I in 0 to 63 loop
+        as_read_reg(std_logic_vector(to_unsigned(16#200# + 4*I, 10)), readback);
+        hist_total := hist_total + to_integer(unsigned(readback));
+    end loop;
+    assert hist_total = roi_width/2*roi_height/2
+        report "Histogram does not add up to the frame" severity error;
+
+    -- Preview mode, the frame goes to the stream and nothing to memory
+    as_write_reg(x"88", 0);
+    as_write_reg(x"18", 2);
+    beats_before := beats_total;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    as_read_reg(x"1C", readback);
+    assert to_integer(unsigned(readback)) = 1
+        report "Preview frame not completed" severity error;
+    assert st_beats = roi_words
+        report "Unexpected number of words on the preview stream" severity error;
+    assert st_starts = 1 and st_ends = 1
+        report "Preview frame not sent as one packet" severity error;
+    assert beats_total = beats_before
+        report "Preview frame written to memory" severity error;
+    as_write_reg(x"00", 2);
+    wait for 100*clock_period;
+
+    -- Display handoff, the completed buffer is announced once
+    as_write_reg(x"18", 4);
+    as_write_reg(x"04", ring_base + frame_bytes);
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    assert disp_count = 1
+        report "Completed frame not handed to the display" severity error;
+    assert to_integer(unsigned(disp_last)) = ring_base + frame_bytes
+        report "Wrong buffer handed to the display" severity error;
+
+    -- While the display reads the buffer it was handed, the ring skips it and
+    -- the frames completed meanwhile are not handed over
+    as_write_reg(x"0C", ring_size);
+    lcd_reading <= true;
+    disp_before := disp_count;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    assert disp_count = disp_before + 1 and to_integer(unsigned(disp_last)) = ring_base
+        report "First ring buffer not handed to the display" severity error;
+    beats_buf := beats;
+    for F in 0 to ring_size-1 loop
+        send_frame;
     end loop;
+    wait for 100*clock_period;
+    assert disp_count = disp_before + 1
+        report "Frame handed to the display while it was busy" severity error;
+    assert beats(0) = beats_buf(0)
+        report "Buffer being displayed was overwritten" severity error;
+    assert beats(1) = beats_buf(1) + 2*roi_words and beats(2) = beats_buf(2) + roi_words
+        report "Ring did not skip the buffer being displayed" severity error;
+    lcd_reading <= false;
+    send_frame;
+    wait for 100*clock_period;
+    assert disp_count = disp_before + 2 and to_integer(unsigned(disp_last)) = ring_base + 2*frame_bytes
+        report "Frame not handed to the display once it was free" severity error;
+    as_write_reg(x"00", 2);
+    wait for 100*clock_period;
+    as_write_reg(x"0C", 0);
+
+    -- Timestamps of the oldest committed frame, in order, then popped
+    as_read_reg(std_logic_vector(to_unsigned(16#108#, 10)), readback);
+    level := to_integer(unsigned(readback));
+    assert level /= 0
+        report "No frame timestamp recorded" severity error;
+    as_read_reg(std_logic_vector(to_unsigned(16#114#, 10)), readback);
+    ts_start := unsigned(readback);
+    as_read_reg(std_logic_vector(to_unsigned(16#11C#, 10)), readback);
+    ts_last := unsigned(readback);
+    as_read_reg(std_logic_vector(to_unsigned(16#124#, 10)), readback);
+    ts_done := unsigned(readback);
+    assert ts_start < ts_last and ts_start < ts_done
+        report "Frame timestamps out of order" severity error;
+    as_write_reg(std_logic_vector(to_unsigned(16#10C#, 10)), 0);
+    as_read_reg(std_logic_vector(to_unsigned(16#108#, 10)), readback);
+    assert to_integer(unsigned(readback)) = level - 1
+        report "Timestamp record not popped" severity error;
+
+    -- A run of ring_size frames from one start, each one frame_bytes after
+    -- the previous, then the camera stops on its own
+    as_write_reg(x"18", 0);
+    as_write_reg(x"04", ring_base);
+    as_write_reg(x"98", frame_bytes);
+    as_write_reg(x"94", ring_size);
+    beats_buf := beats;
+    beats_before := beats_total;
+    as_write_reg(x"00", 1);
+    for F in 0 to ring_size-1 loop
+        send_frame;
+    end loop;
+    wait for 100*clock_period;
+    as_read_reg(x"00", readback);
+    assert readback(1 downto 0) = "00"
+        report "Camera still busy after the last frame of the run" severity error;
+    as_read_reg(x"1C", readback);
+    assert to_integer(unsigned(readback)) = ring_size
+        report "Wrong number of frames in the run" severity error;
+    for I in 0 to ring_size-1 loop
+        assert beats(I) = beats_buf(I) + roi_words
+            report "Unexpected number of beats in run frame " & integer'image(I) severity error;
+    end loop;
+    send_frame;
+    wait for 100*clock_period;
+    assert beats_total = beats_before + ring_size*roi_words
+        report "Frame written after the end of the run" severity error;
+
+    -- The last frame of a run is dropped, the camera takes one more frame
+    as_write_reg(x"44", 3);
+    as_write_reg(x"00", 1);
+    for F in 0 to ring_size-2 loop
+        send_frame;
+    end loop;
+    am_stall <= '1';
+    send_frame;
+    am_stall <= '0';
+    wait for 1000*clock_period;
+    as_read_reg(x"44", readback);
+    assert readback(1) = '1'
+        report "Last frame of the run not dropped" severity error;
+    as_read_reg(x"00", readback);
+    assert readback(0) = '1'
+        report "Dropped last frame of the run not taken again" severity error;
+    beats_before := beats_total;
+    send_frame;
+    wait for 100*clock_period;
+    as_read_reg(x"00", readback);
+    assert readback(1 downto 0) = "00"
+        report "Camera still busy after the retaken frame" severity error;
+    as_read_reg(x"1C", readback);
+    assert to_integer(unsigned(readback)) = ring_size
+        report "Run short of a frame after a drop" severity error;
+    assert beats_total = beats_before + roi_words
+        report "Unexpected number of beats for the retaken frame" severity error;
+    as_write_reg(x"44", 3);
+    as_write_reg(x"94", 0);
+
+    -- Compressed frame, shorter than its RGB565 length and committed whole.
+    -- The same frame is first taken in RGB565 so both can be compared.
+    write(out_line, string'("k 1"));
+    writeline(rice_file, out_line);
+    as_write_reg(x"9C", 1);
+    rice_dump <= 1;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    rice_dump <= 2;
+    as_write_reg(x"88", 3);
+    beats_before := beats_total;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    rice_dump <= 0;
+    as_read_reg(x"00", readback);
+    assert readback(0) = '0'
+        report "Camera still busy after compressed frame" severity error;
+    as_read_reg(x"1C", readback);
+    assert to_integer(unsigned(readback)) = 1
+        report "Compressed frame not completed" severity error;
+    as_read_reg(x"A0", readback);
+    assert to_integer(unsigned(readback)) /= 0 and to_integer(unsigned(readback)) < roi_words
+        report "Unexpected compressed frame length" severity error;
+    assert beats_total = beats_before + to_integer(unsigned(readback))
+        report "Compressed length does not match the words written" severity error;
+
+    -- A format out of range is clamped like the other settings
+    as_write_reg(x"88", 7);
+    as_read_reg(x"88", readback);
+    assert to_integer(unsigned(readback)) = 4
+        report "Format out of range not clamped" severity error;
+
+    -- YUV422, two pixels per word like RGB565
+    as_write_reg(x"88", 4);
+    as_write_reg(x"A4", 0);
+    as_read_reg(x"58", readback);
+    assert to_integer(unsigned(readback)) = roi_words
+        report "Wrong YUV422 frame length" severity error;
+    beats_before := beats_total;
+    yuv_check <= true;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    yuv_check <= false;
+    assert beats_total = beats_before + roi_words
+        report "Unexpected number of beats for the YUV422 frame" severity error;
+    assert yuv_errors = 0
+        report "YUV422 chroma of a grey frame is not neutral" severity error;
+    as_write_reg(x"88", 0);
+
+    -- Saturated colours round one past the range and are clamped, words are
+    -- V Y1 U Y0: blue for U, red for V, white for Y
+    assert yuv888(x"0000FF", x"0000FF", "00")(15 downto 8) = x"FF"
+        report "Full range U of blue not clamped" severity error;
+    assert yuv888(x"FF0000", x"FF0000", "00")(31 downto 24) = x"FF"
+        report "Full range V of red not clamped" severity error;
+    assert yuv888(x"0000FF", x"0000FF", "10")(15 downto 8) = x"FF"
+        report "BT.709 full range U of blue not clamped" severity error;
+    assert yuv888(x"FF0000", x"FF0000", "10")(31 downto 24) = x"FF"
+        report "BT.709 full range V of red not clamped" severity error;
+    assert yuv888(x"FFFFFF", x"FFFFFF", "00") = x"80FF80FF"
+        report "Full range white not saturated" severity error;
+    assert yuv888(x"0000FF", x"0000FF", "01")(15 downto 8) = x"F0"
+        report "Studio range U of blue out of range" severity error;
+    assert yuv888(x"FFFFFF", x"000000", "01") = x"801080EB"
+        report "Studio range white and black out of range" severity error;
+    -- Y of the full range BT.601 matrix is the GRAY8 luminance
+    assert yuv888(x"C86432", x"3264C8", "00")(7 downto 0) = luma888(x"C8", x"64", x"32") and
+           yuv888(x"C86432", x"3264C8", "00")(23 downto 16) = luma888(x"32", x"64", x"C8")
+        report "Full range BT.601 Y differs from the GRAY8 luminance" severity error;
+
+    -- Sobel gradient of horizontal stripes: Gx is 0 and the rows above and
+    -- below a pixel are the same, so the whole frame is 0
+    as_write_reg(x"A8", 2);
+    beats_before := beats_total;
+    conv_check <= true;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    conv_check <= false;
+    assert beats_total = beats_before + roi_words
+        report "Unexpected number of beats for the convolved frame" severity error;
+    assert conv_pixels = 0
+        report "Sobel gradient of horizontal stripes is not 0" severity error;
+
+    -- Difference with the pixel above, 255 everywhere but on the border
+    as_write_reg(x"AC", 16#000100#);
+    as_write_reg(x"B0", 16#00FF00#);
+    as_write_reg(x"B4", 0);
+    as_write_reg(x"A8", 1);
+    beats_before := beats_total;
+    conv_check <= true;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    conv_check <= false;
+    assert beats_total = beats_before + roi_words
+        report "Unexpected number of beats for the convolved frame" severity error;
+    assert conv_pixels = (roi_width/2 - 2)*(roi_height/2 - 2)
+        report "Wrong number of edge pixels" severity error;
+    as_write_reg(x"A8", 0);
+
+    -- Motion against a white previous frame: the black rows differ by 255
+    -- on every pixel and each tile of 1 word by 2 lines holds one of them
+    as_write_reg(x"404", 0);
+    as_write_reg(x"400", 1);
+    wait for 10*clock_period;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    as_read_reg(x"408", readback);
+    assert to_integer(unsigned(readback)) = 1
+        report "Motion result not published" severity error;
+    as_read_reg(x"410", readback);
+    assert to_integer(unsigned(readback)) = 20*15
+        report "Wrong number of changed tiles" severity error;
+    as_read_reg(x"40C", readback);
+    assert to_integer(unsigned(readback)) = (roi_width/2)*(roi_height/4)*255
+        report "Wrong motion score" severity error;
+    as_read_reg(x"440", readback);
+    assert readback = x"000FFFFF"
+        report "Wrong motion map" severity error;
+
+    -- Above the threshold only
+    as_write_reg(x"404", 2*255);
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    as_read_reg(x"408", readback);
+    assert to_integer(unsigned(readback)) = 2
+        report "Motion result not published" severity error;
+    as_read_reg(x"410", readback);
+    assert to_integer(unsigned(readback)) = 0
+        report "Tiles changed below the threshold" severity error;
+    as_read_reg(x"414", readback);
+    assert to_integer(unsigned(readback)) = 0
+        report "Motion frames skipped" severity error;
+    as_write_reg(x"400", 0);
+
+    -- Video mode armed in the middle of a frame: the partial frame is
+    -- skipped, the next one captured whole, and once stopped nothing more is
+    -- written while the sensor keeps running
+    as_write_reg(x"18", 1);
+    as_write_reg(x"0C", 2);
+    beats_before := beats_total;
+    wait until rising_edge(camera_pixclk);
+    camera_frame_valid <= '1';
+    wait for clock_period;
+    send_lines(screen_height/2);
+    as_write_reg(x"00", 1);
+    send_lines(screen_height/2);
     camera_frame_valid <= '0';
     wait for 100*clock_period;
+    assert beats_total = beats_before
+        report "Partial frame captured in video mode" severity error;
+    send_frame;
+    wait for 100*clock_period;
+    assert beats_total = beats_before + roi_words
+        report "Frame after arming in video mode not captured whole" severity error;
+    as_write_reg(x"00", 2);
+    send_frame;
+    wait for 100*clock_period;
+    as_read_reg(x"00", readback);
+    assert readback(0) = '0'
+        report "Camera still busy after stop in video mode" severity error;
+    assert beats_total = beats_before + roi_words
+        report "Frame written after stop in video mode" severity error;
+    as_write_reg(x"0C", 0);
+    as_write_reg(x"18", 0);
+
+    -- A stage between the source and the sink shortens the frame: the DMA
+    -- closes it on endofpacket and the next frame is written whole again
+    halve <= true;
+    beats_before := beats_total;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    halve <= false;
+    as_read_reg(x"00", readback);
+    assert readback(0) = '0'
+        report "Camera still busy after a shortened frame" severity error;
+    as_read_reg(x"1C", readback);
+    assert to_integer(unsigned(readback)) = 1
+        report "Shortened frame not completed" severity error;
+    as_read_reg(x"A0", readback);
+    assert to_integer(unsigned(readback)) = roi_words/2 + 1
+        report "Unexpected shortened frame length" severity error;
+    assert beats_total = beats_before + roi_words/2 + 1
+        report "Unexpected number of beats for the shortened frame" severity error;
+    beats_before := beats_total;
+    as_write_reg(x"00", 1);
+    send_frame;
+    wait for 100*clock_period;
+    assert beats_total = beats_before + roi_words
+        report "Frame after a shortened one not written whole" severity error;
+
+    -- Every word of the pixel stream belongs to a packet, one per frame
+    assert pix_errors = 0
+        report "Pixel stream word outside of a packet" severity error;
+    assert pix_packets /= 0 and not pix_in_packet
+        report "Pixel stream packets not closed" severity error;
 
     std.env.finish;
 end process;
@@ -273,6 +1037,60 @@ begin
 
 
         if AM_write = '1' and AM_waitRequest = '0' then
+            beats((to_integer(unsigned(AM_address)) - ring_base)/frame_bytes) <=
+                beats((to_integer(unsigned(AM_address)) - ring_base)/frame_bytes) + 1;
+            beats_total <= beats_total + 1;
+        end if;
+
+        if yuv_check and AM_write = '1' and AM_waitRequest = '0' and
+           (AM_dataWrite(15 downto 8) /= x"80" or AM_dataWrite(31 downto 24) /= x"80") then
+            yuv_errors <= yuv_errors + 1;
+        end if;
+
+        if rice_dump /= 0 and AM_write = '1' and AM_waitRequest = '0' then
+            if rice_dump = 1 then
+                write(out_line, string'("p "));
+            else
+                write(out_line, string'("c "));
+            end if;
+            hwrite(out_line, AM_dataWrite);
+            writeline(rice_file, out_line);
+        end if;
+
+        if word_check and AM_write = '1' and AM_waitRequest = '0' and AM_dataWrite /= word_expect then
+            word_errors <= word_errors + 1;
+        end if;
+
+        if conv_check and AM_write = '1' and AM_waitRequest = '0' then
+            if AM_dataWrite(15 downto 0) /= x"0000" and AM_dataWrite(31 downto 16) /= x"0000" then
+                conv_pixels <= conv_pixels + 2;
+            elsif AM_dataWrite /= x"00000000" then
+                conv_pixels <= conv_pixels + 1;
+            end if;
+        end if;
+
+        if ST_valid = '1' and ST_ready = '1' then
+            st_beats <= st_beats + 1;
+            if ST_startofpacket = '1' then
+                st_starts <= st_starts + 1;
+            end if;
+            if ST_endofpacket = '1' then
+                st_ends <= st_ends + 1;
+            end if;
+        end if;
+
+        if disp_go = '1' then
+            disp_count <= disp_count + 1;
+            disp_last <= disp_address;
+        end if;
+        if disp_go = '1' and lcd_reading then
+            disp_busy <= '1';
+        elsif not lcd_reading then
+            disp_busy <= '0';
+        end if;
+
+        -- Only the first frame is dumped
+        if AM_write = '1' and AM_waitRequest = '0' and beats_total < frame_words then
             write(out_line, to_integer(unsigned(AM_dataWrite(15 downto 11))));
             write(out_line, string'(" "));
             write(out_line, to_integer(unsigned(AM_dataWrite(10 downto 6))));
@@ -298,10 +1116,51 @@ waitreq: process(clk)
 begin
     if rising_edge(clk) then
         am_write_prev <= AM_write;
+        -- The LCD controller takes a word every other cycle
+        ST_ready <= not ST_ready;
     end if;
 end process;
 
 AM_waitRequest <= '1' when am_write_prev = '0' and AM_write = '1' else
+                  '1' when am_stall = '1' else
+                  '0';
+
+snk_valid <= pix_valid when not halve or pix_sop = '1' or halve_odd = '0' or pix_eop = '1' else
+             '0';
+
+pix_stream: process(camera_pixclk)
+begin
+    if rising_edge(camera_pixclk) then
+        if pix_valid = '1' and pix_ready = '1' then
+            halve_odd <= pix_sop or not halve_odd;
+            if (pix_sop = '1') = pix_in_packet then
+                pix_errors <= pix_errors + 1;
+            end if;
+            if pix_eop = '1' then
+                pix_packets <= pix_packets + 1;
+                pix_in_packet <= false;
+            else
+                pix_in_packet <= true;
+            end if;
+        end if;
+    end if;
+end process;
+
+-- One read burst at a time, its words follow on the next cycles
+mm_slave: process(clk)
+begin
+    if rising_edge(clk) then
+        MM_readDataValid <= '0';
+        if mm_left /= 0 then
+            MM_readDataValid <= '1';
+            mm_left <= mm_left - 1;
+        elsif MM_read = '1' then
+            mm_left <= to_integer(unsigned(MM_burstCount));
+        end if;
+    end if;
+end process;
+
+MM_waitRequest <= '1' when mm_left /= 0 else
                   '0';
 
 end rtl;
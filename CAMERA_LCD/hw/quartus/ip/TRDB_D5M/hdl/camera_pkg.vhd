@@ -0,0 +1,125 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Helpers shared by the pixel pipeline stages
+
+package camera_pkg is
+    -- Largest captured window in sensor pixels, debay buffers a row as
+    -- WIDTH_MAX/2 pairs of pixels
+    constant WIDTH_MAX : natural := 2048;
+    constant HEIGHT_MAX : natural := 2048;
+    -- Largest frame written by the DMA in words, RAW12 of the largest window
+    -- with two samples per word. Every format, scale and compressed frame
+    -- fits, so the DMA never cuts a frame short.
+    constant FRAME_WORDS_MAX : natural := WIDTH_MAX * HEIGHT_MAX / 2;
+
+    -- Luminance of 8-bit components, Y = (77 R + 150 G + 29 B) / 256 rounded,
+    -- the Y of YUV422 in the full range BT.601 matrix
+    function luma888(r, g, b : std_logic_vector(7 downto 0)) return std_logic_vector;
+    -- Luminance of an RGB565 pixel, on the components widened to 8 bits
+    function luma565(p : std_logic_vector(15 downto 0)) return std_logic_vector;
+    -- YUV 4:2:2 word of two pixels of 8-bit components, R in the high byte
+    -- and B in the low one: Y0 in the low byte, then U, Y1 and V, the chroma
+    -- of the average of both pixels. Bit 0 of matrix selects the studio range
+    -- (Y 16-235, U and V 16-240) instead of the full range, bit 1 the BT.709
+    -- coefficients instead of BT.601. Components are clamped to their range,
+    -- saturated colours round one past it.
+    function yuv888(p0, p1 : std_logic_vector(23 downto 0);
+                    matrix : std_logic_vector(1 downto 0)) return std_logic_vector;
+end package camera_pkg;
+
+package body camera_pkg is
+    function luma888(r, g, b : std_logic_vector(7 downto 0)) return std_logic_vector is
+        variable y : unsigned(15 downto 0);
+    begin
+        y := to_unsigned(77, 8) * unsigned(r) + to_unsigned(150, 8) * unsigned(g) +
+             to_unsigned(29, 8) * unsigned(b) + 128;
+        return std_logic_vector(y(15 downto 8));
+    end function;
+
+    function luma565(p : std_logic_vector(15 downto 0)) return std_logic_vector is
+    begin
+        return luma888(p(15 downto 11) & p(15 downto 13), p(10 downto 5) & p(10 downto 9),
+                       p(4 downto 0) & p(4 downto 2));
+    end function;
+
+    -- Rows Y, U and V of the conversion on 8-bit R, G and B, scaled by 256.
+    -- The chroma rows add up to 0 so grey has no colour.
+    type yuv_coef_t is array (0 to 8) of integer range -128 to 255;
+    type yuv_matrix_t is array (0 to 3) of yuv_coef_t;
+    constant YUV_MATRIX : yuv_matrix_t := (
+        (77, 150, 29, -43, -85, 128, 128, -107, -21),  -- BT.601, full range
+        (66, 129, 25, -38, -74, 112, 112, -94, -18),   -- BT.601, studio range
+        (54, 183, 19, -29, -99, 128, 128, -116, -12),  -- BT.709, full range
+        (47, 157, 16, -26, -86, 112, 112, -102, -10)   -- BT.709, studio range
+    );
+
+    -- Component limited to lo..hi on 8 bits
+    function clamp8(x : signed; lo, hi : integer) return std_logic_vector is
+    begin
+        if x < lo then
+            return std_logic_vector(to_unsigned(lo, 8));
+        elsif x > hi then
+            return std_logic_vector(to_unsigned(hi, 8));
+        end if;
+        return std_logic_vector(x(7 downto 0));
+    end function;
+
+    function yuv888(p0, p1 : std_logic_vector(23 downto 0);
+                    matrix : std_logic_vector(1 downto 0)) return std_logic_vector is
+        variable c : yuv_coef_t;
+        variable k : signed(9 downto 0);
+        variable r0, g0, b0, r1, g1, b1 : signed(9 downto 0);
+        variable y0, y1, u, v : signed(20 downto 0);
+        variable y_lo, y_hi, c_lo, c_hi : integer range 0 to 255;
+        variable word : std_logic_vector(31 downto 0);
+    begin
+        c := YUV_MATRIX(to_integer(unsigned(matrix)));
+        r0 := signed("00" & p0(23 downto 16));
+        g0 := signed("00" & p0(15 downto 8));
+        b0 := signed("00" & p0(7 downto 0));
+        r1 := signed("00" & p1(23 downto 16));
+        g1 := signed("00" & p1(15 downto 8));
+        b1 := signed("00" & p1(7 downto 0));
+
+        y0 := to_signed(128, 21);
+        y1 := to_signed(128, 21);
+        -- Rounded on the sum of both pixels
+        u := to_signed(256, 21);
+        v := to_signed(256, 21);
+
+        k := to_signed(c(0), 10);
+        y0 := y0 + k * r0;
+        y1 := y1 + k * r1;
+        k := to_signed(c(1), 10);
+        y0 := y0 + k * g0;
+        y1 := y1 + k * g1;
+        k := to_signed(c(2), 10);
+        y0 := y0 + k * b0;
+        y1 := y1 + k * b1;
+        u := u + to_signed(c(3), 10) * (r0 + r1) + to_signed(c(4), 10) * (g0 + g1) + to_signed(c(5), 10) * (b0 + b1);
+        v := v + to_signed(c(6), 10) * (r0 + r1) + to_signed(c(7), 10) * (g0 + g1) + to_signed(c(8), 10) * (b0 + b1);
+
+        y0 := shift_right(y0, 8);
+        y1 := shift_right(y1, 8);
+        y_lo := 0;
+        y_hi := 255;
+        c_lo := 0;
+        c_hi := 255;
+        if matrix(0) = '1' then
+            y0 := y0 + 16;
+            y1 := y1 + 16;
+            y_lo := 16;
+            y_hi := 235;
+            c_lo := 16;
+            c_hi := 240;
+        end if;
+        u := shift_right(u, 9) + 128;
+        v := shift_right(v, 9) + 128;
+
+        word := clamp8(v, c_lo, c_hi) & clamp8(y1, y_lo, y_hi) &
+                clamp8(u, c_lo, c_hi) & clamp8(y0, y_lo, y_hi);
+        return word;
+    end function;
+end package body camera_pkg;
@@ -0,0 +1,321 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+LIBRARY altera_mf;
+USE altera_mf.all;
+
+-- Latency of the module: 0 cycle when disabled, one line and 2 cycles otherwise
+-- 3x3 convolution of the luminance of the decimated pixels, written back as
+-- grey RGB565 pixels and as their luminance so every output format applies. Two kernels of signed
+-- coefficients are programmed, the result is |K0| or |K0| + |K1| (the
+-- gradient magnitude with the Sobel kernels of reset), shifted right and
+-- saturated to 8 bits.
+-- The two previous lines are held in line_fifo, one word of two lumas per
+-- entry, so lines up to 1024 pixels are supported. The output frame has the
+-- size of the input one: a pixel is written once its right neighbour has
+-- arrived, one line late, and the last line is written after the end of the
+-- frame. The border rows and columns are 0.
+-- A word is taken at most every other cycle, one pixel per cycle.
+
+entity conv is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Decimation Interface
+        dec_rgb_pixeldata_x2 : in std_logic_vector(31 downto 0);
+        dec_luma_x2 : in std_logic_vector(15 downto 0);
+        dec_rgb888_x2 : in std_logic_vector(47 downto 0);
+        dec_write : in std_logic;
+
+        -- Acquisition Interface
+        acq_frame_valid : in std_logic;
+
+        -- pack Interface
+        pack_rgb_pixeldata_x2 : out std_logic_vector(31 downto 0);
+        pack_luma_x2 : out std_logic_vector(15 downto 0);
+        pack_rgb888_x2 : out std_logic_vector(47 downto 0);
+        pack_write : out std_logic;
+
+        -- Global Controller Interface
+        -- 0: disabled, 1: |K0|, 2: |K0| + |K1|
+        glob_mode : in std_logic_vector(1 downto 0);
+        glob_shift : in std_logic_vector(3 downto 0);
+        -- Coefficients row by row from the top left one, in the low byte
+        glob_k0 : in std_logic_vector(71 downto 0);
+        glob_k1 : in std_logic_vector(71 downto 0);
+        -- Size of the decimated frame
+        glob_line_words : in std_logic_vector(10 downto 0);
+        glob_lines : in std_logic_vector(11 downto 0);
+        -- The end of a frame is still being written
+        glob_busy : out std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end conv;
+
+architecture arch of conv is
+    constant MODE_OFF      : std_logic_vector(1 downto 0) := "00";
+    constant MODE_GRADIENT : std_logic_vector(1 downto 0) := "10";
+
+    -- Lumas of the top, middle and bottom rows
+    type rows_t is array (0 to 2) of std_logic_vector(15 downto 0);
+    type edge_t is array (0 to 2) of std_logic_vector(7 downto 0);
+    -- Four consecutive lumas of each row, the two outputs are centred on the
+    -- second and third ones
+    type win_t is array (0 to 2) of std_logic_vector(31 downto 0);
+
+    component line_fifo is
+        port(
+            clock		: in std_logic ;
+            data		: in std_logic_vector (15 downto 0);
+            rdreq		: in std_logic ;
+            sclr		: in std_logic ;
+            wrreq		: in std_logic ;
+            q		: out std_logic_vector (15 downto 0)
+        );
+    end component line_fifo;
+
+    -- Kernel applied to the 3x3 lumas starting at column col of the window
+    function apply(k : std_logic_vector(71 downto 0); w : win_t; col : natural) return signed is
+        variable s : signed(19 downto 0);
+        variable c : signed(7 downto 0);
+        variable p : signed(8 downto 0);
+    begin
+        s := (others => '0');
+        for r in 0 to 2 loop
+            for i in 0 to 2 loop
+                c := signed(k(24*r + 8*i + 7 downto 24*r + 8*i));
+                p := signed('0' & w(r)(8*(col + i) + 7 downto 8*(col + i)));
+                s := s + c * p;
+            end loop;
+        end loop;
+        return s;
+    end function;
+
+    -- Luminance of the result
+    function result(s0, s1 : signed(19 downto 0); mode : std_logic_vector(1 downto 0);
+                    shift : std_logic_vector(3 downto 0)) return std_logic_vector is
+        variable v : unsigned(20 downto 0);
+        variable m : std_logic_vector(7 downto 0);
+    begin
+        v := resize(unsigned(abs(s0)), 21);
+        if mode = MODE_GRADIENT then
+            v := v + resize(unsigned(abs(s1)), 21);
+        end if;
+        v := shift_right(v, to_integer(unsigned(shift)));
+        if v > 255 then
+            m := (others => '1');
+        else
+            m := std_logic_vector(v(7 downto 0));
+        end if;
+        return m;
+    end function;
+
+    -- Grey RGB565 pixel of a luminance
+    function gray565(m : std_logic_vector(7 downto 0)) return std_logic_vector is
+    begin
+        return m(7 downto 3) & m(7 downto 2) & m(7 downto 3);
+    end function;
+
+    signal enable : std_logic;
+    signal frame_valid_prev : std_logic;
+    signal frame_start : std_logic;
+    signal in_write : std_logic;
+    signal line_words : natural range 0 to 2047;
+    signal lines : natural range 0 to 4095;
+
+    -- Position of the incoming word
+    signal word_cnt : natural range 0 to 2047;
+    signal row_cnt : natural range 0 to 4095;
+
+    signal cur_luma : std_logic_vector(15 downto 0);
+    signal fifo_clear : std_logic;
+    signal fifo1_read, fifo2_write, fifo2_read : std_logic;
+    signal fifo1_q, fifo2_q : std_logic_vector(15 downto 0);
+    signal cur : rows_t;
+
+    -- Previous word of each row and last luma of the word before
+    signal prev_reg : rows_t;
+    signal edge_reg : edge_t;
+
+    -- Window of the next output word and its borders
+    signal win_reg : win_t;
+    signal win_valid_reg : std_logic;
+    signal win_left_reg, win_right_reg, win_zero_reg : std_logic;
+    -- Last word of a line, written in the cycle after the line ends
+    signal pend_reg : win_t;
+    signal pend_valid_reg : std_logic;
+    signal pend_zero_reg : std_logic;
+    -- Zero words of the bottom row left to write
+    signal flush_cnt : natural range 0 to 2047;
+
+    signal out_data_reg : std_logic_vector(31 downto 0);
+    signal out_luma_reg : std_logic_vector(15 downto 0);
+    signal out_write_reg : std_logic;
+begin
+    enable <= '0' when glob_mode = MODE_OFF else
+              '1';
+    in_write <= dec_write and enable;
+    frame_start <= acq_frame_valid and not frame_valid_prev;
+
+    line_words <= to_integer(unsigned(glob_line_words));
+    lines <= to_integer(unsigned(glob_lines));
+
+    cur_luma <= dec_luma_x2;
+
+    -- The first fifo delays by one line, the second one by two
+    fifo1_read <= '1' when (in_write = '1') and (row_cnt >= 1) else
+                  '0';
+    fifo2_write <= fifo1_read;
+    fifo2_read <= '1' when (in_write = '1') and (row_cnt >= 2) else
+                  '0';
+    fifo_clear <= sys_soft_rst or frame_start;
+
+    cur(0) <= fifo2_q;
+    cur(1) <= fifo1_q;
+    cur(2) <= cur_luma;
+
+    process(clk, rst_n)
+        variable s00, s01, s10, s11 : signed(19 downto 0);
+        variable p0, p1 : std_logic_vector(7 downto 0);
+    begin
+        if rst_n = '0' then
+            frame_valid_prev <= '0';
+            word_cnt <= 0;
+            row_cnt <= 0;
+            prev_reg <= (others => (others => '0'));
+            edge_reg <= (others => (others => '0'));
+            win_reg <= (others => (others => '0'));
+            win_valid_reg <= '0';
+            win_left_reg <= '0';
+            win_right_reg <= '0';
+            win_zero_reg <= '0';
+            pend_reg <= (others => (others => '0'));
+            pend_valid_reg <= '0';
+            pend_zero_reg <= '0';
+            flush_cnt <= 0;
+            out_data_reg <= (others => '0');
+            out_luma_reg <= (others => '0');
+            out_write_reg <= '0';
+        elsif rising_edge(clk) then
+            frame_valid_prev <= acq_frame_valid;
+
+            -- Convolution of the window
+            s00 := apply(glob_k0, win_reg, 0);
+            s01 := apply(glob_k0, win_reg, 1);
+            s10 := apply(glob_k1, win_reg, 0);
+            s11 := apply(glob_k1, win_reg, 1);
+            p0 := result(s00, s10, glob_mode, glob_shift);
+            p1 := result(s01, s11, glob_mode, glob_shift);
+            if win_zero_reg = '1' or win_left_reg = '1' then
+                p0 := (others => '0');
+            end if;
+            if win_zero_reg = '1' or win_right_reg = '1' then
+                p1 := (others => '0');
+            end if;
+            out_data_reg <= gray565(p1) & gray565(p0);
+            out_luma_reg <= p1 & p0;
+            out_write_reg <= win_valid_reg;
+
+            -- Next window: the previous word once the current one gives its
+            -- right neighbour, then the last word of a line, then the bottom row
+            win_valid_reg <= '0';
+            win_left_reg <= '0';
+            win_right_reg <= '0';
+            win_zero_reg <= '0';
+            if in_write = '1' then
+                for r in 0 to 2 loop
+                    win_reg(r) <= cur(r)(7 downto 0) & prev_reg(r) & edge_reg(r);
+                    pend_reg(r) <= x"00" & cur(r) & prev_reg(r)(15 downto 8);
+                    prev_reg(r) <= cur(r);
+                    edge_reg(r) <= prev_reg(r)(15 downto 8);
+                end loop;
+                -- The middle row is the first one of the frame
+                if row_cnt = 1 then
+                    win_zero_reg <= '1';
+                    pend_zero_reg <= '1';
+                else
+                    pend_zero_reg <= '0';
+                end if;
+
+                if word_cnt /= 0 and row_cnt /= 0 then
+                    win_valid_reg <= '1';
+                end if;
+                if word_cnt = 1 then
+                    win_left_reg <= '1';
+                end if;
+
+                if word_cnt + 1 >= line_words then
+                    word_cnt <= 0;
+                    if row_cnt /= 0 then
+                        pend_valid_reg <= '1';
+                    end if;
+                    if row_cnt + 1 >= lines then
+                        row_cnt <= 0;
+                        flush_cnt <= line_words;
+                    else
+                        row_cnt <= row_cnt + 1;
+                    end if;
+                else
+                    word_cnt <= word_cnt + 1;
+                end if;
+            elsif pend_valid_reg = '1' then
+                win_reg <= pend_reg;
+                win_valid_reg <= '1';
+                win_right_reg <= '1';
+                win_zero_reg <= pend_zero_reg;
+                -- A line of a single word also starts at the left border
+                if line_words = 1 then
+                    win_left_reg <= '1';
+                end if;
+                pend_valid_reg <= '0';
+            elsif flush_cnt /= 0 then
+                win_valid_reg <= '1';
+                win_zero_reg <= '1';
+                flush_cnt <= flush_cnt - 1;
+            end if;
+
+            if fifo_clear = '1' then
+                word_cnt <= 0;
+                row_cnt <= 0;
+                pend_valid_reg <= '0';
+                flush_cnt <= 0;
+            end if;
+        end if;
+    end process;
+
+    pack_rgb_pixeldata_x2 <= out_data_reg when enable = '1' else
+                             dec_rgb_pixeldata_x2;
+    pack_luma_x2 <= out_luma_reg when enable = '1' else
+                    dec_luma_x2;
+    pack_rgb888_x2 <= out_luma_reg(15 downto 8) & out_luma_reg(15 downto 8) & out_luma_reg(15 downto 8) &
+                      out_luma_reg(7 downto 0) & out_luma_reg(7 downto 0) & out_luma_reg(7 downto 0) when enable = '1' else
+                      dec_rgb888_x2;
+    pack_write <= out_write_reg when enable = '1' else
+                  dec_write;
+
+    glob_busy <= '1' when (enable = '1') and ((pend_valid_reg = '1') or (flush_cnt /= 0) or
+                                              (win_valid_reg = '1') or (out_write_reg = '1')) else
+                 '0';
+
+line1: line_fifo port map(
+    clock => clk,
+    data => cur_luma,
+    rdreq => fifo1_read,
+    sclr => fifo_clear,
+    wrreq => in_write,
+    q => fifo1_q
+);
+
+line2: line_fifo port map(
+    clock => clk,
+    data => fifo1_q,
+    rdreq => fifo2_read,
+    sclr => fifo_clear,
+    wrreq => fifo2_write,
+    q => fifo2_q
+);
+
+end arch;
@@ -1,6 +1,7 @@
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
+use work.camera_pkg.all;
 
 LIBRARY altera_mf;
 USE altera_mf.all;
@@ -10,11 +11,15 @@ entity debay is
 		clk : in std_logic;
 		rst_n : in std_logic;
 
-        acq_pixeldata : in std_logic_vector(4 downto 0);
+        acq_pixeldata : in std_logic_vector(11 downto 0);
 		acq_row_even : in std_logic;
 		acq_valid : in std_logic;
 
 		end_rgb_pixeldata_x2 : out std_logic_vector(31 downto 0);
+        -- Luminance of the same two pixels on the full 12-bit samples
+        end_luma_x2 : out std_logic_vector(15 downto 0);
+        -- Same two pixels with 8-bit components, R G B from the high byte
+        end_rgb888_x2 : out std_logic_vector(47 downto 0);
         end_write : out std_logic;
 
         sys_soft_rst : in std_logic
@@ -24,10 +29,14 @@ end debay;
 architecture arch_debay of debay is
 
     signal column_even : std_logic;
-    signal pix_buff : std_logic_vector(4 downto 0);
+    signal pix_buff : std_logic_vector(11 downto 0);
     signal RGB_pix, RGB_pix_buff : std_logic_vector (15 downto 0);
+    -- Sum of both green samples
+    signal G_sum : unsigned(12 downto 0);
+    signal luma, luma_buff : std_logic_vector(7 downto 0);
+    signal RGB888_pix, RGB888_pix_buff : std_logic_vector(23 downto 0);
     signal RGB_pix_ready : std_logic;
-    signal fifo_data_in, fifo_data_out : std_logic_vector(9 downto 0);
+    signal fifo_data_in, fifo_data_out : std_logic_vector(23 downto 0);
     signal fifo_write : std_logic;
     signal fifo_read : std_logic;
 
@@ -36,11 +45,11 @@ architecture arch_debay of debay is
     component row_fifo is
         port(
             clock		: in std_logic ;
-            data		: in std_logic_vector (9 downto 0);
+            data		: in std_logic_vector (23 downto 0);
             rdreq		: in std_logic ;
 		    sclr		: in std_logic ;
             wrreq		: in std_logic ;
-            q		: out std_logic_vector (9 downto 0)
+            q		: out std_logic_vector (23 downto 0)
         );
     end component row_fifo;
 
@@ -52,6 +61,8 @@ begin
         cnt <= 0;
         pix_buff <= (others => '0');
         RGB_pix_buff <= (others => '0');
+        luma_buff <= (others => '0');
+        RGB888_pix_buff <= (others => '0');
     elsif rising_edge(clk) then
         if sys_soft_rst = '1' then
             cnt <= 0;
@@ -66,6 +77,8 @@ begin
 
             if (RGB_pix_ready = '1') then
                 RGB_pix_buff <= RGB_pix;
+                luma_buff <= luma;
+                RGB888_pix_buff <= RGB888_pix;
             end if;
         end if;
     end if;
@@ -82,12 +95,21 @@ fifo_read  <= '1' when (acq_row_even='0') and (column_even='0') and acq_valid='1
               '0';
 fifo_data_in <= acq_pixeldata & pix_buff;
 
-RGB_pix <= fifo_data_out(9 downto 5) &
-           std_logic_vector(unsigned('0' & fifo_data_out(4 downto 0)) +
-                            unsigned('0' & acq_pixeldata)) &
-           pix_buff;
+G_sum <= unsigned('0' & fifo_data_out(11 downto 0)) + unsigned('0' & acq_pixeldata);
+
+RGB_pix <= fifo_data_out(23 downto 19) &
+           std_logic_vector(G_sum(12 downto 7)) &
+           pix_buff(11 downto 7);
+
+RGB888_pix <= fifo_data_out(23 downto 16) &
+              std_logic_vector(G_sum(12 downto 5)) &
+              pix_buff(11 downto 4);
+
+luma <= luma888(RGB888_pix(23 downto 16), RGB888_pix(15 downto 8), RGB888_pix(7 downto 0));
 
 end_rgb_pixeldata_x2 <= RGB_pix & RGB_pix_buff;
+end_luma_x2 <= luma & luma_buff;
+end_rgb888_x2 <= RGB888_pix & RGB888_pix_buff;
 
 end_write <= '1' when (cnt = 3) and (acq_row_even = '0') else
              '0';
@@ -0,0 +1,121 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Latency of the module: 0 cycle
+-- Keeps one RGB pixel out of 2 or 4 in each direction and packs the kept
+-- pixels two per word again. A debayered line is written while the sensor
+-- row is odd, so lines are delimited by deb_row_even.
+-- The kept pixels of a line must be even: width multiple of 4 * factor, and
+-- the lines of a frame a multiple of factor: height multiple of 2 * factor.
+
+entity decimate is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Debayerization Interface
+        deb_rgb_pixeldata_x2 : in std_logic_vector(31 downto 0);
+        deb_luma_x2 : in std_logic_vector(15 downto 0);
+        deb_rgb888_x2 : in std_logic_vector(47 downto 0);
+        deb_write : in std_logic;
+        deb_row_even : in std_logic;
+
+        -- end_fifo Interface
+        end_rgb_pixeldata_x2 : out std_logic_vector(31 downto 0);
+        end_luma_x2 : out std_logic_vector(15 downto 0);
+        end_rgb888_x2 : out std_logic_vector(47 downto 0);
+        end_write : out std_logic;
+
+        -- Global Controller Interface
+        -- 0: full frame, 1: 1/2, 2: 1/4 in each direction
+        glob_scale : in std_logic_vector(1 downto 0);
+
+        sys_soft_rst : in std_logic
+    );
+end decimate;
+
+architecture arch of decimate is
+    signal row_even_prev : std_logic;
+    signal line_end : std_logic;
+    -- Line in the current group of factor lines, only the first one is kept
+    signal line_cnt_reg, line_cnt_next : natural range 0 to 3;
+    -- Input word in the current group of factor/2 words
+    signal word_cnt_reg, word_cnt_next : natural range 0 to 1;
+    -- First pixel of the next output word
+    signal half_reg, half_next : std_logic_vector(15 downto 0);
+    signal half_luma_reg, half_luma_next : std_logic_vector(7 downto 0);
+    signal half_rgb888_reg, half_rgb888_next : std_logic_vector(23 downto 0);
+    signal half_valid_reg, half_valid_next : std_logic;
+
+    signal line_last : natural range 0 to 3;
+    signal word_last : natural range 0 to 1;
+    -- The first pixel of the incoming word is kept
+    signal take : std_logic;
+begin
+    process(clk, rst_n)
+    begin
+        if rst_n = '0' then
+            row_even_prev <= '1';
+            line_cnt_reg <= 0;
+            word_cnt_reg <= 0;
+            half_reg <= (others => '0');
+            half_luma_reg <= (others => '0');
+            half_rgb888_reg <= (others => '0');
+            half_valid_reg <= '0';
+        elsif rising_edge(clk) then
+            row_even_prev <= deb_row_even;
+            line_cnt_reg <= line_cnt_next;
+            word_cnt_reg <= word_cnt_next;
+            half_reg <= half_next;
+            half_luma_reg <= half_luma_next;
+            half_rgb888_reg <= half_rgb888_next;
+            half_valid_reg <= half_valid_next;
+
+            if sys_soft_rst = '1' then
+                line_cnt_reg <= 0;
+                word_cnt_reg <= 0;
+                half_valid_reg <= '0';
+            end if;
+        end if;
+    end process;
+
+    line_last <= 1 when glob_scale = "01" else
+                 3 when glob_scale = "10" else
+                 0;
+    word_last <= 1 when glob_scale = "10" else
+                 0;
+
+    line_end <= deb_row_even and not row_even_prev;
+
+    line_cnt_next <= 0 when (line_end = '1') and (line_cnt_reg = line_last) else
+                     (line_cnt_reg + 1) when line_end = '1' else
+                     line_cnt_reg;
+
+    word_cnt_next <= 0 when line_end = '1' else
+                     0 when (deb_write = '1') and (word_cnt_reg = word_last) else
+                     (word_cnt_reg + 1) when deb_write = '1' else
+                     word_cnt_reg;
+
+    take <= '1' when (deb_write = '1') and (line_cnt_reg = 0) and (word_cnt_reg = 0) else
+            '0';
+
+    half_next <= deb_rgb_pixeldata_x2(15 downto 0) when (take = '1') and (half_valid_reg = '0') else
+                 half_reg;
+    half_luma_next <= deb_luma_x2(7 downto 0) when (take = '1') and (half_valid_reg = '0') else
+                      half_luma_reg;
+    half_rgb888_next <= deb_rgb888_x2(23 downto 0) when (take = '1') and (half_valid_reg = '0') else
+                        half_rgb888_reg;
+    half_valid_next <= '0' when line_end = '1' else
+                       not half_valid_reg when take = '1' else
+                       half_valid_reg;
+
+    end_rgb_pixeldata_x2 <= deb_rgb_pixeldata_x2 when glob_scale = "00" else
+                            deb_rgb_pixeldata_x2(15 downto 0) & half_reg;
+    end_luma_x2 <= deb_luma_x2 when glob_scale = "00" else
+                   deb_luma_x2(7 downto 0) & half_luma_reg;
+    end_rgb888_x2 <= deb_rgb888_x2 when glob_scale = "00" else
+                     deb_rgb888_x2(23 downto 0) & half_rgb888_reg;
+    end_write <= deb_write when glob_scale = "00" else
+                 take and half_valid_reg;
+end arch;
@@ -0,0 +1,125 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Latency of the module: 0 cycle
+-- Avalon-ST sink of the pixel pipeline, the counterpart of packetize. The
+-- stages placed between the two may change the number of words of a frame,
+-- so each packet is a frame of its own:
+--  a packet ending short of the frame length gives its length to the global
+--  controller, the DMA then closes the frame there
+--  words past the frame length are discarded
+--  words outside a packet are discarded, the next startofpacket resyncs
+--  a startofpacket inside a packet ends the previous one first
+-- A word is refused only when end_fifo is full, it is then reported on
+-- overflow unless the frame is being dropped.
+-- The tail of a short frame waits for its length, a burst started below a
+-- full one would wait for the next frame: the FIFO threshold must be 0 with
+-- a stage that shortens the frames.
+
+entity depacketize is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Avalon-ST Sink, ready latency 0
+        ST_data          : in  std_logic_vector(31 downto 0);
+        ST_valid         : in  std_logic;
+        ST_ready         : out std_logic;
+        ST_startofpacket : in  std_logic;
+        ST_endofpacket   : in  std_logic;
+
+        -- end_fifo Interface
+        end_data : out std_logic_vector(31 downto 0);
+        end_write : out std_logic;
+        end_full : in std_logic;
+
+        -- Acquisition Interface
+        acq_drop : in std_logic;
+
+        -- Global Controller Interface
+        -- Largest frame in words, a longer packet is cut there
+        glob_frame_length : in std_logic_vector(23 downto 0);
+        -- Words of the last frame ending short, valid once glob_frame_toggle changed
+        glob_frame_words : out std_logic_vector(23 downto 0);
+        glob_frame_toggle : out std_logic;
+
+        -- A word was refused
+        overflow : out std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end depacketize;
+
+architecture arch of depacketize is
+    signal in_packet_reg : std_logic;
+    -- Words taken from the current packet
+    signal words_reg : unsigned(23 downto 0);
+
+    signal frame_words_reg : std_logic_vector(23 downto 0);
+    signal frame_toggle_reg : std_logic;
+
+    signal beat : std_logic;
+    -- The word belongs to a packet and fits in the frame
+    signal keep : std_logic;
+begin
+    process(clk, rst_n)
+        variable words : unsigned(23 downto 0);
+    begin
+        if rst_n = '0' then
+            in_packet_reg <= '0';
+            words_reg <= (others => '0');
+            frame_words_reg <= (others => '0');
+            frame_toggle_reg <= '0';
+        elsif rising_edge(clk) then
+            if beat = '1' then
+                words := words_reg;
+
+                if ST_startofpacket = '1' then
+                    -- The previous packet lost its endofpacket
+                    if in_packet_reg = '1' and words /= 0 and words < unsigned(glob_frame_length) and
+                       acq_drop = '0' then
+                        frame_words_reg <= std_logic_vector(words);
+                        frame_toggle_reg <= not frame_toggle_reg;
+                    end if;
+                    words := (others => '0');
+                    in_packet_reg <= '1';
+                end if;
+
+                if keep = '1' then
+                    words := words + 1;
+                end if;
+
+                if ST_endofpacket = '1' and (ST_startofpacket = '1' or in_packet_reg = '1') then
+                    if words < unsigned(glob_frame_length) and acq_drop = '0' then
+                        frame_words_reg <= std_logic_vector(words);
+                        frame_toggle_reg <= not frame_toggle_reg;
+                    end if;
+                    in_packet_reg <= '0';
+                end if;
+
+                words_reg <= words;
+            end if;
+
+            if sys_soft_rst = '1' then
+                in_packet_reg <= '0';
+                words_reg <= (others => '0');
+            end if;
+        end if;
+    end process;
+
+    beat <= ST_valid and (not end_full);
+    keep <= '1' when (ST_startofpacket = '1' and unsigned(glob_frame_length) /= 0) or
+                     (in_packet_reg = '1' and words_reg < unsigned(glob_frame_length)) else
+            '0';
+
+    ST_ready <= not end_full;
+
+    end_data <= ST_data;
+    end_write <= beat and keep and (not acq_drop);
+
+    glob_frame_words <= frame_words_reg;
+    glob_frame_toggle <= frame_toggle_reg;
+
+    overflow <= ST_valid and end_full and (not acq_drop);
+end arch;
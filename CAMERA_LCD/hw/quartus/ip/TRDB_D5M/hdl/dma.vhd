@@ -3,14 +3,28 @@ use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
 
 
--- If module is desynchro, we can clear when glob_write
+-- When the acquisition drops a frame, the burst on the bus is completed and
+-- what is left of the frame in the FIFO is discarded, the next frame then
+-- starts again at the beginning of the buffer.
+-- Bursts run back to back: the beat after the last one of a burst already
+-- belongs to the next burst when the FIFO holds enough data. The last burst of
+-- a frame is shortened when the frame length is not a multiple of the burst
+-- length.
+-- With a line length set, the frame is written as lines of that many words
+-- placed stride bytes apart, and bursts end at the end of each line.
+-- In stream mode the FIFO is sent on the Avalon-ST source instead, one word
+-- per beat, and the frame is counted the same way. Nothing is written to the
+-- bus then. Each frame is a packet, so a sink can resynchronise on the start
+-- of the next one after a dropped frame.
+-- The length of a compressed frame is only given once the frame has ended. A
+-- frame already written by then ends without a burst.
 entity dma is
     generic(
-        -- Unit of frame_length is in avalon transfer
+        -- Largest frame supported, unit of frame_length is in avalon transfer
         frame_length : integer := (320*240)/2;
-        -- Must divide evenly screen_width and screen_heigth
-        burst_count : integer := 10;
-        burst_bitwidth : integer := 4
+        -- Longest burst supported, in avalon transfers
+        burst_count : integer := 128;
+        burst_bitwidth : integer := 8
     );
     port(
         clk : in std_logic;
@@ -18,11 +32,32 @@ entity dma is
 
         -- end_fifo Interface
         fifo_RGB2_pixel  : in  std_logic_vector(31 downto 0);
-        fifo_almost_full : in  std_logic;
+        fifo_usedw       : in  std_logic_vector(7 downto 0);
+        -- usedw wraps to 0 once the FIFO holds all its words
+        fifo_full        : in  std_logic;
+        fifo_empty       : in  std_logic;
         fifo_read        : out std_logic;
 
         -- Global Controller Interface
         glob_address : in std_logic_vector(31 downto 0);
+        -- Current frame length in avalon transfers
+        glob_frame_length : in std_logic_vector(31 downto 0);
+        -- Pulses when the last burst of a frame has been accepted
+        glob_frame_done : out std_logic;
+        -- Burst length, clamped to burst_count
+        glob_burst_length : in std_logic_vector(7 downto 0);
+        -- FIFO level starting a burst, 0 waits for a whole burst
+        glob_fifo_threshold : in std_logic_vector(7 downto 0);
+        -- Words per line, 0 writes the frame as a single block
+        glob_line_length : in std_logic_vector(23 downto 0);
+        -- Bytes from the start of a line to the start of the next one
+        glob_stride : in std_logic_vector(31 downto 0);
+        -- Data is offered but the slave holds waitrequest
+        glob_stall : out std_logic;
+        -- The frame in the FIFO is being dropped, held until the next one
+        glob_drop : in std_logic;
+        -- Send the frame on the stream source instead of the Avalon master
+        glob_stream : in std_logic;
 
         -- Avalon Interface
         AM_address      : out std_logic_vector(31 downto 0);
@@ -31,60 +66,204 @@ entity dma is
         AM_write        : out std_logic;
         AM_waitRequest  : in  std_logic;
 
+        -- Avalon-ST Source, ready latency 0
+        ST_data          : out std_logic_vector(31 downto 0);
+        ST_valid         : out std_logic;
+        ST_ready         : in  std_logic;
+        ST_startofpacket : out std_logic;
+        ST_endofpacket   : out std_logic;
+
         -- System soft reset
         sys_soft_rst : in std_logic
 );
 end dma;
 
 architecture arch of dma is
-    constant burst_length_byte : natural := burst_count * 32/8;
-    constant frame_length_byte : natural := frame_length * 32/8;
-
-    -- Counts the number of bytes written since beginning of frame transfer
-    signal progress_cnt_reg, progress_cnt_next : natural range 0 to frame_length_byte - 1;
+    -- Counts the number of transfers written since beginning of frame transfer
+    signal progress_cnt_reg, progress_cnt_next : natural range 0 to frame_length - 1;
+    -- Words written in the current line and byte offset of that line
+    signal col_cnt_reg, col_cnt_next : natural range 0 to frame_length - 1;
+    signal line_offset_reg, line_offset_next : unsigned(31 downto 0);
     -- Counst the number of transactions in a burst
-    signal burst_cnt_reg, burst_cnt_next : integer range 0 to burst_count - 1;
+    signal burst_cnt_reg, burst_cnt_next : natural range 0 to burst_count - 1;
+    -- Length of the burst in progress, sampled when its first beat is presented
+    signal burst_len_reg, burst_len_next : natural range 1 to burst_count;
+    -- A write is presented and held by waitrequest, it cannot be withdrawn
+    signal pending_reg : std_logic;
+    -- Discarding the FIFO content instead of writing it
+    signal flush_reg, flush_next : std_logic;
 
+    signal frame_words : natural range 1 to frame_length;
+    signal remaining : natural range 1 to frame_length;
+    signal line_words : natural range 1 to frame_length;
+    signal line_left : natural range 1 to frame_length;
+    signal stride : unsigned(31 downto 0);
+    signal burst_req : natural range 1 to burst_count;
+    -- Length of the next burst and FIFO level needed to start it
+    signal new_len : natural range 1 to burst_count;
+    signal start_level : natural range 1 to burst_count;
+    signal cur_len : natural range 1 to burst_count;
+
+    signal in_burst : std_logic;
+    signal start_ok : std_logic;
     signal write : std_logic;
+    -- A beat is transferred on the bus
+    signal beat : std_logic;
+    signal discard : std_logic;
+    signal burst_last : std_logic;
+    -- The current burst completes the frame
+    signal frame_last : std_logic;
+    -- A word is accepted by the stream sink
+    signal st_valid_i : std_logic;
+    signal st_beat : std_logic;
+    signal st_frame_last : std_logic;
+    -- The frame length dropped to the words already written
+    signal frame_late : std_logic;
 begin
     process(clk,nReset)
     begin
         if nReset = '0' then
             progress_cnt_reg <= 0;
+            col_cnt_reg <= 0;
+            line_offset_reg <= (others => '0');
             burst_cnt_reg <= 0;
+            burst_len_reg <= 1;
+            pending_reg <= '0';
+            flush_reg <= '0';
 
         elsif rising_edge(clk) then
+            progress_cnt_reg <= progress_cnt_next;
+            col_cnt_reg <= col_cnt_next;
+            line_offset_reg <= line_offset_next;
+            burst_cnt_reg <= burst_cnt_next;
+            burst_len_reg <= burst_len_next;
+            pending_reg <= write and AM_waitRequest;
+            flush_reg <= flush_next;
+
             if sys_soft_rst = '1' then
                 progress_cnt_reg <= 0;
+                col_cnt_reg <= 0;
+                line_offset_reg <= (others => '0');
                 burst_cnt_reg <= 0;
+                flush_reg <= '0';
             end if;
-
-            progress_cnt_reg <= progress_cnt_next;
-            burst_cnt_reg <= burst_cnt_next;
-
         end if;
     end process;
 
-    -- Either we want to start a transfer, or we are in a transfer
-    write <= '1' when (fifo_almost_full = '1') or  -- we can send a burst
-                      (burst_cnt_reg /= 0) else    -- we are in a burst
-             '0';
+    frame_words <= frame_length when (unsigned(glob_frame_length) = 0) or
+                                     (unsigned(glob_frame_length) > frame_length) else
+                   to_integer(unsigned(glob_frame_length(23 downto 0)));
+
+    remaining <= frame_words - progress_cnt_reg when progress_cnt_reg < frame_words else
+                 1;
+
+    burst_req <= burst_count when (unsigned(glob_burst_length) = 0) or
+                                  (unsigned(glob_burst_length) > burst_count) else
+                 to_integer(unsigned(glob_burst_length));
+
+    line_words <= frame_words when (unsigned(glob_line_length) = 0) or
+                                   (unsigned(glob_line_length) > frame_words) else
+                  to_integer(unsigned(glob_line_length));
+
+    line_left <= line_words - col_cnt_reg when col_cnt_reg < line_words else
+                 1;
+
+    -- A null stride packs the lines
+    stride <= unsigned(glob_stride) when unsigned(glob_stride) /= 0 else
+              to_unsigned(line_words * 4, 32);
+
+    new_len <= remaining when (remaining < burst_req) and (remaining < line_left) else
+               line_left when line_left < burst_req else
+               burst_req;
 
-    burst_cnt_next <= 0 when (write = '1' and AM_waitRequest = '0') and (burst_cnt_reg + 1 = burst_count) else
-                      (burst_cnt_reg + 1) when (write = '1' and AM_waitRequest = '0') else
+    -- A lower threshold starts earlier, the burst then follows the FIFO
+    start_level <= to_integer(unsigned(glob_fifo_threshold)) when (unsigned(glob_fifo_threshold) /= 0) and
+                                                                   (unsigned(glob_fifo_threshold) < new_len) else
+                   new_len;
+
+    in_burst <= '1' when burst_cnt_reg /= 0 else
+                '0';
+    start_ok <= '1' when (unsigned(fifo_usedw) >= start_level) or (fifo_full = '1') else
+                '0';
+
+    -- The burstcount of a first beat held by waitrequest cannot change, even
+    -- when the frame length drops meanwhile
+    cur_len <= burst_len_reg when (in_burst = '1') or (pending_reg = '1') else
+               new_len;
+
+    -- Either we are in a transfer, or we can start one. Data is only offered
+    -- while the FIFO has some.
+    write <= (in_burst or pending_reg or (start_ok and not flush_reg and not glob_stream and not frame_late)) and (not fifo_empty);
+
+    st_valid_i <= glob_stream and (not flush_reg) and (not frame_late) and (not fifo_empty);
+    st_beat <= st_valid_i and ST_ready;
+    st_frame_last <= '1' when (st_beat = '1') and (progress_cnt_reg + 1 >= frame_words) else
+                     '0';
+
+    -- Leave the flush once the dropped frame is gone from the FIFO, the next
+    -- frame only writes after its first pair of lines
+    flush_next <= '1' when glob_drop = '1' else
+                  '0' when (fifo_empty = '1') and (in_burst = '0') else
+                  flush_reg;
+    discard <= flush_reg and (not write) and (not in_burst) and (not fifo_empty);
+
+    beat <= write and (not AM_waitRequest);
+    burst_last <= '1' when (beat = '1') and (burst_cnt_reg = cur_len - 1) else
+                  '0';
+
+    burst_cnt_next <= 0 when burst_last = '1' else
+                      (burst_cnt_reg + 1) when beat = '1' else
                       burst_cnt_reg;
 
-    progress_cnt_next <= 0 when (burst_cnt_reg = burst_count - 1) and (progress_cnt_reg + burst_length_byte = frame_length_byte) else
-                         (progress_cnt_reg + burst_length_byte) when (burst_cnt_reg = burst_count - 1)
+    burst_len_next <= new_len when (in_burst = '0') and (pending_reg = '0') and (write = '1') else
+                      burst_len_reg;
+
+    frame_last <= '1' when progress_cnt_reg + cur_len >= frame_words else
+                  '0';
+
+    frame_late <= '1' when (progress_cnt_reg /= 0) and (progress_cnt_reg >= frame_words) and
+                           (in_burst = '0') and (pending_reg = '0') and (flush_reg = '0') else
+                  '0';
+
+    progress_cnt_next <= 0 when (flush_reg = '1') and (in_burst = '0') else
+                         0 when (burst_last = '1') and (frame_last = '1') else
+                         (progress_cnt_reg + cur_len) when burst_last = '1' else
+                         0 when st_frame_last = '1' else
+                         0 when frame_late = '1' else
+                         (progress_cnt_reg + 1) when st_beat = '1'
                          else progress_cnt_reg;
 
-    fifo_read <= write and (not AM_waitRequest);
+    col_cnt_next <= 0 when (flush_reg = '1') and (in_burst = '0') else
+                    0 when (burst_last = '1') and (frame_last = '1') else
+                    0 when (burst_last = '1') and (col_cnt_reg + cur_len >= line_words) else
+                    (col_cnt_reg + cur_len) when burst_last = '1' else
+                    0 when (st_frame_last = '1') or (frame_late = '1') else
+                    col_cnt_reg;
+
+    line_offset_next <= (others => '0') when (flush_reg = '1') and (in_burst = '0') else
+                        (others => '0') when (burst_last = '1') and (frame_last = '1') else
+                        (line_offset_reg + stride) when (burst_last = '1') and (col_cnt_reg + cur_len >= line_words) else
+                        (others => '0') when (st_frame_last = '1') or (frame_late = '1') else
+                        line_offset_reg;
+
+    glob_frame_done <= (burst_last and frame_last and (not flush_reg)) or st_frame_last or frame_late;
+
+    glob_stall <= write and AM_waitRequest;
+
+    fifo_read <= beat or st_beat or discard;
 
     AM_write <= write;
 
-    AM_address <= std_logic_vector(unsigned(glob_address) + progress_cnt_reg);
+    AM_address <= std_logic_vector(unsigned(glob_address) + line_offset_reg + to_unsigned(col_cnt_reg * 4, 32));
 
-    AM_burstCount <= std_logic_vector(to_unsigned(burst_count,AM_burstCount'length));
+    AM_burstCount <= std_logic_vector(to_unsigned(cur_len, AM_burstCount'length));
 
     AM_dataWrite <= fifo_RGB2_pixel;
+
+    ST_data <= fifo_RGB2_pixel;
+    ST_valid <= st_valid_i;
+    ST_startofpacket <= '1' when progress_cnt_reg = 0 else
+                        '0';
+    ST_endofpacket <= '1' when progress_cnt_reg + 1 >= frame_words else
+                      '0';
 end arch;
@@ -50,7 +50,9 @@ ENTITY end_fifo IS
 		wrreq		: IN STD_LOGIC ;
 		q		: OUT STD_LOGIC_VECTOR (31 DOWNTO 0);
 		rdempty		: OUT STD_LOGIC ;
-		rdusedw		: OUT STD_LOGIC_VECTOR (7 DOWNTO 0)
+		rdfull		: OUT STD_LOGIC ;
+		rdusedw		: OUT STD_LOGIC_VECTOR (7 DOWNTO 0);
+		wrfull		: OUT STD_LOGIC 
 	);
 END end_fifo;
 
@@ -59,7 +61,9 @@ ARCHITECTURE SYN OF end_fifo IS
 
 	SIGNAL sub_wire0	: STD_LOGIC_VECTOR (31 DOWNTO 0);
 	SIGNAL sub_wire1	: STD_LOGIC ;
-	SIGNAL sub_wire2	: STD_LOGIC_VECTOR (7 DOWNTO 0);
+	SIGNAL sub_wire2	: STD_LOGIC ;
+	SIGNAL sub_wire3	: STD_LOGIC_VECTOR (7 DOWNTO 0);
+	SIGNAL sub_wire4	: STD_LOGIC ;
 
 
 
@@ -88,14 +92,18 @@ ARCHITECTURE SYN OF end_fifo IS
 			wrreq	: IN STD_LOGIC ;
 			q	: OUT STD_LOGIC_VECTOR (31 DOWNTO 0);
 			rdempty	: OUT STD_LOGIC ;
-			rdusedw	: OUT STD_LOGIC_VECTOR (7 DOWNTO 0)
+			rdfull	: OUT STD_LOGIC ;
+			rdusedw	: OUT STD_LOGIC_VECTOR (7 DOWNTO 0);
+			wrfull	: OUT STD_LOGIC 
 	);
 	END COMPONENT;
 
 BEGIN
 	q    <= sub_wire0(31 DOWNTO 0);
 	rdempty    <= sub_wire1;
-	rdusedw    <= sub_wire2(7 DOWNTO 0);
+	rdfull    <= sub_wire2;
+	rdusedw    <= sub_wire3(7 DOWNTO 0);
+	wrfull    <= sub_wire4;
 
 	dcfifo_component : dcfifo
 	GENERIC MAP (
@@ -122,7 +130,9 @@ BEGIN
 		wrreq => wrreq,
 		q => sub_wire0,
 		rdempty => sub_wire1,
-		rdusedw => sub_wire2
+		rdfull => sub_wire2,
+		rdusedw => sub_wire3,
+		wrfull => sub_wire4
 	);
 
 
@@ -157,12 +167,12 @@ END SYN;
 -- Retrieval info: PRIVATE: msb_usedw NUMERIC "0"
 -- Retrieval info: PRIVATE: output_width NUMERIC "32"
 -- Retrieval info: PRIVATE: rsEmpty NUMERIC "1"
--- Retrieval info: PRIVATE: rsFull NUMERIC "0"
+-- Retrieval info: PRIVATE: rsFull NUMERIC "1"
 -- Retrieval info: PRIVATE: rsUsedW NUMERIC "1"
 -- Retrieval info: PRIVATE: sc_aclr NUMERIC "0"
 -- Retrieval info: PRIVATE: sc_sclr NUMERIC "0"
 -- Retrieval info: PRIVATE: wsEmpty NUMERIC "0"
--- Retrieval info: PRIVATE: wsFull NUMERIC "0"
+-- Retrieval info: PRIVATE: wsFull NUMERIC "1"
 -- Retrieval info: PRIVATE: wsUsedW NUMERIC "0"
 -- Retrieval info: LIBRARY: altera_mf altera_mf.altera_mf_components.all
 -- Retrieval info: CONSTANT: INTENDED_DEVICE_FAMILY STRING "Cyclone V"
@@ -183,9 +193,11 @@ END SYN;
 -- Retrieval info: USED_PORT: q 0 0 32 0 OUTPUT NODEFVAL "q[31..0]"
 -- Retrieval info: USED_PORT: rdclk 0 0 0 0 INPUT NODEFVAL "rdclk"
 -- Retrieval info: USED_PORT: rdempty 0 0 0 0 OUTPUT NODEFVAL "rdempty"
+-- Retrieval info: USED_PORT: rdfull 0 0 0 0 OUTPUT NODEFVAL "rdfull"
 -- Retrieval info: USED_PORT: rdreq 0 0 0 0 INPUT NODEFVAL "rdreq"
 -- Retrieval info: USED_PORT: rdusedw 0 0 8 0 OUTPUT NODEFVAL "rdusedw[7..0]"
 -- Retrieval info: USED_PORT: wrclk 0 0 0 0 INPUT NODEFVAL "wrclk"
+-- Retrieval info: USED_PORT: wrfull 0 0 0 0 OUTPUT NODEFVAL "wrfull"
 -- Retrieval info: USED_PORT: wrreq 0 0 0 0 INPUT NODEFVAL "wrreq"
 -- Retrieval info: CONNECT: @aclr 0 0 0 0 aclr 0 0 0 0
 -- Retrieval info: CONNECT: @data 0 0 32 0 data 0 0 32 0
@@ -195,7 +207,9 @@ END SYN;
 -- Retrieval info: CONNECT: @wrreq 0 0 0 0 wrreq 0 0 0 0
 -- Retrieval info: CONNECT: q 0 0 32 0 @q 0 0 32 0
 -- Retrieval info: CONNECT: rdempty 0 0 0 0 @rdempty 0 0 0 0
+-- Retrieval info: CONNECT: rdfull 0 0 0 0 @rdfull 0 0 0 0
 -- Retrieval info: CONNECT: rdusedw 0 0 8 0 @rdusedw 0 0 8 0
+-- Retrieval info: CONNECT: wrfull 0 0 0 0 @wrfull 0 0 0 0
 -- Retrieval info: GEN_FILE: TYPE_NORMAL end_fifo.vhd TRUE
 -- Retrieval info: GEN_FILE: TYPE_NORMAL end_fifo.inc FALSE
 -- Retrieval info: GEN_FILE: TYPE_NORMAL end_fifo.cmp TRUE
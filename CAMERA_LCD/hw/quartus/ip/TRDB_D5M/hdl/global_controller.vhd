@@ -1,47 +1,399 @@
 library ieee;
 use ieee.std_logic_1164.all;
 use ieee.numeric_std.all;
+use work.camera_pkg.all;
 
 -- Latency of the module: 0 cycle
 
-entity global_controller is port(
+entity global_controller is
+    generic(
+        -- Capture window selected at reset, in sensor pixels
+        screen_width : natural := 640;
+        screen_height : natural := 480
+    );
+    port(
     clk : in std_logic;
     nReset : in std_logic;
 
     -- Avalon Interface
-    AS_address : in std_logic_vector(3 downto 0);
+    AS_address : in std_logic_vector(7 downto 0);
     AS_write : in std_logic;
     AS_read : in std_logic;
 
     AS_writedata : in std_logic_vector(31 downto 0);
     AS_readdata : out std_logic_vector(31 downto 0);
 
+    -- Interrupt Sender
+    irq : out std_logic;
+
     -- Acquisition Interface
     acq_start : out std_logic;
     acq_start_done : in std_logic;
+    acq_continuous : out std_logic;
+    acq_video : out std_logic;
+    acq_width : out std_logic_vector(11 downto 0);
+    acq_height : out std_logic_vector(11 downto 0);
+    acq_roi_x : out std_logic_vector(11 downto 0);
+    acq_roi_y : out std_logic_vector(11 downto 0);
+
+    -- Decimation Interface
+    dec_scale : out std_logic_vector(1 downto 0);
+    -- Output pixel format and YUV422 conversion matrix, see pack
+    pack_format : out std_logic_vector(2 downto 0);
+    pack_yuv : out std_logic_vector(1 downto 0);
+    -- Compression of the RGB565 words, see rice
+    rice_enable : out std_logic;
+    rice_k : out std_logic_vector(1 downto 0);
+    -- Largest frame in words, see depacketize
+    snk_frame_length : out std_logic_vector(23 downto 0);
+    -- 3x3 convolution of the decimated frame, see conv
+    conv_mode : out std_logic_vector(1 downto 0);
+    conv_shift : out std_logic_vector(3 downto 0);
+    conv_k0 : out std_logic_vector(71 downto 0);
+    conv_k1 : out std_logic_vector(71 downto 0);
+    conv_line_words : out std_logic_vector(10 downto 0);
+    conv_lines : out std_logic_vector(11 downto 0);
 
     -- DMA Interface
     dma_address : out std_logic_vector(31 downto 0);
+    dma_frame_length : out std_logic_vector(31 downto 0);
+    dma_burst_length : out std_logic_vector(7 downto 0);
+    dma_fifo_threshold : out std_logic_vector(7 downto 0);
+    dma_line_length : out std_logic_vector(23 downto 0);
+    dma_stride : out std_logic_vector(31 downto 0);
+    dma_frame_done : in std_logic;
+    dma_stall : in std_logic;
+    dma_drop : out std_logic;
+    -- Frames go to the LCD stream instead of memory
+    dma_stream : out std_logic;
+
+    -- Display Interface, pulses with the buffer of each completed frame. The
+    -- display reads that buffer while busy and hands it back when it drops.
+    disp_go : out std_logic;
+    disp_address : out std_logic_vector(31 downto 0);
+    disp_busy : in std_logic;
 
     -- System Interface
     system_busy : in std_logic;
-    end_fifo_busy : in std_logic
+    end_fifo_busy : in std_logic;
+    -- Words held in end_fifo, read side
+    end_fifo_level : in std_logic_vector(8 downto 0);
+
+    -- Camera clock domain, only feeds the performance counters
+    pix_clk : in std_logic;
+    pix_frame_valid : in std_logic;
+    pix_fifo_write : in std_logic;
+    pix_fifo_full : in std_logic;
+    -- The acquisition is discarding a frame after an end_fifo overflow
+    pix_drop : in std_logic;
+    -- Words of the last frame ending short, valid once the toggle changed
+    pix_frame_words : in std_logic_vector(23 downto 0);
+    pix_frame_toggle : in std_logic
 );
 end global_controller;
 
 architecture arch of global_controller is
+    -- Register map (byte addresses)
+    constant REG_CTRL           : std_logic_vector(7 downto 0) := x"00";
+    constant REG_ADDRESS        : std_logic_vector(7 downto 0) := x"04";
+    constant REG_FIFO           : std_logic_vector(7 downto 0) := x"08";
+    constant REG_RING_SIZE      : std_logic_vector(7 downto 0) := x"0C";
+    constant REG_RING_WRITE_IDX : std_logic_vector(7 downto 0) := x"10";
+    constant REG_RING_LAST_IDX  : std_logic_vector(7 downto 0) := x"14";
+    constant REG_MODE           : std_logic_vector(7 downto 0) := x"18";
+    constant REG_FRAME_SEQ      : std_logic_vector(7 downto 0) := x"1C";
+    -- Ring buffer addresses occupy RING_MAX consecutive words from here
+    constant REG_RING_ADDR      : std_logic_vector(7 downto 0) := x"20";
+    constant REG_IRQ_ENABLE     : std_logic_vector(7 downto 0) := x"40";
+    constant REG_IRQ_STATUS     : std_logic_vector(7 downto 0) := x"44";
+    constant REG_WIDTH          : std_logic_vector(7 downto 0) := x"48";
+    constant REG_HEIGHT         : std_logic_vector(7 downto 0) := x"4C";
+    constant REG_ROI_X          : std_logic_vector(7 downto 0) := x"50";
+    constant REG_ROI_Y          : std_logic_vector(7 downto 0) := x"54";
+    constant REG_FRAME_LENGTH   : std_logic_vector(7 downto 0) := x"58";
+    constant REG_BURST_LENGTH   : std_logic_vector(7 downto 0) := x"5C";
+    constant REG_FIFO_THRESHOLD : std_logic_vector(7 downto 0) := x"60";
+    -- Performance counters, read from the last snapshot
+    constant REG_PERF_CTRL      : std_logic_vector(7 downto 0) := x"64";
+    constant REG_PERF_STARTED   : std_logic_vector(7 downto 0) := x"68";
+    constant REG_PERF_DONE      : std_logic_vector(7 downto 0) := x"6C";
+    constant REG_PERF_OVERFLOW  : std_logic_vector(7 downto 0) := x"70";
+    constant REG_PERF_FIFO_PEAK : std_logic_vector(7 downto 0) := x"74";
+    constant REG_PERF_STALL     : std_logic_vector(7 downto 0) := x"78";
+    constant REG_PERF_CYCLES    : std_logic_vector(7 downto 0) := x"7C";
+    constant REG_DROPPED        : std_logic_vector(7 downto 0) := x"80";
+    constant REG_SCALE          : std_logic_vector(7 downto 0) := x"84";
+    constant REG_FORMAT         : std_logic_vector(7 downto 0) := x"88";
+    constant REG_LINE_LENGTH    : std_logic_vector(7 downto 0) := x"8C";
+    constant REG_STRIDE         : std_logic_vector(7 downto 0) := x"90";
+    constant REG_FRAME_COUNT    : std_logic_vector(7 downto 0) := x"94";
+    constant REG_FRAME_SPAN     : std_logic_vector(7 downto 0) := x"98";
+    constant REG_RICE_K         : std_logic_vector(7 downto 0) := x"9C";
+    constant REG_RICE_LENGTH    : std_logic_vector(7 downto 0) := x"A0";
+    constant REG_YUV            : std_logic_vector(7 downto 0) := x"A4";
+    constant REG_CONV           : std_logic_vector(7 downto 0) := x"A8";
+    -- Kernel rows from the top one, 3 signed coefficients from the low byte
+    constant REG_CONV_K0_TOP    : std_logic_vector(7 downto 0) := x"AC";
+    constant REG_CONV_K0_MID    : std_logic_vector(7 downto 0) := x"B0";
+    constant REG_CONV_K0_BOT    : std_logic_vector(7 downto 0) := x"B4";
+    constant REG_CONV_K1_TOP    : std_logic_vector(7 downto 0) := x"B8";
+    constant REG_CONV_K1_MID    : std_logic_vector(7 downto 0) := x"BC";
+    constant REG_CONV_K1_BOT    : std_logic_vector(7 downto 0) := x"C0";
+
+    -- Values of REG_FORMAT
+    constant FORMAT_RGB565 : natural := 0;
+    constant FORMAT_GRAY8  : natural := 1;
+    constant FORMAT_RAW12  : natural := 2;
+    constant FORMAT_RICE   : natural := 3;
+    constant FORMAT_YUV422 : natural := 4;
+
+    -- Sobel kernels, horizontal then vertical gradient
+    constant SOBEL_X : std_logic_vector(71 downto 0) := x"0100FF" & x"0200FE" & x"0100FF";
+    constant SOBEL_Y : std_logic_vector(71 downto 0) := x"010201" & x"000000" & x"FFFEFF";
+
+    -- Bits of REG_PERF_CTRL, a snapshot is taken before the clear
+    constant PERF_SNAPSHOT : natural := 0;
+    constant PERF_CLEAR    : natural := 1;
+
+    -- Interrupt sources, bit positions in REG_IRQ_ENABLE / REG_IRQ_STATUS
+    constant IRQ_FRAME_DONE : natural := 0;
+    constant IRQ_FRAME_DROPPED : natural := 1;
+
+    constant RING_MAX : natural := 8;
+
+    type ring_t is array (0 to RING_MAX - 1) of std_logic_vector(31 downto 0);
+
     signal acq_start_reg : std_logic;
+    signal dma_address_reg : std_logic_vector(31 downto 0);
+
+    -- Number of buffers in the ring, 0 means single shot to REG_ADDRESS
+    signal ring_size_reg : natural range 0 to RING_MAX;
+    signal ring_addr_reg : ring_t;
+    -- Buffer the DMA is currently filling
+    signal ring_write_idx_reg : natural range 0 to RING_MAX - 1;
+    -- Last buffer fully written by the DMA, valid once a frame has completed
+    signal ring_last_idx_reg : natural range 0 to RING_MAX - 1;
+    signal ring_last_valid_reg : std_logic;
+    -- Set while the ring is streaming, cleared by a stop command
+    signal stream_reg : std_logic;
+    -- Sensor runs free instead of being triggered for every frame
+    signal video_reg : std_logic;
+    -- Frames are streamed to the LCD controller until stopped, the DMA
+    -- addresses are unused
+    signal preview_reg : std_logic;
+    -- Completed frames are handed to the LCD controller
+    signal handoff_reg : std_logic;
+    signal disp_go_reg : std_logic;
+    signal disp_address_reg : std_logic_vector(31 downto 0);
+    -- The ring buffer handed to the display is not written until it is read
+    signal disp_hold_reg : std_logic;
+    signal disp_slot_reg : natural range 0 to RING_MAX - 1;
+    -- Frames completed since the last start command
+    signal frame_seq_reg : unsigned(31 downto 0);
+    -- Frames dropped on end_fifo overflow since the last start command
+    signal dropped_reg : unsigned(31 downto 0);
+    signal drop_sync : std_logic_vector(2 downto 0);
+    -- Pending interrupts are cleared by writing 1 to their bit in REG_IRQ_STATUS
+    signal irq_enable_reg : std_logic_vector(31 downto 0);
+    signal irq_status_reg : std_logic_vector(31 downto 0);
+    -- Capture window in sensor pixels, only the low 12 bits are used
+    signal width_reg, height_reg : unsigned(11 downto 0);
+    signal roi_x_reg, roi_y_reg : unsigned(11 downto 0);
+    -- Output size divided by 2^scale in each direction, 2 at most
+    signal scale_reg : unsigned(1 downto 0);
+    signal format_reg : natural range 0 to FORMAT_YUV422;
+    -- Bit 0 selects the studio range, bit 1 the BT.709 matrix
+    signal yuv_reg : std_logic_vector(1 downto 0);
+    -- Convolution mode in bits 1:0, right shift of the result in bits 11:8
+    signal conv_mode_reg : std_logic_vector(1 downto 0);
+    signal conv_shift_reg : std_logic_vector(3 downto 0);
+    signal conv_k0_reg, conv_k1_reg : std_logic_vector(71 downto 0);
+    -- Frame length in avalon transfers. RGB565, YUV422 and GRAY8 have one
+    -- pixel per 2x2 Bayer block, two, two and four per word; RAW12 two
+    -- samples per word. A compressed frame is given its largest length, 28
+    -- bits per pixel or 7/4 of the RGB565 length, which every buffer holds.
+    signal frame_pixels : unsigned(23 downto 0);
+    signal rgb565_length : unsigned(23 downto 0);
+    signal frame_length : unsigned(23 downto 0);
+    signal dma_frame_words : unsigned(23 downto 0);
+    -- DMA burst length and FIFO level starting a burst, 0 selects the longest
+    -- burst and a full burst of data respectively
+    signal burst_length_reg : std_logic_vector(7 downto 0);
+    signal fifo_threshold_reg : std_logic_vector(7 downto 0);
+    -- Words per line written by the DMA and bytes between line starts, a null
+    -- line length writes the frame as one block, a null stride packs the lines
+    signal line_length_reg : std_logic_vector(23 downto 0);
+    signal stride_reg : std_logic_vector(31 downto 0);
+    -- Frames captured by a start command, 0 keeps one frame in single shot
+    -- and runs the ring and the preview until stopped
+    signal frame_count_reg : unsigned(31 downto 0);
+    -- Frames of the run not started yet, a dropped frame is retaken
+    signal frames_left_reg : unsigned(31 downto 0);
+    -- A run of frame_count frames is in progress, cleared by a stop command
+    signal run_reg : std_logic;
+    -- The last frame of the run was dropped, it is taken again once the
+    -- acquisition is idle
+    signal retake_reg : std_logic;
+    -- Without a ring each frame is written frame_span bytes after the
+    -- previous one, 0 places the frames back to back
+    signal frame_span_reg : std_logic_vector(31 downto 0);
+    signal frame_span : unsigned(31 downto 0);
+    signal frame_offset_reg : unsigned(31 downto 0);
+    signal frame_address : std_logic_vector(31 downto 0);
+    -- Rice parameter of the compressed format
+    signal rice_k_reg : std_logic_vector(1 downto 0);
+    -- Length in words of a frame ending short of frame_length, compressed
+    -- or shortened by a stage on the stream, known once the frame has ended.
+    -- Then the length of the last frame committed by the DMA.
+    signal short_sync : std_logic_vector(2 downto 0);
+    signal short_words_reg : unsigned(23 downto 0);
+    signal short_known_reg : std_logic;
+    signal rice_length_reg : unsigned(23 downto 0);
+
+    -- Camera clock side of the performance counters. The overflow count
+    -- crosses in Gray code, the frame period is sampled once the toggle
+    -- marking a new frame has been synchronised.
+    signal pix_frame_valid_prev : std_logic;
+    signal pix_frame_toggle : std_logic;
+    signal pix_cycle_cnt : unsigned(31 downto 0);
+    signal pix_frame_cycles : unsigned(31 downto 0);
+    signal pix_overflow_cnt : unsigned(31 downto 0);
+    signal pix_overflow_gray : std_logic_vector(31 downto 0);
+
+    signal perf_toggle_sync : std_logic_vector(2 downto 0);
+    signal perf_overflow_sync0, perf_overflow_sync1 : std_logic_vector(31 downto 0);
+    signal perf_overflow_cnt : unsigned(31 downto 0);
+    -- The overflow counter cannot be cleared from here, it is rebased instead
+    signal perf_overflow_base : unsigned(31 downto 0);
+
+    -- Live counters
+    signal perf_started_reg : unsigned(31 downto 0);
+    signal perf_done_reg : unsigned(31 downto 0);
+    signal perf_peak_reg : unsigned(8 downto 0);
+    signal perf_stall_reg : unsigned(31 downto 0);
+    signal perf_cycles_reg : unsigned(31 downto 0);
+
+    -- Values returned to the Avalon slave
+    signal perf_started_snap : unsigned(31 downto 0);
+    signal perf_done_snap : unsigned(31 downto 0);
+    signal perf_overflow_snap : unsigned(31 downto 0);
+    signal perf_peak_snap : unsigned(8 downto 0);
+    signal perf_stall_snap : unsigned(31 downto 0);
+    signal perf_cycles_snap : unsigned(31 downto 0);
+
+    function gray_to_bin(g : std_logic_vector) return unsigned is
+        variable b : unsigned(g'range);
+    begin
+        b(g'high) := g(g'high);
+        for i in g'high - 1 downto g'low loop
+            b(i) := b(i + 1) xor g(i);
+        end loop;
+        return b;
+    end function;
+begin
+
+-- Performance counters sampled in the camera clock domain
+process(pix_clk, nReset)
 begin
+    if nReset = '0' then
+        pix_frame_valid_prev <= '0';
+        pix_frame_toggle <= '0';
+        pix_cycle_cnt <= (others => '0');
+        pix_frame_cycles <= (others => '0');
+        pix_overflow_cnt <= (others => '0');
+        pix_overflow_gray <= (others => '0');
+    elsif rising_edge(pix_clk) then
+        pix_frame_valid_prev <= pix_frame_valid;
+
+        -- Sensor frame period, from one frame_valid rise to the next
+        if pix_frame_valid = '1' and pix_frame_valid_prev = '0' then
+            pix_frame_cycles <= pix_cycle_cnt;
+            pix_cycle_cnt <= to_unsigned(1, 32);
+            pix_frame_toggle <= not pix_frame_toggle;
+        else
+            pix_cycle_cnt <= pix_cycle_cnt + 1;
+        end if;
+
+        if pix_fifo_write = '1' and pix_fifo_full = '1' then
+            pix_overflow_cnt <= pix_overflow_cnt + 1;
+        end if;
+        pix_overflow_gray <= std_logic_vector(pix_overflow_cnt xor shift_right(pix_overflow_cnt, 1));
+    end if;
+end process;
+
+perf_overflow_cnt <= gray_to_bin(perf_overflow_sync1);
 
 --Avalon slave write to registers.
 process(clk,nReset, acq_start_reg)
-    variable dma_address_internal : std_logic_vector(dma_address'range);
+    variable ring_slot : natural range 0 to RING_MAX - 1;
+    variable frames_left : unsigned(31 downto 0);
+    variable ring_next : natural range 0 to RING_MAX - 1;
 begin
     if nReset = '0' then
-        dma_address_internal := (others => '0');
+        dma_address_reg <= (others => '0');
         acq_start_reg <= '0';
         AS_readdata <= (others => '0');
 
+        ring_size_reg <= 0;
+        ring_addr_reg <= (others => (others => '0'));
+        ring_write_idx_reg <= 0;
+        ring_last_idx_reg <= 0;
+        ring_last_valid_reg <= '0';
+        stream_reg <= '0';
+        video_reg <= '0';
+        preview_reg <= '0';
+        handoff_reg <= '0';
+        disp_go_reg <= '0';
+        disp_address_reg <= (others => '0');
+        disp_hold_reg <= '0';
+        disp_slot_reg <= 0;
+        frame_seq_reg <= (others => '0');
+        dropped_reg <= (others => '0');
+        drop_sync <= (others => '0');
+        irq_enable_reg <= (others => '0');
+        irq_status_reg <= (others => '0');
+        width_reg <= to_unsigned(screen_width, 12);
+        height_reg <= to_unsigned(screen_height, 12);
+        roi_x_reg <= (others => '0');
+        roi_y_reg <= (others => '0');
+        scale_reg <= (others => '0');
+        format_reg <= FORMAT_RGB565;
+        yuv_reg <= (others => '0');
+        conv_mode_reg <= (others => '0');
+        conv_shift_reg <= (others => '0');
+        conv_k0_reg <= SOBEL_X;
+        conv_k1_reg <= SOBEL_Y;
+        burst_length_reg <= (others => '0');
+        fifo_threshold_reg <= (others => '0');
+        line_length_reg <= (others => '0');
+        stride_reg <= (others => '0');
+        frame_count_reg <= (others => '0');
+        frames_left_reg <= (others => '0');
+        run_reg <= '0';
+        retake_reg <= '0';
+        frame_span_reg <= (others => '0');
+        frame_offset_reg <= (others => '0');
+        rice_k_reg <= "01";
+        short_sync <= (others => '0');
+        short_words_reg <= (others => '0');
+        short_known_reg <= '0';
+        rice_length_reg <= (others => '0');
+
+        perf_toggle_sync <= (others => '0');
+        perf_overflow_sync0 <= (others => '0');
+        perf_overflow_sync1 <= (others => '0');
+        perf_overflow_base <= (others => '0');
+        perf_started_reg <= (others => '0');
+        perf_done_reg <= (others => '0');
+        perf_peak_reg <= (others => '0');
+        perf_stall_reg <= (others => '0');
+        perf_cycles_reg <= (others => '0');
+        perf_started_snap <= (others => '0');
+        perf_done_snap <= (others => '0');
+        perf_overflow_snap <= (others => '0');
+        perf_peak_snap <= (others => '0');
+        perf_stall_snap <= (others => '0');
+        perf_cycles_snap <= (others => '0');
 
     elsif rising_edge(clk) then
 
@@ -51,33 +403,417 @@ begin
             acq_start_reg <= '0';
         end if;
 
-        if AS_write = '1' and system_busy = '0' then
+        if dma_frame_done = '1' then
+            frame_seq_reg <= frame_seq_reg + 1;
+        end if;
+
+        -- A source raising in the same cycle as its acknowledge stays pending
+        if AS_write = '1' and AS_address = REG_IRQ_STATUS then
+            irq_status_reg <= irq_status_reg and not AS_writedata;
+        end if;
+        if dma_frame_done = '1' then
+            irq_status_reg(IRQ_FRAME_DONE) <= '1';
+        end if;
+
+        -- The drop is held until the next frame, count its rising edge
+        drop_sync <= drop_sync(1 downto 0) & pix_drop;
+        if drop_sync(1) = '1' and drop_sync(2) = '0' then
+            dropped_reg <= dropped_reg + 1;
+            irq_status_reg(IRQ_FRAME_DROPPED) <= '1';
+        end if;
+
+        -- The run stops streaming as its last frame starts, so the acquisition
+        -- ends with that frame. A drop before then adds a frame to the run, a
+        -- drop of the last frame starts the acquisition again for one frame.
+        frames_left := frames_left_reg;
+        if drop_sync(1) = '1' and drop_sync(2) = '0' and stream_reg = '1' and frames_left /= 0 then
+            frames_left := frames_left + 1;
+        end if;
+        if drop_sync(1) = '1' and drop_sync(2) = '0' and run_reg = '1' and frames_left = 0 then
+            retake_reg <= '1';
+        end if;
+        if retake_reg = '1' and acq_start_done = '0' and acq_start_reg = '0' then
+            acq_start_reg <= '1';
+            retake_reg <= '0';
+        end if;
+        if perf_toggle_sync(2) /= perf_toggle_sync(1) and acq_start_done = '1' and frames_left /= 0 then
+            frames_left := frames_left - 1;
+            if frames_left = 0 then
+                stream_reg <= '0';
+            end if;
+        end if;
+        frames_left_reg <= frames_left;
+
+        -- The buffer just completed is displayed while the DMA moves on. A
+        -- frame completed while the display is busy is not handed over, and
+        -- the display owns its buffer from the pulse until busy drops; busy
+        -- follows the pulse by one cycle.
+        if dma_frame_done = '1' and handoff_reg = '1' and preview_reg = '0' and
+           disp_busy = '0' and disp_hold_reg = '0' then
+            disp_go_reg <= '1';
+            disp_hold_reg <= '1';
+            disp_slot_reg <= ring_write_idx_reg;
+            if ring_size_reg = 0 then
+                disp_address_reg <= frame_address;
+            else
+                disp_address_reg <= ring_addr_reg(ring_write_idx_reg);
+            end if;
+        else
+            disp_go_reg <= '0';
+            if disp_busy = '0' and disp_go_reg = '0' then
+                disp_hold_reg <= '0';
+            end if;
+        end if;
+
+        -- The length of a short frame is kept until the DMA commits it
+        short_sync <= short_sync(1 downto 0) & pix_frame_toggle;
+        if dma_frame_done = '1' then
+            short_known_reg <= '0';
+            rice_length_reg <= dma_frame_words;
+        end if;
+        if short_sync(2) /= short_sync(1) then
+            short_words_reg <= unsigned(pix_frame_words);
+            short_known_reg <= '1';
+        end if;
+
+        -- Without a ring the next frame of a run follows the one just written
+        if dma_frame_done = '1' and ring_size_reg = 0 then
+            frame_offset_reg <= frame_offset_reg + frame_span;
+        end if;
+
+        -- Advance the ring each time the DMA commits the last burst of a frame,
+        -- over the buffer held by the display. A ring of one buffer cannot.
+        if dma_frame_done = '1' and ring_size_reg /= 0 then
+            ring_last_idx_reg <= ring_write_idx_reg;
+            ring_last_valid_reg <= '1';
+            if ring_write_idx_reg + 1 >= ring_size_reg then
+                ring_next := 0;
+            else
+                ring_next := ring_write_idx_reg + 1;
+            end if;
+            if disp_hold_reg = '1' and ring_next = disp_slot_reg and ring_size_reg > 1 then
+                if ring_next + 1 >= ring_size_reg then
+                    ring_next := 0;
+                else
+                    ring_next := ring_next + 1;
+                end if;
+            end if;
+            ring_write_idx_reg <= ring_next;
+        end if;
+
+        perf_toggle_sync <= perf_toggle_sync(1 downto 0) & pix_frame_toggle;
+        perf_overflow_sync0 <= pix_overflow_gray;
+        perf_overflow_sync1 <= perf_overflow_sync0;
+
+        -- pix_frame_cycles only changes again one frame later
+        if perf_toggle_sync(2) /= perf_toggle_sync(1) then
+            perf_cycles_reg <= pix_frame_cycles;
+            if acq_start_done = '1' then
+                perf_started_reg <= perf_started_reg + 1;
+            end if;
+        end if;
+        if dma_frame_done = '1' then
+            perf_done_reg <= perf_done_reg + 1;
+        end if;
+        if dma_stall = '1' then
+            perf_stall_reg <= perf_stall_reg + 1;
+        end if;
+        if unsigned(end_fifo_level) > perf_peak_reg then
+            perf_peak_reg <= unsigned(end_fifo_level);
+        end if;
+
+        ring_slot := to_integer(unsigned(AS_address(4 downto 2)));
+
+        if AS_write = '1' and AS_address = REG_CTRL then
+            -- Stop is honoured while busy, start only once the system is idle
+            if AS_writedata(1) = '1' then
+                stream_reg <= '0';
+                run_reg <= '0';
+                retake_reg <= '0';
+            elsif AS_writedata(0) = '1' and system_busy = '0' then
+                acq_start_reg <= '1';
+                if disp_hold_reg = '1' and disp_slot_reg = 0 and ring_size_reg > 1 then
+                    ring_write_idx_reg <= 1;
+                else
+                    ring_write_idx_reg <= 0;
+                end if;
+                ring_last_valid_reg <= '0';
+                frame_seq_reg <= (others => '0');
+                dropped_reg <= (others => '0');
+                frame_offset_reg <= (others => '0');
+                frames_left_reg <= frame_count_reg;
+                if frame_count_reg > 1 then
+                    run_reg <= '1';
+                else
+                    run_reg <= '0';
+                end if;
+                short_known_reg <= '0';
+                if ring_size_reg /= 0 or preview_reg = '1' or frame_count_reg > 1 then
+                    stream_reg <= '1';
+                end if;
+            end if;
+        elsif AS_write = '1' and AS_address = REG_IRQ_ENABLE then
+            irq_enable_reg <= AS_writedata;
+        elsif AS_write = '1' and AS_address = REG_PERF_CTRL then
+            if AS_writedata(PERF_SNAPSHOT) = '1' then
+                perf_started_snap <= perf_started_reg;
+                perf_done_snap <= perf_done_reg;
+                perf_overflow_snap <= perf_overflow_cnt - perf_overflow_base;
+                perf_peak_snap <= perf_peak_reg;
+                perf_stall_snap <= perf_stall_reg;
+                perf_cycles_snap <= perf_cycles_reg;
+            end if;
+            if AS_writedata(PERF_CLEAR) = '1' then
+                perf_started_reg <= (others => '0');
+                perf_done_reg <= (others => '0');
+                perf_overflow_base <= perf_overflow_cnt;
+                perf_peak_reg <= (others => '0');
+                perf_stall_reg <= (others => '0');
+                perf_cycles_reg <= (others => '0');
+            end if;
+        elsif AS_write = '1' and AS_address(7 downto 5) = REG_RING_ADDR(7 downto 5) then
+            -- A buffer can be swapped while streaming, except the one being written
+            if system_busy = '0' or ring_slot /= ring_write_idx_reg then
+                ring_addr_reg(ring_slot) <= AS_writedata;
+            end if;
+        elsif AS_write = '1' and system_busy = '0' then
+            -- A value out of range is clamped to the largest one supported
             case AS_address is
-                when "0000" =>
-                    acq_start_reg <= '1';
-                when "0100" =>
-                    dma_address_internal := AS_writedata;
+                when REG_ADDRESS =>
+                    dma_address_reg <= AS_writedata;
+                when REG_RING_SIZE =>
+                    if unsigned(AS_writedata) > RING_MAX then
+                        ring_size_reg <= RING_MAX;
+                    else
+                        ring_size_reg <= to_integer(unsigned(AS_writedata(3 downto 0)));
+                    end if;
+                when REG_MODE =>
+                    video_reg <= AS_writedata(0);
+                    preview_reg <= AS_writedata(1);
+                    handoff_reg <= AS_writedata(2);
+                -- The window must stay aligned on the Bayer pattern, and a
+                -- line on pairs of RGB565 pixels as debay and conv count them.
+                -- It is clamped to the largest one, see FRAME_WORDS_MAX.
+                when REG_WIDTH =>
+                    if unsigned(AS_writedata) > WIDTH_MAX then
+                        width_reg <= to_unsigned(WIDTH_MAX, 12);
+                    else
+                        width_reg <= unsigned(AS_writedata(11 downto 2)) & "00";
+                    end if;
+                when REG_HEIGHT =>
+                    if unsigned(AS_writedata) > HEIGHT_MAX then
+                        height_reg <= to_unsigned(HEIGHT_MAX, 12);
+                    else
+                        height_reg <= unsigned(AS_writedata(11 downto 1)) & '0';
+                    end if;
+                when REG_ROI_X =>
+                    roi_x_reg <= unsigned(AS_writedata(11 downto 1)) & '0';
+                when REG_ROI_Y =>
+                    roi_y_reg <= unsigned(AS_writedata(11 downto 1)) & '0';
+                when REG_SCALE =>
+                    if unsigned(AS_writedata) > 2 then
+                        scale_reg <= to_unsigned(2, 2);
+                    else
+                        scale_reg <= unsigned(AS_writedata(1 downto 0));
+                    end if;
+                when REG_FORMAT =>
+                    if unsigned(AS_writedata) > FORMAT_YUV422 then
+                        format_reg <= FORMAT_YUV422;
+                    else
+                        format_reg <= to_integer(unsigned(AS_writedata(2 downto 0)));
+                    end if;
+                when REG_YUV =>
+                    yuv_reg <= AS_writedata(1 downto 0);
+                when REG_CONV =>
+                    conv_mode_reg <= AS_writedata(1 downto 0);
+                    conv_shift_reg <= AS_writedata(11 downto 8);
+                when REG_CONV_K0_TOP =>
+                    conv_k0_reg(23 downto 0) <= AS_writedata(23 downto 0);
+                when REG_CONV_K0_MID =>
+                    conv_k0_reg(47 downto 24) <= AS_writedata(23 downto 0);
+                when REG_CONV_K0_BOT =>
+                    conv_k0_reg(71 downto 48) <= AS_writedata(23 downto 0);
+                when REG_CONV_K1_TOP =>
+                    conv_k1_reg(23 downto 0) <= AS_writedata(23 downto 0);
+                when REG_CONV_K1_MID =>
+                    conv_k1_reg(47 downto 24) <= AS_writedata(23 downto 0);
+                when REG_CONV_K1_BOT =>
+                    conv_k1_reg(71 downto 48) <= AS_writedata(23 downto 0);
+                when REG_BURST_LENGTH =>
+                    burst_length_reg <= AS_writedata(7 downto 0);
+                when REG_FIFO_THRESHOLD =>
+                    fifo_threshold_reg <= AS_writedata(7 downto 0);
+                when REG_LINE_LENGTH =>
+                    line_length_reg <= AS_writedata(23 downto 0);
+                -- Lines start on a word boundary
+                when REG_STRIDE =>
+                    stride_reg <= AS_writedata(31 downto 2) & "00";
+                when REG_FRAME_COUNT =>
+                    frame_count_reg <= unsigned(AS_writedata);
+                when REG_FRAME_SPAN =>
+                    frame_span_reg <= AS_writedata(31 downto 2) & "00";
+                when REG_RICE_K =>
+                    rice_k_reg <= AS_writedata(1 downto 0);
                 when others =>
-
+                    null;
             end case;
         elsif AS_read = '1' then
+            AS_readdata <= (others => '0');
             case AS_address is
-                when "0000" =>
-                    AS_readdata <= (others =>'0');
-                    AS_readdata(0) <= system_busy;
-                when "0100" =>
-                    AS_readdata <= dma_address_internal;
-                when "1000" =>
-                    AS_readdata <= (others => '0');
+                -- A short frame is busy until the DMA has committed it
+                when REG_CTRL =>
+                    AS_readdata(0) <= system_busy or short_known_reg;
+                    AS_readdata(1) <= stream_reg;
+                when REG_ADDRESS =>
+                    AS_readdata <= dma_address_reg;
+                when REG_FIFO =>
                     AS_readdata(0) <= end_fifo_busy;
-                when others => AS_readdata <= (others => '0');
+                when REG_RING_SIZE =>
+                    AS_readdata <= std_logic_vector(to_unsigned(ring_size_reg, 32));
+                when REG_RING_WRITE_IDX =>
+                    AS_readdata <= std_logic_vector(to_unsigned(ring_write_idx_reg, 32));
+                when REG_RING_LAST_IDX =>
+                    AS_readdata <= std_logic_vector(to_unsigned(ring_last_idx_reg, 32));
+                    AS_readdata(31) <= ring_last_valid_reg;
+                when REG_MODE =>
+                    AS_readdata(0) <= video_reg;
+                    AS_readdata(1) <= preview_reg;
+                    AS_readdata(2) <= handoff_reg;
+                when REG_FRAME_SEQ =>
+                    AS_readdata <= std_logic_vector(frame_seq_reg);
+                when REG_DROPPED =>
+                    AS_readdata <= std_logic_vector(dropped_reg);
+                when REG_IRQ_ENABLE =>
+                    AS_readdata <= irq_enable_reg;
+                when REG_IRQ_STATUS =>
+                    AS_readdata <= irq_status_reg;
+                when REG_WIDTH =>
+                    AS_readdata(11 downto 0) <= std_logic_vector(width_reg);
+                when REG_HEIGHT =>
+                    AS_readdata(11 downto 0) <= std_logic_vector(height_reg);
+                when REG_ROI_X =>
+                    AS_readdata(11 downto 0) <= std_logic_vector(roi_x_reg);
+                when REG_ROI_Y =>
+                    AS_readdata(11 downto 0) <= std_logic_vector(roi_y_reg);
+                when REG_FRAME_LENGTH =>
+                    AS_readdata(23 downto 0) <= std_logic_vector(frame_length);
+                when REG_SCALE =>
+                    AS_readdata(1 downto 0) <= std_logic_vector(scale_reg);
+                when REG_FORMAT =>
+                    AS_readdata <= std_logic_vector(to_unsigned(format_reg, 32));
+                when REG_BURST_LENGTH =>
+                    AS_readdata(7 downto 0) <= burst_length_reg;
+                when REG_FIFO_THRESHOLD =>
+                    AS_readdata(7 downto 0) <= fifo_threshold_reg;
+                when REG_LINE_LENGTH =>
+                    AS_readdata(23 downto 0) <= line_length_reg;
+                when REG_STRIDE =>
+                    AS_readdata <= stride_reg;
+                when REG_FRAME_COUNT =>
+                    AS_readdata <= std_logic_vector(frame_count_reg);
+                when REG_FRAME_SPAN =>
+                    AS_readdata <= frame_span_reg;
+                when REG_RICE_K =>
+                    AS_readdata(1 downto 0) <= rice_k_reg;
+                when REG_RICE_LENGTH =>
+                    AS_readdata(23 downto 0) <= std_logic_vector(rice_length_reg);
+                when REG_YUV =>
+                    AS_readdata(1 downto 0) <= yuv_reg;
+                when REG_CONV =>
+                    AS_readdata(1 downto 0) <= conv_mode_reg;
+                    AS_readdata(11 downto 8) <= conv_shift_reg;
+                when REG_CONV_K0_TOP =>
+                    AS_readdata(23 downto 0) <= conv_k0_reg(23 downto 0);
+                when REG_CONV_K0_MID =>
+                    AS_readdata(23 downto 0) <= conv_k0_reg(47 downto 24);
+                when REG_CONV_K0_BOT =>
+                    AS_readdata(23 downto 0) <= conv_k0_reg(71 downto 48);
+                when REG_CONV_K1_TOP =>
+                    AS_readdata(23 downto 0) <= conv_k1_reg(23 downto 0);
+                when REG_CONV_K1_MID =>
+                    AS_readdata(23 downto 0) <= conv_k1_reg(47 downto 24);
+                when REG_CONV_K1_BOT =>
+                    AS_readdata(23 downto 0) <= conv_k1_reg(71 downto 48);
+                when REG_PERF_STARTED =>
+                    AS_readdata <= std_logic_vector(perf_started_snap);
+                when REG_PERF_DONE =>
+                    AS_readdata <= std_logic_vector(perf_done_snap);
+                when REG_PERF_OVERFLOW =>
+                    AS_readdata <= std_logic_vector(perf_overflow_snap);
+                when REG_PERF_FIFO_PEAK =>
+                    AS_readdata(8 downto 0) <= std_logic_vector(perf_peak_snap);
+                when REG_PERF_STALL =>
+                    AS_readdata <= std_logic_vector(perf_stall_snap);
+                when REG_PERF_CYCLES =>
+                    AS_readdata <= std_logic_vector(perf_cycles_snap);
+                when others =>
+                    if AS_address(7 downto 5) = REG_RING_ADDR(7 downto 5) then
+                        AS_readdata <= ring_addr_reg(ring_slot);
+                    end if;
             end case;
         end if;
     end if;
 
     acq_start <= acq_start_reg;
-
-    dma_address <= dma_address_internal;
 end process;
 
+frame_span <= unsigned(frame_span_reg) when unsigned(frame_span_reg) /= 0 else
+              shift_left(resize(dma_frame_words, 32), 2);
+frame_address <= std_logic_vector(unsigned(dma_address_reg) + frame_offset_reg);
+
+dma_address <= frame_address when ring_size_reg = 0 else
+               ring_addr_reg(ring_write_idx_reg);
+
+dma_drop <= drop_sync(1);
+dma_stream <= preview_reg;
+
+disp_go <= disp_go_reg;
+disp_address <= disp_address_reg;
+
+acq_continuous <= stream_reg;
+acq_video <= video_reg;
+
+acq_width <= std_logic_vector(width_reg);
+acq_height <= std_logic_vector(height_reg);
+acq_roi_x <= std_logic_vector(roi_x_reg);
+acq_roi_y <= std_logic_vector(roi_y_reg);
+
+dec_scale <= std_logic_vector(scale_reg);
+
+pack_format <= std_logic_vector(to_unsigned(format_reg, 3));
+pack_yuv <= yuv_reg;
+rice_enable <= '1' when format_reg = FORMAT_RICE else
+               '0';
+rice_k <= rice_k_reg;
+snk_frame_length <= std_logic_vector(frame_length);
+
+conv_mode <= conv_mode_reg;
+conv_shift <= conv_shift_reg;
+conv_k0 <= conv_k0_reg;
+conv_k1 <= conv_k1_reg;
+-- Decimated frame, two pixels per word
+conv_line_words <= std_logic_vector(resize(shift_right(width_reg, 2 + to_integer(scale_reg)), 11));
+conv_lines <= std_logic_vector(shift_right(height_reg, 1 + to_integer(scale_reg)));
+
+frame_pixels <= width_reg * height_reg;
+rgb565_length <= shift_right(frame_pixels, 3 + 2 * to_integer(scale_reg));
+frame_length <= shift_right(frame_pixels, 1) when format_reg = FORMAT_RAW12 else
+                shift_right(frame_pixels, 4 + 2 * to_integer(scale_reg)) when format_reg = FORMAT_GRAY8 else
+                rgb565_length + shift_right(rgb565_length + shift_left(rgb565_length, 1) + 3, 2) when format_reg = FORMAT_RICE else
+                rgb565_length;
+-- Until a frame ends short the DMA takes the whole frame. A compressed
+-- frame only writes full bursts so its tail waits for the length.
+dma_frame_words <= short_words_reg when short_known_reg = '1' else
+                   frame_length;
+dma_frame_length <= std_logic_vector(resize(dma_frame_words, 32));
+dma_burst_length <= burst_length_reg;
+dma_fifo_threshold <= (others => '0') when format_reg = FORMAT_RICE else
+                      fifo_threshold_reg;
+dma_line_length <= (others => '0') when format_reg = FORMAT_RICE else
+                   line_length_reg;
+dma_stride <= stride_reg;
+
+irq <= '1' when (irq_status_reg and irq_enable_reg) /= x"00000000" else
+       '0';
+
 end arch;
@@ -0,0 +1,535 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.camera_pkg.all;
+
+LIBRARY altera_mf;
+USE altera_mf.all;
+
+-- Motion detection against the previous frame in memory. While a frame is
+-- written, the previous one is read back through a second Avalon master a
+-- FIFO ahead of the DMA, and each word written is compared with the word at
+-- the same place. The absolute differences of the luminance are summed over a
+-- grid of 20x15 tiles; a tile whose sum is above THRESHOLD is set in the
+-- motion map. The map, the number of tiles set and the sum over the frame are
+-- published once the last word of the frame is compared.
+-- The comparison needs packed frames of the same size in RGB565, GRAY8 or
+-- YUV422; the previous frame is the last one written, in whichever buffer. In
+-- a single buffer the new frame overwrites the old one behind the reads. A
+-- frame is skipped when it is dropped, or when the reads fell behind the DMA.
+-- The first frame after enabling is compared with the last one written
+-- before, if any.
+
+entity motion is
+    generic(
+        -- Longest read burst, as the DMA write bursts
+        burst_count : integer := 128;
+        burst_bitwidth : integer := 8
+    );
+    port(
+        clk : in std_logic;
+        nReset : in std_logic;
+
+        -- Avalon Interface, byte address within the block
+        AS_address : in std_logic_vector(7 downto 0);
+        AS_write : in std_logic;
+        AS_read : in std_logic;
+        AS_writedata : in std_logic_vector(31 downto 0);
+        AS_readdata : out std_logic_vector(31 downto 0);
+
+        -- Avalon Master, reads of the previous frame
+        AM_address      : out std_logic_vector(31 downto 0);
+        AM_burstCount   : out std_logic_vector(burst_bitwidth - 1 downto 0);
+        AM_read         : out std_logic;
+        AM_readData     : in  std_logic_vector(31 downto 0);
+        AM_readDataValid : in  std_logic;
+        AM_waitRequest  : in  std_logic;
+
+        -- DMA Interface, words accepted on its Avalon master
+        dma_address : in std_logic_vector(31 downto 0);
+        dma_data : in std_logic_vector(31 downto 0);
+        dma_beat : in std_logic;
+        dma_frame_done : in std_logic;
+        dma_drop : in std_logic;
+
+        -- Global Controller Interface
+        glob_format : in std_logic_vector(2 downto 0);
+        -- Frame size in RGB565 words
+        glob_line_words : in std_logic_vector(10 downto 0);
+        glob_lines : in std_logic_vector(11 downto 0)
+    );
+end motion;
+
+architecture arch of motion is
+    -- Register map (byte addresses within the block)
+    constant REG_CTRL      : std_logic_vector(7 downto 0) := x"00";
+    constant REG_THRESHOLD : std_logic_vector(7 downto 0) := x"04";
+    -- Last frame published
+    constant REG_SEQ       : std_logic_vector(7 downto 0) := x"08";
+    constant REG_SCORE     : std_logic_vector(7 downto 0) := x"0C";
+    constant REG_CHANGED   : std_logic_vector(7 downto 0) := x"10";
+    -- Frames compared but not published
+    constant REG_SKIPPED   : std_logic_vector(7 downto 0) := x"14";
+    -- One row of tiles per register from the top, the left tile in bit 0
+    constant REG_MAP       : std_logic_vector(7 downto 0) := x"40";
+
+    constant TILES_X : natural := 20;
+    constant TILES_Y : natural := 15;
+    constant DEPTH : natural := 256;
+
+    constant FORMAT_RGB565 : std_logic_vector(2 downto 0) := "000";
+    constant FORMAT_GRAY8  : std_logic_vector(2 downto 0) := "001";
+    constant FORMAT_YUV422 : std_logic_vector(2 downto 0) := "100";
+
+    type sad_t is array (0 to TILES_X - 1) of unsigned(23 downto 0);
+    type map_t is array (0 to TILES_Y - 1) of std_logic_vector(TILES_X - 1 downto 0);
+
+    component motion_fifo is
+        port(
+            clock		: in std_logic ;
+            data		: in std_logic_vector (31 downto 0);
+            rdreq		: in std_logic ;
+            sclr		: in std_logic ;
+            wrreq		: in std_logic ;
+            empty		: out std_logic ;
+            q		: out std_logic_vector (31 downto 0)
+        );
+    end component motion_fifo;
+
+    function abs_diff(a, b : std_logic_vector(7 downto 0)) return unsigned is
+    begin
+        if unsigned(a) > unsigned(b) then
+            return resize(unsigned(a) - unsigned(b), 10);
+        else
+            return resize(unsigned(b) - unsigned(a), 10);
+        end if;
+    end function;
+
+    -- Sum of the luminance differences of the pixels of a word
+    function word_diff(a, b : std_logic_vector(31 downto 0); format : std_logic_vector(2 downto 0)) return unsigned is
+    begin
+        if format = FORMAT_GRAY8 then
+            return abs_diff(a(7 downto 0), b(7 downto 0)) + abs_diff(a(15 downto 8), b(15 downto 8)) +
+                   abs_diff(a(23 downto 16), b(23 downto 16)) + abs_diff(a(31 downto 24), b(31 downto 24));
+        elsif format = FORMAT_YUV422 then
+            return abs_diff(a(7 downto 0), b(7 downto 0)) + abs_diff(a(23 downto 16), b(23 downto 16));
+        else
+            return abs_diff(luma565(a(15 downto 0)), luma565(b(15 downto 0))) +
+                   abs_diff(luma565(a(31 downto 16)), luma565(b(31 downto 16)));
+        end if;
+    end function;
+
+    function count_ones(v : std_logic_vector) return natural is
+        variable n : natural range 0 to v'length;
+    begin
+        n := 0;
+        for i in v'range loop
+            if v(i) = '1' then
+                n := n + 1;
+            end if;
+        end loop;
+        return n;
+    end function;
+
+    signal enable_reg : std_logic;
+    signal threshold_reg : unsigned(23 downto 0);
+
+    signal supported : std_logic;
+    signal line_words : natural range 0 to 2047;
+    signal lines : natural range 0 to 4095;
+    signal tile_words : natural range 1 to 2047;
+    signal tile_lines : natural range 1 to 4095;
+
+    -- Frame being written, its first beat is still to come after a reset,
+    -- the end of a frame or a drop
+    signal first_reg : std_logic;
+    signal base_reg : std_logic_vector(31 downto 0);
+    signal words_reg : unsigned(23 downto 0);
+    signal drop_prev : std_logic;
+    -- Last frame written
+    signal prev_base_reg : std_logic_vector(31 downto 0);
+    signal prev_words_reg : unsigned(23 downto 0);
+    signal prev_valid_reg : std_logic;
+    -- The frame being written is compared, and failed to
+    signal active_reg : std_logic;
+    signal error_reg : std_logic;
+
+    -- Reads of the previous frame. level_reg counts the words in the FIFO
+    -- and those requested, a restart waits for the reads in flight.
+    signal restart_reg : std_logic;
+    signal read_reg : std_logic;
+    signal rd_address_reg : unsigned(31 downto 0);
+    signal rd_len_reg : natural range 1 to burst_count;
+    signal rd_left_reg : unsigned(23 downto 0);
+    signal level_reg : natural range 0 to DEPTH;
+    signal pending_reg : natural range 0 to DEPTH;
+    signal fifo_clear : std_logic;
+    signal fifo_write : std_logic;
+    signal fifo_pop : std_logic;
+    signal fifo_empty : std_logic;
+    signal fifo_q : std_logic_vector(31 downto 0);
+    signal compare : std_logic;
+
+    -- Position of the word compared
+    signal col_reg, tile_col_reg : natural range 0 to 2047;
+    signal tile_x_reg : natural range 0 to TILES_X - 1;
+    signal row_reg, tile_row_reg : natural range 0 to 4095;
+    signal tile_y_reg : natural range 0 to TILES_Y - 1;
+
+    -- Difference of the word, the end of a row of tiles and of the frame
+    signal diff_valid_reg : std_logic;
+    signal diff_reg : unsigned(9 downto 0);
+    signal diff_tile_reg : natural range 0 to TILES_X - 1;
+    signal diff_first_reg : std_logic;
+    signal diff_flush_reg : std_logic;
+    signal diff_row_reg : natural range 0 to TILES_Y - 1;
+    signal diff_last_reg : std_logic;
+    signal diff_end_reg : std_logic;
+
+    -- Sums of the current row of tiles, thresholded in the cycle after its
+    -- last word
+    signal sad_reg : sad_t;
+    signal flush_reg : std_logic;
+    signal flush_row_reg : natural range 0 to TILES_Y - 1;
+    signal flush_last_reg : std_logic;
+    signal flush_end_reg : std_logic;
+    signal map_work_reg : map_t;
+    signal score_work_reg : unsigned(31 downto 0);
+    signal changed_work_reg : natural range 0 to TILES_X*TILES_Y;
+
+    signal map_reg : map_t;
+    signal score_reg : unsigned(31 downto 0);
+    signal changed_reg : natural range 0 to TILES_X*TILES_Y;
+    signal seq_reg : unsigned(31 downto 0);
+    signal skipped_reg : unsigned(31 downto 0);
+begin
+    supported <= '1' when (glob_format = FORMAT_RGB565) or (glob_format = FORMAT_GRAY8) or
+                          (glob_format = FORMAT_YUV422) else
+                 '0';
+
+    line_words <= to_integer(unsigned(glob_line_words(10 downto 1))) when glob_format = FORMAT_GRAY8 else
+                  to_integer(unsigned(glob_line_words));
+    lines <= to_integer(unsigned(glob_lines));
+    -- The tiles of the last row and column take what is left
+    tile_words <= line_words / TILES_X when line_words >= TILES_X else
+                  1;
+    tile_lines <= lines / TILES_Y when lines >= TILES_Y else
+                  1;
+
+    compare <= dma_beat and (active_reg or (first_reg and enable_reg and prev_valid_reg and supported));
+    fifo_pop <= compare and not fifo_empty;
+    fifo_write <= AM_readDataValid and not restart_reg;
+
+    process(clk, nReset)
+        variable words : unsigned(23 downto 0);
+        variable len : natural range 1 to burst_count;
+        variable level : natural range 0 to DEPTH;
+        variable pending : natural range 0 to DEPTH;
+        variable last_col, last_line : boolean;
+        variable bits : std_logic_vector(TILES_X - 1 downto 0);
+        variable work : map_t;
+        variable v : unsigned(23 downto 0);
+        variable skip : boolean;
+    begin
+        if nReset = '0' then
+            enable_reg <= '0';
+            threshold_reg <= (others => '0');
+            first_reg <= '1';
+            base_reg <= (others => '0');
+            words_reg <= (others => '0');
+            drop_prev <= '0';
+            prev_base_reg <= (others => '0');
+            prev_words_reg <= (others => '0');
+            prev_valid_reg <= '0';
+            active_reg <= '0';
+            error_reg <= '0';
+            restart_reg <= '0';
+            read_reg <= '0';
+            rd_address_reg <= (others => '0');
+            rd_len_reg <= 1;
+            rd_left_reg <= (others => '0');
+            level_reg <= 0;
+            pending_reg <= 0;
+            fifo_clear <= '0';
+            col_reg <= 0;
+            tile_col_reg <= 0;
+            tile_x_reg <= 0;
+            row_reg <= 0;
+            tile_row_reg <= 0;
+            tile_y_reg <= 0;
+            diff_valid_reg <= '0';
+            diff_reg <= (others => '0');
+            diff_tile_reg <= 0;
+            diff_first_reg <= '0';
+            diff_flush_reg <= '0';
+            diff_row_reg <= 0;
+            diff_last_reg <= '0';
+            diff_end_reg <= '0';
+            sad_reg <= (others => (others => '0'));
+            flush_reg <= '0';
+            flush_row_reg <= 0;
+            flush_last_reg <= '0';
+            flush_end_reg <= '0';
+            map_work_reg <= (others => (others => '0'));
+            score_work_reg <= (others => '0');
+            changed_work_reg <= 0;
+            map_reg <= (others => (others => '0'));
+            score_reg <= (others => '0');
+            changed_reg <= 0;
+            seq_reg <= (others => '0');
+            skipped_reg <= (others => '0');
+            AS_readdata <= (others => '0');
+        elsif rising_edge(clk) then
+            drop_prev <= dma_drop;
+            fifo_clear <= '0';
+            skip := false;
+
+            -- Frames written by the DMA
+            words := words_reg;
+            if dma_beat = '1' then
+                if first_reg = '1' then
+                    base_reg <= dma_address;
+                    words := to_unsigned(1, 24);
+                    first_reg <= '0';
+                    active_reg <= compare;
+                    error_reg <= '0';
+                else
+                    words := words + 1;
+                end if;
+            end if;
+            words_reg <= words;
+            if compare = '1' and fifo_empty = '1' then
+                error_reg <= '1';
+            end if;
+
+            -- A frame in memory becomes the reference of the next one, whose
+            -- reads start over
+            if dma_frame_done = '1' then
+                first_reg <= '1';
+                active_reg <= '0';
+                if words /= 0 then
+                    prev_valid_reg <= '1';
+                    if first_reg = '1' then
+                        prev_base_reg <= dma_address;
+                    else
+                        prev_base_reg <= base_reg;
+                    end if;
+                    prev_words_reg <= words;
+                    restart_reg <= '1';
+                    fifo_clear <= '1';
+                end if;
+            end if;
+            if dma_drop = '1' and drop_prev = '0' then
+                first_reg <= '1';
+                active_reg <= '0';
+                if active_reg = '1' then
+                    skip := true;
+                end if;
+                restart_reg <= '1';
+                fifo_clear <= '1';
+            end if;
+
+            -- Read master, the burst is held until accepted
+            level := level_reg;
+            pending := pending_reg;
+            if read_reg = '1' and AM_waitRequest = '0' then
+                read_reg <= '0';
+                rd_address_reg <= rd_address_reg + to_unsigned(rd_len_reg * 4, 32);
+                rd_left_reg <= rd_left_reg - rd_len_reg;
+                pending := pending + rd_len_reg;
+            end if;
+            if AM_readDataValid = '1' then
+                pending := pending - 1;
+            end if;
+            if fifo_pop = '1' then
+                level := level - 1;
+            end if;
+            if restart_reg = '1' then
+                if read_reg = '0' and pending = 0 then
+                    restart_reg <= '0';
+                    level := 0;
+                    rd_address_reg <= unsigned(prev_base_reg);
+                    if enable_reg = '1' and supported = '1' then
+                        rd_left_reg <= prev_words_reg;
+                    else
+                        rd_left_reg <= (others => '0');
+                    end if;
+                end if;
+            elsif read_reg = '0' and rd_left_reg /= 0 then
+                if rd_left_reg < burst_count then
+                    len := to_integer(rd_left_reg);
+                else
+                    len := burst_count;
+                end if;
+                if level + len <= DEPTH then
+                    read_reg <= '1';
+                    rd_len_reg <= len;
+                    level := level + len;
+                end if;
+            end if;
+            level_reg <= level;
+            pending_reg <= pending;
+
+            -- Position and difference of the word compared
+            diff_valid_reg <= compare;
+            diff_reg <= word_diff(dma_data, fifo_q, glob_format);
+            diff_tile_reg <= tile_x_reg;
+            diff_row_reg <= tile_y_reg;
+            diff_first_reg <= first_reg;
+            diff_last_reg <= dma_frame_done;
+            last_col := col_reg + 1 >= line_words;
+            last_line := row_reg + 1 >= lines;
+            diff_flush_reg <= '0';
+            diff_end_reg <= '0';
+            if last_col and (last_line or (tile_row_reg + 1 >= tile_lines and tile_y_reg /= TILES_Y - 1)) then
+                diff_flush_reg <= '1';
+            end if;
+            if last_col and last_line then
+                diff_end_reg <= '1';
+            end if;
+            if compare = '1' then
+                if last_col then
+                    col_reg <= 0;
+                    tile_col_reg <= 0;
+                    tile_x_reg <= 0;
+                    if last_line then
+                        row_reg <= 0;
+                        tile_row_reg <= 0;
+                        tile_y_reg <= 0;
+                    else
+                        row_reg <= row_reg + 1;
+                        if tile_row_reg + 1 >= tile_lines and tile_y_reg /= TILES_Y - 1 then
+                            tile_row_reg <= 0;
+                            tile_y_reg <= tile_y_reg + 1;
+                        else
+                            tile_row_reg <= tile_row_reg + 1;
+                        end if;
+                    end if;
+                else
+                    col_reg <= col_reg + 1;
+                    if tile_col_reg + 1 >= tile_words and tile_x_reg /= TILES_X - 1 then
+                        tile_col_reg <= 0;
+                        tile_x_reg <= tile_x_reg + 1;
+                    else
+                        tile_col_reg <= tile_col_reg + 1;
+                    end if;
+                end if;
+            end if;
+            if first_reg = '1' and dma_beat = '0' then
+                col_reg <= 0;
+                tile_col_reg <= 0;
+                tile_x_reg <= 0;
+                row_reg <= 0;
+                tile_row_reg <= 0;
+                tile_y_reg <= 0;
+            end if;
+
+            -- Sums of the tiles, a row of tiles is thresholded in the cycle
+            -- after its last word
+            flush_reg <= diff_valid_reg and (diff_flush_reg or diff_last_reg);
+            flush_row_reg <= diff_row_reg;
+            flush_last_reg <= diff_valid_reg and diff_last_reg;
+            flush_end_reg <= diff_end_reg;
+            for i in 0 to TILES_X - 1 loop
+                v := sad_reg(i);
+                bits(i) := '0';
+                if v > threshold_reg then
+                    bits(i) := '1';
+                end if;
+                if flush_reg = '1' or (diff_valid_reg = '1' and diff_first_reg = '1') then
+                    v := (others => '0');
+                end if;
+                if diff_valid_reg = '1' and diff_tile_reg = i then
+                    v := v + diff_reg;
+                end if;
+                sad_reg(i) <= v;
+            end loop;
+
+            if diff_valid_reg = '1' then
+                if diff_first_reg = '1' then
+                    score_work_reg <= resize(diff_reg, 32);
+                    changed_work_reg <= 0;
+                else
+                    score_work_reg <= score_work_reg + diff_reg;
+                end if;
+            end if;
+
+            if flush_reg = '1' then
+                work := map_work_reg;
+                work(flush_row_reg) := bits;
+                map_work_reg <= work;
+                changed_work_reg <= changed_work_reg + count_ones(bits);
+                if flush_last_reg = '1' then
+                    -- The frame matched the geometry and the reads kept up
+                    if flush_end_reg = '1' and error_reg = '0' then
+                        map_reg <= work;
+                        score_reg <= score_work_reg;
+                        changed_reg <= changed_work_reg + count_ones(bits);
+                        seq_reg <= seq_reg + 1;
+                    else
+                        skip := true;
+                    end if;
+                end if;
+            end if;
+            if skip then
+                skipped_reg <= skipped_reg + 1;
+            end if;
+
+            -- Avalon slave write to registers. Enabling while idle reads the
+            -- last frame for the next one.
+            if AS_write = '1' then
+                case AS_address is
+                    when REG_CTRL =>
+                        enable_reg <= AS_writedata(0);
+                        if AS_writedata(0) = '1' and enable_reg = '0' and prev_valid_reg = '1' and first_reg = '1' then
+                            restart_reg <= '1';
+                            fifo_clear <= '1';
+                        end if;
+                    when REG_THRESHOLD =>
+                        threshold_reg <= unsigned(AS_writedata(23 downto 0));
+                    when others =>
+                        null;
+                end case;
+            end if;
+
+            --Avalon slave read from registers.
+            if AS_read = '1' then
+                AS_readdata <= (others => '0');
+                case AS_address is
+                    when REG_CTRL =>
+                        AS_readdata(0) <= enable_reg;
+                    when REG_THRESHOLD =>
+                        AS_readdata(23 downto 0) <= std_logic_vector(threshold_reg);
+                    when REG_SEQ =>
+                        AS_readdata <= std_logic_vector(seq_reg);
+                    when REG_SCORE =>
+                        AS_readdata <= std_logic_vector(score_reg);
+                    when REG_CHANGED =>
+                        AS_readdata <= std_logic_vector(to_unsigned(changed_reg, 32));
+                    when REG_SKIPPED =>
+                        AS_readdata <= std_logic_vector(skipped_reg);
+                    when others =>
+                        if AS_address(7 downto 6) = REG_MAP(7 downto 6) and
+                           to_integer(unsigned(AS_address(5 downto 2))) < TILES_Y then
+                            AS_readdata(TILES_X - 1 downto 0) <= map_reg(to_integer(unsigned(AS_address(5 downto 2))));
+                        end if;
+                end case;
+            end if;
+        end if;
+    end process;
+
+    AM_read <= read_reg;
+    AM_address <= std_logic_vector(rd_address_reg);
+    AM_burstCount <= std_logic_vector(to_unsigned(rd_len_reg, AM_burstCount'length));
+
+fifo: motion_fifo port map(
+    clock => clk,
+    data => AM_readData,
+    rdreq => fifo_pop,
+    sclr => fifo_clear,
+    wrreq => fifo_write,
+    empty => fifo_empty,
+    q => fifo_q
+);
+
+end arch;
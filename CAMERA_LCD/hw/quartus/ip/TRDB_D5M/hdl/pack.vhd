@@ -0,0 +1,98 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.camera_pkg.all;
+
+-- Latency of the module: 0 cycle
+-- Output pixel format written to end_fifo, earliest pixel in the low bits:
+--  RGB565: two debayered pixels per word, as produced by debay
+--  GRAY8:  four luminance bytes per word, computed by debay on the 12-bit
+--          samples
+--  RAW12:  two Bayer samples per word, each in the low 12 bits of a half word,
+--          taken before debay so decimation does not apply
+--  RICE:   RGB565 words, compressed by rice after pack
+--  YUV422: two pixels per word as Y0 U Y1 V, see yuv888, converted from the
+--          8-bit components so Y is the GRAY8 luminance in the full range
+--          BT.601 matrix
+
+entity pack is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Debayerization Interface, after decimation
+        rgb_pixeldata_x2 : in std_logic_vector(31 downto 0);
+        luma_x2 : in std_logic_vector(15 downto 0);
+        rgb888_x2 : in std_logic_vector(47 downto 0);
+        rgb_write : in std_logic;
+
+        -- Acquisition Interface
+        raw_pixel_data : in std_logic_vector(11 downto 0);
+        raw_valid : in std_logic;
+
+        -- end_fifo Interface
+        end_data : out std_logic_vector(31 downto 0);
+        end_write : out std_logic;
+
+        -- Global Controller Interface
+        -- 0: RGB565, 1: GRAY8, 2: RAW12, 3: RICE, 4: YUV422
+        glob_format : in std_logic_vector(2 downto 0);
+        -- Conversion matrix of YUV422
+        glob_yuv : in std_logic_vector(1 downto 0);
+
+        sys_soft_rst : in std_logic
+    );
+end pack;
+
+architecture arch of pack is
+    constant FORMAT_RGB565 : std_logic_vector(2 downto 0) := "000";
+    constant FORMAT_GRAY8  : std_logic_vector(2 downto 0) := "001";
+    constant FORMAT_RAW12  : std_logic_vector(2 downto 0) := "010";
+    constant FORMAT_RICE   : std_logic_vector(2 downto 0) := "011";
+    constant FORMAT_YUV422 : std_logic_vector(2 downto 0) := "100";
+
+    -- First half of the next output word
+    signal half_reg, half_next : std_logic_vector(15 downto 0);
+    signal half_valid_reg, half_valid_next : std_logic;
+
+    signal in_write : std_logic;
+    signal gray_x2 : std_logic_vector(15 downto 0);
+    signal raw_x1 : std_logic_vector(15 downto 0);
+    signal yuv_x2 : std_logic_vector(31 downto 0);
+begin
+    process(clk, rst_n)
+    begin
+        if rst_n = '0' then
+            half_reg <= (others => '0');
+            half_valid_reg <= '0';
+        elsif rising_edge(clk) then
+            half_reg <= half_next;
+            half_valid_reg <= half_valid_next;
+
+            if sys_soft_rst = '1' then
+                half_valid_reg <= '0';
+            end if;
+        end if;
+    end process;
+
+    gray_x2 <= luma_x2;
+    raw_x1 <= "0000" & raw_pixel_data;
+    yuv_x2 <= yuv888(rgb888_x2(23 downto 0), rgb888_x2(47 downto 24), glob_yuv);
+
+    in_write <= raw_valid when glob_format = FORMAT_RAW12 else
+                rgb_write;
+
+    half_next <= raw_x1 when (glob_format = FORMAT_RAW12) and (in_write = '1') and (half_valid_reg = '0') else
+                 gray_x2 when (in_write = '1') and (half_valid_reg = '0') else
+                 half_reg;
+    half_valid_next <= not half_valid_reg when in_write = '1' else
+                       half_valid_reg;
+
+    end_data <= raw_x1 & half_reg when glob_format = FORMAT_RAW12 else
+                gray_x2 & half_reg when glob_format = FORMAT_GRAY8 else
+                yuv_x2 when glob_format = FORMAT_YUV422 else
+                rgb_pixeldata_x2;
+    end_write <= rgb_write when (glob_format = FORMAT_RGB565) or (glob_format = FORMAT_RICE) or
+                                (glob_format = FORMAT_YUV422) else
+                 in_write and half_valid_reg;
+end arch;
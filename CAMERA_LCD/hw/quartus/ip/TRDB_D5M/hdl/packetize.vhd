@@ -0,0 +1,134 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Latency of the module: 1 cycle after the next word, or after the end of the frame
+-- Avalon-ST source of the words of the pixel pipeline, one packet per frame.
+-- A word is held until the next one arrives, so the last one of a frame can
+-- be marked with endofpacket: the frame ends once frame_valid is low and the
+-- pipeline has written nothing for QUIET cycles. The next word after a
+-- frame_valid rise starts a packet.
+-- The sensor cannot be stalled, a word refused by the sink is lost and
+-- reported on overflow.
+
+entity packetize is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- Pixel pipeline Interface
+        pipe_data : in std_logic_vector(31 downto 0);
+        pipe_write : in std_logic;
+        -- A stage is still writing the end of the frame
+        pipe_busy : in std_logic;
+
+        -- Acquisition Interface
+        acq_frame_valid : in std_logic;
+
+        -- Avalon-ST Source, ready latency 0
+        ST_data          : out std_logic_vector(31 downto 0);
+        ST_valid         : out std_logic;
+        ST_ready         : in  std_logic;
+        ST_startofpacket : out std_logic;
+        ST_endofpacket   : out std_logic;
+
+        -- A word was refused by the sink
+        overflow : out std_logic;
+        -- The last word of a frame is still held
+        busy : out std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end packetize;
+
+architecture arch of packetize is
+    -- Idle cycles closing a frame, above the latency of the stages after acq
+    constant QUIET : natural := 8;
+
+    signal frame_valid_prev : std_logic;
+    -- The next word starts a packet
+    signal sop_next_reg : std_logic;
+
+    signal hold_reg : std_logic_vector(31 downto 0);
+    signal hold_valid_reg : std_logic;
+    signal hold_sop_reg : std_logic;
+    signal quiet_cnt : natural range 0 to QUIET - 1;
+
+    signal st_data_reg : std_logic_vector(31 downto 0);
+    signal st_valid_reg : std_logic;
+    signal st_sop_reg : std_logic;
+    signal st_eop_reg : std_logic;
+begin
+    process(clk, rst_n)
+    begin
+        if rst_n = '0' then
+            frame_valid_prev <= '0';
+            sop_next_reg <= '0';
+            hold_reg <= (others => '0');
+            hold_valid_reg <= '0';
+            hold_sop_reg <= '0';
+            quiet_cnt <= 0;
+            st_data_reg <= (others => '0');
+            st_valid_reg <= '0';
+            st_sop_reg <= '0';
+            st_eop_reg <= '0';
+        elsif rising_edge(clk) then
+            frame_valid_prev <= acq_frame_valid;
+
+            st_valid_reg <= '0';
+            st_sop_reg <= '0';
+            st_eop_reg <= '0';
+            st_data_reg <= hold_reg;
+
+            if pipe_write = '1' then
+                -- The held word is followed by another one of the frame
+                if hold_valid_reg = '1' then
+                    st_valid_reg <= '1';
+                    st_sop_reg <= hold_sop_reg;
+                end if;
+                hold_reg <= pipe_data;
+                hold_valid_reg <= '1';
+                hold_sop_reg <= sop_next_reg;
+                sop_next_reg <= '0';
+                quiet_cnt <= 0;
+            elsif hold_valid_reg = '1' and acq_frame_valid = '0' and pipe_busy = '0' then
+                if quiet_cnt = QUIET - 1 then
+                    st_valid_reg <= '1';
+                    st_sop_reg <= hold_sop_reg;
+                    st_eop_reg <= '1';
+                    hold_valid_reg <= '0';
+                    quiet_cnt <= 0;
+                else
+                    quiet_cnt <= quiet_cnt + 1;
+                end if;
+            else
+                quiet_cnt <= 0;
+            end if;
+
+            -- A new frame closes the previous packet if still open
+            if acq_frame_valid = '1' and frame_valid_prev = '0' then
+                sop_next_reg <= '1';
+                if hold_valid_reg = '1' and pipe_write = '0' then
+                    st_valid_reg <= '1';
+                    st_sop_reg <= hold_sop_reg;
+                    st_eop_reg <= '1';
+                    hold_valid_reg <= '0';
+                end if;
+            end if;
+
+            if sys_soft_rst = '1' then
+                sop_next_reg <= '0';
+                hold_valid_reg <= '0';
+                quiet_cnt <= 0;
+            end if;
+        end if;
+    end process;
+
+    ST_data <= st_data_reg;
+    ST_valid <= st_valid_reg;
+    ST_startofpacket <= st_sop_reg;
+    ST_endofpacket <= st_eop_reg;
+
+    overflow <= st_valid_reg and not ST_ready;
+    busy <= hold_valid_reg or st_valid_reg;
+end arch;
@@ -0,0 +1,184 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Latency of the module: 0 cycle when disabled, 2 cycles otherwise
+-- Lossless compression of the RGB565 words of pack, decoded by
+-- trdb_d5m_rice_decode(). Each channel is predicted from the same channel of
+-- the previous pixel in raster order, the first pixel of a frame from 0. The
+-- difference modulo the channel width is mapped 0, -1, 1, -2, ... to
+-- 0, 1, 2, 3, ... and the result e is Rice coded with the parameter k:
+--  e < ESC*2^k: e/2^k ones, a zero, then the k low bits of e
+--  otherwise:   ESC ones, then e on the channel width
+-- The codes of a pixel are written R, G then B, the earlier pixel of a word
+-- first, and packed from the low bit of each output word. The last word of a
+-- frame is padded with zeros, its number of words is counted by depacketize.
+-- An input word takes up to 56 bits. At most one every other cycle is
+-- accepted, debay writes at half that rate.
+
+entity rice is
+    port(
+        clk : in std_logic;
+        rst_n : in std_logic;
+
+        -- pack Interface, RGB565 words
+        pack_data : in std_logic_vector(31 downto 0);
+        pack_write : in std_logic;
+
+        -- Acquisition Interface
+        acq_frame_valid : in std_logic;
+
+        -- end_fifo Interface
+        end_data : out std_logic_vector(31 downto 0);
+        end_write : out std_logic;
+
+        -- Global Controller Interface
+        glob_enable : in std_logic;
+        glob_k : in std_logic_vector(1 downto 0);
+        -- The end of a frame is still being written
+        glob_busy : out std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end rice;
+
+architecture arch of rice is
+    -- Longest unary part, a larger value is escaped
+    constant ESC : natural := 4;
+    constant ONES : unsigned(63 downto 0) := (others => '1');
+
+    -- Code of up to 64 bits, earliest bit in the low bit
+    type code_t is record
+        bits : unsigned(63 downto 0);
+        len : natural range 0 to 64;
+    end record;
+
+    function rice_code(cur, prev : std_logic_vector; k : natural) return code_t is
+        constant n : natural := cur'length;
+        variable d : unsigned(n - 1 downto 0);
+        variable sign : unsigned(n - 1 downto 0);
+        variable e : unsigned(n - 1 downto 0);
+        variable q : natural range 0 to 2**n - 1;
+        variable c : code_t;
+    begin
+        d := unsigned(cur) - unsigned(prev);
+        -- Fold the sign into the low bit
+        sign := (others => d(n - 1));
+        e := shift_left(d, 1) xor sign;
+        q := to_integer(shift_right(e, k));
+        if q < ESC then
+            c.bits := (not shift_left(ONES, q)) or
+                      shift_left(resize(e, 64) and not shift_left(ONES, k), q + 1);
+            c.len := q + 1 + k;
+        else
+            c.bits := (not shift_left(ONES, ESC)) or shift_left(resize(e, 64), ESC);
+            c.len := ESC + n;
+        end if;
+        return c;
+    end function;
+
+    function pixel_code(cur, prev : std_logic_vector(15 downto 0); k : natural) return code_t is
+        variable r, g, b : code_t;
+        variable c : code_t;
+    begin
+        r := rice_code(cur(15 downto 11), prev(15 downto 11), k);
+        g := rice_code(cur(10 downto 5), prev(10 downto 5), k);
+        b := rice_code(cur(4 downto 0), prev(4 downto 0), k);
+        c.bits := r.bits or shift_left(g.bits, r.len) or shift_left(b.bits, r.len + g.len);
+        c.len := r.len + g.len + b.len;
+        return c;
+    end function;
+
+    signal frame_valid_prev : std_logic;
+    -- Last pixel coded, the prediction of the next one
+    signal prev_reg : std_logic_vector(15 downto 0);
+
+    -- Code of the last input word
+    signal code_reg : code_t;
+    signal code_valid_reg : std_logic;
+
+    -- Bits not written yet, fill_reg of them from the low bit
+    signal buf_reg : unsigned(95 downto 0);
+    signal fill_reg : natural range 0 to 95;
+    -- Writing out what is left of the frame
+    signal flush_reg : std_logic;
+
+    signal out_data_reg : std_logic_vector(31 downto 0);
+    signal out_write_reg : std_logic;
+begin
+    process(clk, rst_n)
+        variable c0, c1 : code_t;
+        variable buf : unsigned(95 downto 0);
+        variable fill : natural range 0 to 95;
+    begin
+        if rst_n = '0' then
+            frame_valid_prev <= '0';
+            prev_reg <= (others => '0');
+            code_reg <= ((others => '0'), 0);
+            code_valid_reg <= '0';
+            buf_reg <= (others => '0');
+            fill_reg <= 0;
+            flush_reg <= '0';
+            out_data_reg <= (others => '0');
+            out_write_reg <= '0';
+        elsif rising_edge(clk) then
+            frame_valid_prev <= acq_frame_valid;
+
+            -- Code both pixels of the word
+            code_valid_reg <= pack_write and glob_enable;
+            if pack_write = '1' then
+                c0 := pixel_code(pack_data(15 downto 0), prev_reg, to_integer(unsigned(glob_k)));
+                c1 := pixel_code(pack_data(31 downto 16), pack_data(15 downto 0), to_integer(unsigned(glob_k)));
+                code_reg.bits <= c0.bits or shift_left(c1.bits, c0.len);
+                code_reg.len <= c0.len + c1.len;
+                prev_reg <= pack_data(31 downto 16);
+            end if;
+
+            -- Write a full word, then append the new code behind what is left.
+            -- At the end of the frame the remaining bits are written padded.
+            buf := buf_reg;
+            fill := fill_reg;
+            out_write_reg <= '0';
+            if fill >= 32 then
+                out_data_reg <= std_logic_vector(buf(31 downto 0));
+                out_write_reg <= '1';
+                buf := shift_right(buf, 32);
+                fill := fill - 32;
+            elsif flush_reg = '1' and code_valid_reg = '0' then
+                if fill /= 0 then
+                    out_data_reg <= std_logic_vector(buf(31 downto 0));
+                    out_write_reg <= '1';
+                    buf := (others => '0');
+                    fill := 0;
+                else
+                    flush_reg <= '0';
+                end if;
+            end if;
+            if code_valid_reg = '1' then
+                buf := buf or shift_left(resize(code_reg.bits, 96), fill);
+                fill := fill + code_reg.len;
+            end if;
+            buf_reg <= buf;
+            fill_reg <= fill;
+
+            if acq_frame_valid = '0' and frame_valid_prev = '1' then
+                flush_reg <= '1';
+            end if;
+
+            if (acq_frame_valid = '1' and frame_valid_prev = '0') or sys_soft_rst = '1' then
+                prev_reg <= (others => '0');
+                code_valid_reg <= '0';
+                buf_reg <= (others => '0');
+                fill_reg <= 0;
+                flush_reg <= '0';
+            end if;
+        end if;
+    end process;
+
+    end_data <= out_data_reg when glob_enable = '1' else
+                pack_data;
+    end_write <= out_write_reg when glob_enable = '1' else
+                 pack_write;
+
+    glob_busy <= glob_enable and flush_reg;
+end arch;
@@ -0,0 +1,169 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+use work.camera_pkg.all;
+
+-- Frame statistics on the debayered pixels: 64-bin luminance histogram and
+-- per channel sums, in the RGB565 component ranges (R and B 0-31, G 0-63).
+-- They accumulate on pix_clk and are copied to the registers read over Avalon
+-- when a captured frame ends, a dropped frame is discarded. The copy is not
+-- synchronised to clk: read SEQ before and after the block and retry if it
+-- changed.
+
+entity stats is
+    port(
+        clk : in std_logic;
+        nReset : in std_logic;
+
+        -- Avalon Interface, byte address within the block
+        AS_address : in std_logic_vector(8 downto 0);
+        AS_read : in std_logic;
+        AS_readdata : out std_logic_vector(31 downto 0);
+
+        -- Camera clock domain
+        pix_clk : in std_logic;
+        pix_frame_valid : in std_logic;
+
+        -- Debayerization Interface
+        deb_rgb_pixeldata_x2 : in std_logic_vector(31 downto 0);
+        deb_write : in std_logic;
+
+        -- The current frame is being dropped
+        acq_drop : in std_logic;
+
+        sys_soft_rst : in std_logic
+    );
+end stats;
+
+architecture arch of stats is
+    -- Register map (byte addresses within the block)
+    -- Histogram bins occupy 64 consecutive words from 0x000
+    constant REG_SEQ    : std_logic_vector(8 downto 0) := '1' & x"00";
+    constant REG_PIXELS : std_logic_vector(8 downto 0) := '1' & x"04";
+    constant REG_SUM_R  : std_logic_vector(8 downto 0) := '1' & x"08";
+    constant REG_SUM_G  : std_logic_vector(8 downto 0) := '1' & x"0C";
+    constant REG_SUM_B  : std_logic_vector(8 downto 0) := '1' & x"10";
+
+    constant BINS : natural := 64;
+
+    type hist_t is array (0 to BINS - 1) of unsigned(23 downto 0);
+
+    -- Accumulated over the frame in progress
+    signal hist_acc : hist_t;
+    signal pixels_acc : unsigned(23 downto 0);
+    signal sum_r_acc, sum_g_acc, sum_b_acc : unsigned(31 downto 0);
+    signal drop_seen : std_logic;
+
+    -- Last complete frame
+    signal hist_reg : hist_t;
+    signal pixels_reg : unsigned(23 downto 0);
+    signal sum_r_reg, sum_g_reg, sum_b_reg : unsigned(31 downto 0);
+    signal seq_reg : unsigned(31 downto 0);
+
+    signal frame_valid_prev : std_logic;
+    signal frame_end : std_logic;
+
+    -- Pixels of the incoming word, earliest in the low half
+    signal p0, p1 : std_logic_vector(15 downto 0);
+    signal y0, y1 : std_logic_vector(7 downto 0);
+    signal bin0, bin1 : natural range 0 to BINS - 1;
+begin
+    p0 <= deb_rgb_pixeldata_x2(15 downto 0);
+    p1 <= deb_rgb_pixeldata_x2(31 downto 16);
+
+    y0 <= luma565(p0);
+    y1 <= luma565(p1);
+    bin0 <= to_integer(unsigned(y0(7 downto 2)));
+    bin1 <= to_integer(unsigned(y1(7 downto 2)));
+
+    frame_end <= frame_valid_prev and not pix_frame_valid;
+
+    process(pix_clk, nReset)
+        variable inc : unsigned(1 downto 0);
+    begin
+        if nReset = '0' then
+            hist_acc <= (others => (others => '0'));
+            pixels_acc <= (others => '0');
+            sum_r_acc <= (others => '0');
+            sum_g_acc <= (others => '0');
+            sum_b_acc <= (others => '0');
+            drop_seen <= '0';
+            hist_reg <= (others => (others => '0'));
+            pixels_reg <= (others => '0');
+            sum_r_reg <= (others => '0');
+            sum_g_reg <= (others => '0');
+            sum_b_reg <= (others => '0');
+            seq_reg <= (others => '0');
+            frame_valid_prev <= '0';
+        elsif rising_edge(pix_clk) then
+            frame_valid_prev <= pix_frame_valid;
+
+            if acq_drop = '1' then
+                drop_seen <= '1';
+            end if;
+
+            if frame_end = '1' or sys_soft_rst = '1' then
+                -- Only frames that produced pixels are published
+                if frame_end = '1' and drop_seen = '0' and acq_drop = '0' and pixels_acc /= 0 then
+                    hist_reg <= hist_acc;
+                    pixels_reg <= pixels_acc;
+                    sum_r_reg <= sum_r_acc;
+                    sum_g_reg <= sum_g_acc;
+                    sum_b_reg <= sum_b_acc;
+                    seq_reg <= seq_reg + 1;
+                end if;
+                hist_acc <= (others => (others => '0'));
+                pixels_acc <= (others => '0');
+                sum_r_acc <= (others => '0');
+                sum_g_acc <= (others => '0');
+                sum_b_acc <= (others => '0');
+                drop_seen <= '0';
+            elsif deb_write = '1' then
+                for i in 0 to BINS - 1 loop
+                    inc := "00";
+                    if bin0 = i then
+                        inc := inc + 1;
+                    end if;
+                    if bin1 = i then
+                        inc := inc + 1;
+                    end if;
+                    hist_acc(i) <= hist_acc(i) + inc;
+                end loop;
+                pixels_acc <= pixels_acc + 2;
+                sum_r_acc <= sum_r_acc + unsigned(p0(15 downto 11)) + unsigned(p1(15 downto 11));
+                sum_g_acc <= sum_g_acc + unsigned(p0(10 downto 5)) + unsigned(p1(10 downto 5));
+                sum_b_acc <= sum_b_acc + unsigned(p0(4 downto 0)) + unsigned(p1(4 downto 0));
+            end if;
+        end if;
+    end process;
+
+    --Avalon slave read from registers.
+    process(clk, nReset)
+    begin
+        if nReset = '0' then
+            AS_readdata <= (others => '0');
+        elsif rising_edge(clk) then
+            if AS_read = '1' then
+                AS_readdata <= (others => '0');
+                if AS_address(8) = '0' then
+                    AS_readdata(23 downto 0) <= std_logic_vector(hist_reg(to_integer(unsigned(AS_address(7 downto 2)))));
+                else
+                    case AS_address is
+                        when REG_SEQ =>
+                            AS_readdata <= std_logic_vector(seq_reg);
+                        when REG_PIXELS =>
+                            AS_readdata(23 downto 0) <= std_logic_vector(pixels_reg);
+                        when REG_SUM_R =>
+                            AS_readdata <= std_logic_vector(sum_r_reg);
+                        when REG_SUM_G =>
+                            AS_readdata <= std_logic_vector(sum_g_reg);
+                        when REG_SUM_B =>
+                            AS_readdata <= std_logic_vector(sum_b_reg);
+                        when others =>
+                            null;
+                    end case;
+                end if;
+            end if;
+        end if;
+    end process;
+end arch;
@@ -0,0 +1,237 @@
+library ieee;
+use ieee.std_logic_1164.all;
+use ieee.numeric_std.all;
+
+-- Frame timestamps from a free running 64-bit counter on clk. Each committed
+-- frame leaves a record in a small history FIFO with three times:
+--  START: frame_valid rise of the frame
+--  LAST:  frame_valid fall, once the frame wrote pixels to end_fifo. The last
+--         pixel precedes it by the sensor blanking at the end of a line.
+--  DONE:  the DMA committed the last burst of the frame
+-- Camera events are taken after their toggle is synchronised, 2 to 3 clk
+-- cycles late. A dropped frame leaves no record, even when the drop comes
+-- after its end: the end of the frame is forgotten so that it cannot pair
+-- with the commit of the next frame. When the FIFO is full the new record is
+-- lost, its SEQ is skipped; the oldest one only leaves on a pop, so it never
+-- changes while being read.
+
+entity timestamp is
+    port(
+        clk : in std_logic;
+        nReset : in std_logic;
+
+        -- Avalon Interface, byte address within the block
+        AS_address : in std_logic_vector(7 downto 0);
+        AS_write : in std_logic;
+        AS_read : in std_logic;
+        AS_readdata : out std_logic_vector(31 downto 0);
+
+        -- Camera clock domain
+        pix_clk : in std_logic;
+        pix_frame_valid : in std_logic;
+        pix_fifo_write : in std_logic;
+        -- The acquisition discards the current frame, held until the next one
+        pix_drop : in std_logic;
+
+        -- DMA Interface
+        dma_frame_done : in std_logic
+    );
+end timestamp;
+
+architecture arch of timestamp is
+    -- Register map (byte addresses within the block)
+    -- Reading COUNT_LO latches the high word returned by COUNT_HI
+    constant REG_COUNT_LO : std_logic_vector(7 downto 0) := x"00";
+    constant REG_COUNT_HI : std_logic_vector(7 downto 0) := x"04";
+    -- Records held, a write to POP drops the oldest one
+    constant REG_LEVEL    : std_logic_vector(7 downto 0) := x"08";
+    constant REG_POP      : std_logic_vector(7 downto 0) := x"0C";
+    -- Oldest record
+    constant REG_SEQ      : std_logic_vector(7 downto 0) := x"10";
+    constant REG_START_LO : std_logic_vector(7 downto 0) := x"14";
+    constant REG_START_HI : std_logic_vector(7 downto 0) := x"18";
+    constant REG_LAST_LO  : std_logic_vector(7 downto 0) := x"1C";
+    constant REG_LAST_HI  : std_logic_vector(7 downto 0) := x"20";
+    constant REG_DONE_LO  : std_logic_vector(7 downto 0) := x"24";
+    constant REG_DONE_HI  : std_logic_vector(7 downto 0) := x"28";
+
+    constant DEPTH : natural := 8;
+
+    type stamp_t is array (0 to DEPTH - 1) of unsigned(63 downto 0);
+    type seq_t is array (0 to DEPTH - 1) of unsigned(31 downto 0);
+
+    signal count_reg : unsigned(63 downto 0);
+    signal count_hi_reg : unsigned(31 downto 0);
+
+    -- Camera clock side, one toggle per event
+    signal pix_frame_valid_prev : std_logic;
+    signal pix_written : std_logic;
+    signal pix_start_toggle : std_logic;
+    signal pix_last_toggle : std_logic;
+
+    signal start_sync : std_logic_vector(2 downto 0);
+    signal last_sync : std_logic_vector(2 downto 0);
+    signal drop_sync : std_logic_vector(2 downto 0);
+    -- A frame started after the pending end, a drop then belongs to it
+    signal started_reg : std_logic;
+
+    -- Record being assembled, pushed once both the frame end and the DMA
+    -- commit were seen, whichever comes first
+    signal start_reg : unsigned(63 downto 0);
+    signal pend_start : unsigned(63 downto 0);
+    signal pend_last : unsigned(63 downto 0);
+    signal pend_done : unsigned(63 downto 0);
+    signal last_seen : std_logic;
+    signal done_seen : std_logic;
+    signal seq_reg : unsigned(31 downto 0);
+
+    signal fifo_start, fifo_last, fifo_done : stamp_t;
+    signal fifo_seq : seq_t;
+    signal rd_idx, wr_idx : natural range 0 to DEPTH - 1;
+    signal level : natural range 0 to DEPTH;
+begin
+    process(pix_clk, nReset)
+    begin
+        if nReset = '0' then
+            pix_frame_valid_prev <= '0';
+            pix_written <= '0';
+            pix_start_toggle <= '0';
+            pix_last_toggle <= '0';
+        elsif rising_edge(pix_clk) then
+            pix_frame_valid_prev <= pix_frame_valid;
+
+            if pix_frame_valid = '1' and pix_frame_valid_prev = '0' then
+                pix_start_toggle <= not pix_start_toggle;
+                pix_written <= '0';
+            elsif pix_frame_valid = '0' and pix_frame_valid_prev = '1' then
+                if pix_written = '1' or pix_fifo_write = '1' then
+                    pix_last_toggle <= not pix_last_toggle;
+                end if;
+                pix_written <= '0';
+            elsif pix_fifo_write = '1' then
+                pix_written <= '1';
+            end if;
+        end if;
+    end process;
+
+    process(clk, nReset)
+        variable push : boolean;
+        variable pop : boolean;
+        variable store : boolean;
+    begin
+        if nReset = '0' then
+            count_reg <= (others => '0');
+            count_hi_reg <= (others => '0');
+            start_sync <= (others => '0');
+            last_sync <= (others => '0');
+            drop_sync <= (others => '0');
+            started_reg <= '0';
+            start_reg <= (others => '0');
+            pend_start <= (others => '0');
+            pend_last <= (others => '0');
+            pend_done <= (others => '0');
+            last_seen <= '0';
+            done_seen <= '0';
+            seq_reg <= (others => '0');
+            fifo_start <= (others => (others => '0'));
+            fifo_last <= (others => (others => '0'));
+            fifo_done <= (others => (others => '0'));
+            fifo_seq <= (others => (others => '0'));
+            rd_idx <= 0;
+            wr_idx <= 0;
+            level <= 0;
+            AS_readdata <= (others => '0');
+        elsif rising_edge(clk) then
+            count_reg <= count_reg + 1;
+
+            start_sync <= start_sync(1 downto 0) & pix_start_toggle;
+            last_sync <= last_sync(1 downto 0) & pix_last_toggle;
+            drop_sync <= drop_sync(1 downto 0) & pix_drop;
+
+            push := (last_seen = '1') and (done_seen = '1');
+            pop := (AS_write = '1') and (AS_address = REG_POP) and (level /= 0);
+            store := push and (level /= DEPTH or pop);
+
+            if push then
+                seq_reg <= seq_reg + 1;
+                last_seen <= '0';
+                done_seen <= '0';
+            end if;
+            if store then
+                fifo_start(wr_idx) <= pend_start;
+                fifo_last(wr_idx) <= pend_last;
+                fifo_done(wr_idx) <= pend_done;
+                fifo_seq(wr_idx) <= seq_reg;
+                if wr_idx = DEPTH - 1 then
+                    wr_idx <= 0;
+                else
+                    wr_idx <= wr_idx + 1;
+                end if;
+            end if;
+
+            -- Events after the push so one arriving with it is kept
+            if start_sync(2) /= start_sync(1) then
+                start_reg <= count_reg;
+                started_reg <= '1';
+            end if;
+            -- A frame ending without a commit was dropped, the next one replaces it
+            if last_sync(2) /= last_sync(1) and drop_sync(1) = '0' then
+                pend_start <= start_reg;
+                pend_last <= count_reg;
+                last_seen <= '1';
+                started_reg <= '0';
+            end if;
+            -- The tail of the pending frame overflowed after its end
+            if drop_sync(1) = '1' and drop_sync(2) = '0' and started_reg = '0' then
+                last_seen <= '0';
+            end if;
+            if dma_frame_done = '1' then
+                pend_done <= count_reg;
+                done_seen <= '1';
+            end if;
+
+            if pop then
+                if rd_idx = DEPTH - 1 then
+                    rd_idx <= 0;
+                else
+                    rd_idx <= rd_idx + 1;
+                end if;
+            end if;
+            if store and not pop then
+                level <= level + 1;
+            elsif pop and not store then
+                level <= level - 1;
+            end if;
+
+            --Avalon slave read from registers.
+            if AS_read = '1' then
+                AS_readdata <= (others => '0');
+                case AS_address is
+                    when REG_COUNT_LO =>
+                        AS_readdata <= std_logic_vector(count_reg(31 downto 0));
+                        count_hi_reg <= count_reg(63 downto 32);
+                    when REG_COUNT_HI =>
+                        AS_readdata <= std_logic_vector(count_hi_reg);
+                    when REG_LEVEL =>
+                        AS_readdata <= std_logic_vector(to_unsigned(level, 32));
+                    when REG_SEQ =>
+                        AS_readdata <= std_logic_vector(fifo_seq(rd_idx));
+                    when REG_START_LO =>
+                        AS_readdata <= std_logic_vector(fifo_start(rd_idx)(31 downto 0));
+                    when REG_START_HI =>
+                        AS_readdata <= std_logic_vector(fifo_start(rd_idx)(63 downto 32));
+                    when REG_LAST_LO =>
+                        AS_readdata <= std_logic_vector(fifo_last(rd_idx)(31 downto 0));
+                    when REG_LAST_HI =>
+                        AS_readdata <= std_logic_vector(fifo_last(rd_idx)(63 downto 32));
+                    when REG_DONE_LO =>
+                        AS_readdata <= std_logic_vector(fifo_done(rd_idx)(31 downto 0));
+                    when REG_DONE_HI =>
+                        AS_readdata <= std_logic_vector(fifo_done(rd_idx)(63 downto 32));
+                    when others =>
+                        null;
+                end case;
+            end if;
+        end if;
+    end process;
+end arch;
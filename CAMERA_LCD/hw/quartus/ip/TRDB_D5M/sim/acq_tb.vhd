@@ -25,6 +25,15 @@ architecture rtl of acq_tb is
 --============================================================================
 constant clock_period : time := 20 ns;
 
+-- Sensor frame and the window captured from it
+constant frame_width : natural := 16;
+constant frame_height : natural := 8;
+constant roi_x : natural := 4;
+constant roi_y : natural := 2;
+constant roi_width : natural := 8;
+constant roi_height : natural := 4;
+constant roi_pixels : natural := roi_width*roi_height;
+
 signal clk    : std_logic := '0';
 signal rst_n  : std_logic := '1';
 
@@ -32,15 +41,34 @@ signal rst_n  : std_logic := '1';
 signal camera_frame_valid : std_logic := '0';
 signal camera_line_valid  : std_logic := '0';
 signal camera_pixel_data  : std_logic_vector(11 downto 0) := (others => '0');
+signal camera_trigger : std_logic;
 
     -- Debayerization Interface
 signal deb_row_even : std_logic;
 signal deb_valid    : std_logic;
 signal deb_pixel_data : std_logic_vector(11 downto 0);
+signal deb_resync   : std_logic;
+
+    -- end_fifo Interface
+signal end_overflow : std_logic := '0';
+signal end_drop     : std_logic;
 
     -- Global Controller Interface
 signal glob_start : std_logic := '0';
+signal glob_start_done : std_logic;
 signal glob_busy  : std_logic;
+signal glob_continuous : std_logic := '0';
+signal glob_video : std_logic := '0';
+signal glob_width  : std_logic_vector(11 downto 0) := std_logic_vector(to_unsigned(roi_width, 12));
+signal glob_height : std_logic_vector(11 downto 0) := std_logic_vector(to_unsigned(roi_height, 12));
+signal glob_roi_x  : std_logic_vector(11 downto 0) := std_logic_vector(to_unsigned(roi_x, 12));
+signal glob_roi_y  : std_logic_vector(11 downto 0) := std_logic_vector(to_unsigned(roi_y, 12));
+
+signal sys_soft_rst : std_logic;
+
+-- Pixels passed to debay, and those outside the window
+signal deb_count : natural := 0;
+signal deb_errors : natural := 0;
 --============================================================================
 -- COMPONENT DECLARATIONS
 --============================================================================
@@ -56,15 +84,31 @@ component acq is
     camera_frame_valid : in std_logic;
     camera_line_valid  : in std_logic;
     camera_pixel_data  : in std_logic_vector(11 downto 0);
+    camera_trigger : out std_logic;
 
     -- Debayerization Interface
     deb_row_even : out std_logic;
     deb_valid    : out std_logic;
     deb_pixel_data: out std_logic_vector(11 downto 0);
+    deb_resync   : out std_logic;
+
+    -- end_fifo Interface
+    end_overflow : in std_logic;
+    end_drop     : out std_logic;
 
     -- Global Controller Interface
     glob_start :  in std_logic;
-    glob_busy  : out std_logic
+    glob_start_done : out std_logic;
+    glob_busy  : out std_logic;
+    glob_continuous : in std_logic;
+    glob_video : in std_logic;
+    glob_width  : in std_logic_vector(11 downto 0);
+    glob_height : in std_logic_vector(11 downto 0);
+    glob_roi_x  : in std_logic_vector(11 downto 0);
+    glob_roi_y  : in std_logic_vector(11 downto 0);
+
+    -- System Soft Reset
+    sys_soft_rst : out std_logic
 );
 end component;
 
@@ -87,15 +131,30 @@ dut: acq
         camera_frame_valid  => camera_frame_valid,
         camera_line_valid   => camera_line_valid,
         camera_pixel_data   => camera_pixel_data,
+        camera_trigger      => camera_trigger,
 
     -- Debayerization Interface
         deb_row_even    => deb_row_even,
         deb_valid       => deb_valid,
         deb_pixel_data  => deb_pixel_data,
+        deb_resync      => deb_resync,
+
+    -- end_fifo Interface
+        end_overflow    => end_overflow,
+        end_drop        => end_drop,
 
     -- Global Controller Interface
-        glob_start  => glob_start,
-        glob_busy   => glob_busy
+        glob_start      => glob_start,
+        glob_start_done => glob_start_done,
+        glob_busy       => glob_busy,
+        glob_continuous => glob_continuous,
+        glob_video      => glob_video,
+        glob_width      => glob_width,
+        glob_height     => glob_height,
+        glob_roi_x      => glob_roi_x,
+        glob_roi_y      => glob_roi_y,
+
+        sys_soft_rst    => sys_soft_rst
     );
 
 --============================================================================
@@ -115,7 +174,34 @@ end process;
 --! The test described in the header is executed in this process.
 --============================================================================
 p_stim: process
-    variable cnt : unsigned(11 downto 0) := (others => '0') ;
+    -- Pixel data is the position in the sensor frame, row * frame_width + column
+    procedure send_frame is
+    begin
+        camera_frame_valid <= '1';
+        wait for clock_period;
+        for J in 0 to frame_height-1 loop
+            for I in 0 to frame_width-1 loop
+                camera_line_valid <= '1';
+                camera_pixel_data <= std_logic_vector(to_unsigned(J*frame_width + I, 12));
+                wait for clock_period;
+            end loop;
+            camera_line_valid <= '0';
+            wait for 2*clock_period;
+        end loop;
+        camera_frame_valid <= '0';
+        wait for 4*clock_period;
+    end procedure;
+
+    -- Held until the acquisition leaves idle, as the global controller does
+    procedure start_capture is
+    begin
+        glob_start <= '1';
+        wait until glob_start_done = '1';
+        wait for clock_period;
+        glob_start <= '0';
+    end procedure;
+
+    variable count_before : natural;
 begin
 
 ------------------------------------------------------------------------------
@@ -123,7 +209,7 @@ begin
 ------------------------------------------------------------------------------
     glob_start <= '0';
     camera_line_valid <= '0';
-    camera_frame_valid <= '1';
+    camera_frame_valid <= '0';
     camera_pixel_data <= (others => '0');
 
     wait for clock_period/2;
@@ -134,48 +220,73 @@ begin
     wait for clock_period/2;
 
     wait for 3*clock_period;
-    glob_start <= '1';
-    wait for clock_period;
-    glob_start <= '0';
-
-    wait for 2*clock_period;
-    camera_frame_valid <= '0';
 
-    wait for clock_period;
+    -- Snapshot: the trigger starts the frame, only the window is passed on
+    start_capture;
+    assert camera_trigger = '0'
+        report "Trigger not asserted while waiting for a snapshot" severity error;
+    send_frame;
+    assert deb_count = roi_pixels
+        report "Unexpected number of pixels in the window" severity error;
+    assert glob_busy = '0'
+        report "Still busy after a snapshot" severity error;
+
+    -- Continuous: re-armed after each frame until the mode is cleared
+    glob_continuous <= '1';
+    count_before := deb_count;
+    start_capture;
+    send_frame;
+    send_frame;
+    assert deb_count = count_before + 2*roi_pixels
+        report "Frames missed in continuous mode" severity error;
+    assert glob_busy = '1'
+        report "Not re-armed in continuous mode" severity error;
+    glob_continuous <= '0';
+    wait for 5*clock_period;
+    assert glob_busy = '0'
+        report "Not stopped once continuous mode is cleared" severity error;
+
+    -- Video: armed in the middle of a frame, which is skipped, without trigger
+    glob_video <= '1';
+    count_before := deb_count;
     camera_frame_valid <= '1';
-
     wait for clock_period;
-
-    for I in 0 to 639 loop
+    start_capture;
+    assert camera_trigger = '1'
+        report "Trigger asserted in video mode" severity error;
+    for I in 0 to frame_width-1 loop
         camera_line_valid <= '1';
-        camera_pixel_data <= std_logic_vector(cnt);
-        cnt := cnt + 1;
         wait for clock_period;
     end loop;
-
     camera_line_valid <= '0';
-    wait for clock_period;
-
-
-    for I in 0 to 639 loop
-        camera_line_valid <= '1';
-        camera_pixel_data <= std_logic_vector(cnt);
-        cnt := cnt + 1;
-        wait for clock_period;
-    end loop;
+    camera_frame_valid <= '0';
+    wait for 4*clock_period;
+    assert deb_count = count_before
+        report "Partial frame captured in video mode" severity error;
+    send_frame;
+    assert deb_count = count_before + roi_pixels
+        report "Frame after arming in video mode not captured" severity error;
+    glob_video <= '0';
 
-end process;
+    assert deb_errors = 0
+        report "Pixel outside the window passed on" severity error;
 
-CLOCK: process
-begin
-    wait for clock_period/2;
-    clk <= not clk;
+    std.env.finish;
 end process;
 
-P_END: process
+p_count: process(clk)
+    variable column, row : natural;
 begin
-    wait for 1500*clock_period;
-    std.env.finish;
+    if rising_edge(clk) then
+        if deb_valid = '1' then
+            deb_count <= deb_count + 1;
+            column := to_integer(unsigned(deb_pixel_data)) mod frame_width;
+            row := to_integer(unsigned(deb_pixel_data)) / frame_width;
+            if column < roi_x or column >= roi_x + roi_width or row < roi_y or row >= roi_y + roi_height then
+                deb_errors <= deb_errors + 1;
+            end if;
+        end if;
+    end if;
 end process;
 
 end rtl;
@@ -1,6 +1,13 @@
 --============================================================================
---! @file acq_tb.vhdl
+--! @file dma_tb.vhdl
 --============================================================================
+--! Throughput of the DMA master: a full FIFO is drained into a slave stalling
+--! the bus with a waitrequest duty cycle of 0, 25, 50 and 75 %, for several
+--! burst lengths. Bytes per clock are reported for each run. The stream
+--! source is then run against the same backpressure. A last run writes the
+--! frame as lines placed a stride apart and checks each burst address, and
+--! one more drops the frame length while the first beat of a burst is held
+--! by waitrequest: the burstcount must not change.
 --! Standard library
 library ieee;
 library std;
@@ -20,22 +27,40 @@ end dma_tb;
 --============================================================================
 architecture rtl of dma_tb is
 
-constant frame_length : integer := 80;
-constant burst_count  : integer := 10;
-constant burst_bitwidth:integer := 4;
+constant frame_length : integer := 4096;
+constant burst_count  : integer := 128;
+constant burst_bitwidth:integer := 8;
 
 constant clock_period : time := 20 ns;
 
+-- Strided run, lines are not a multiple of the burst length
+constant line_words   : integer := 100;
+constant stride_bytes : integer := 1024;
+
+type burst_list_t is array (natural range <>) of natural;
+constant burst_list : burst_list_t := (8, 32, 64, 128);
+
 signal clk    : std_logic := '0';
 signal rst_n  : std_logic := '1';
 
 -- end_fifo Interface
 signal fifo_RGB2_pixel  : std_logic_vector(31 downto 0);
-signal fifo_almost_full : std_logic;
+signal fifo_usedw       : std_logic_vector(7 downto 0);
+signal fifo_full        : std_logic;
+signal fifo_empty       : std_logic;
 signal fifo_read        : std_logic;
 
 -- Global Controller Interface
-signal glob_address : std_logic_vector(31 downto 0);
+signal glob_address        : std_logic_vector(31 downto 0);
+signal glob_frame_length   : std_logic_vector(31 downto 0);
+signal glob_frame_done     : std_logic;
+signal glob_burst_length   : std_logic_vector(7 downto 0);
+signal glob_fifo_threshold : std_logic_vector(7 downto 0);
+signal glob_line_length    : std_logic_vector(23 downto 0);
+signal glob_stride         : std_logic_vector(31 downto 0);
+signal glob_stall          : std_logic;
+signal glob_drop           : std_logic;
+signal glob_stream         : std_logic;
 
 -- Avalon Interface
 signal AM_address      : std_logic_vector(31 downto 0);
@@ -44,13 +69,26 @@ signal AM_burstCount   : std_logic_vector(burst_bitwidth - 1 downto 0);
 signal AM_write        : std_logic;
 signal AM_waitRequest  : std_logic;
 
-component DMA is
+-- Avalon-ST Source
+signal ST_data   : std_logic_vector(31 downto 0);
+signal ST_valid  : std_logic;
+signal ST_ready  : std_logic;
+signal ST_startofpacket : std_logic;
+signal ST_endofpacket   : std_logic;
+
+signal sys_soft_rst : std_logic;
+
+-- Waitrequest is raised on wait_duty cycles out of 4
+signal wait_duty  : natural range 0 to 3 := 0;
+signal wait_phase : natural range 0 to 3 := 0;
+-- Holds waitrequest regardless of the duty cycle
+signal wait_hold  : std_logic := '0';
+
+component dma is
     generic(
-        -- Unit of frame_length is in avalon transfer
         frame_length : integer := (320*240)/2;
-        -- Must divide evenly screen_width and screen_heigth
-        burst_count : integer := 10;
-        burst_bitwidth : integer := 4
+        burst_count : integer := 128;
+        burst_bitwidth : integer := 8
     );
     port(
         clk : in std_logic;
@@ -58,27 +96,49 @@ component DMA is
 
         -- end_fifo Interface
         fifo_RGB2_pixel  : in  std_logic_vector(31 downto 0);
-        fifo_almost_full : in  std_logic;
+        fifo_usedw       : in  std_logic_vector(7 downto 0);
+        fifo_full        : in  std_logic;
+        fifo_empty       : in  std_logic;
         fifo_read        : out std_logic;
 
         -- Global Controller Interface
         glob_address : in std_logic_vector(31 downto 0);
+        glob_frame_length : in std_logic_vector(31 downto 0);
+        glob_frame_done : out std_logic;
+        glob_burst_length : in std_logic_vector(7 downto 0);
+        glob_fifo_threshold : in std_logic_vector(7 downto 0);
+        glob_line_length : in std_logic_vector(23 downto 0);
+        glob_stride : in std_logic_vector(31 downto 0);
+        glob_stall : out std_logic;
+        glob_drop : in std_logic;
+        glob_stream : in std_logic;
 
         -- Avalon Interface
         AM_address      : out std_logic_vector(31 downto 0);
         AM_dataWrite    : out std_logic_vector(31 downto 0);
         AM_burstCount   : out std_logic_vector(burst_bitwidth - 1 downto 0);
         AM_write        : out std_logic;
-        AM_waitRequest  : in  std_logic
+        AM_waitRequest  : in  std_logic;
+
+        -- Avalon-ST Source
+        ST_data          : out std_logic_vector(31 downto 0);
+        ST_valid         : out std_logic;
+        ST_ready         : in  std_logic;
+        ST_startofpacket : out std_logic;
+        ST_endofpacket   : out std_logic;
+
+        -- System soft reset
+        sys_soft_rst : in std_logic
 );
 end component;
 
 begin
 
-dut: DMA
+dut: dma
     generic map(
         frame_length => frame_length,
-        burst_count => burst_count
+        burst_count => burst_count,
+        burst_bitwidth => burst_bitwidth
     )
     port map (
         clk => clk,
@@ -86,18 +146,38 @@ dut: DMA
 
         -- end_fifo Interface
         fifo_RGB2_pixel  => fifo_RGB2_pixel,
-        fifo_almost_full => fifo_almost_full,
+        fifo_usedw       => fifo_usedw,
+        fifo_full        => fifo_full,
+        fifo_empty       => fifo_empty,
         fifo_read        => fifo_read,
 
         -- Global Controller Interface
-        glob_address => glob_address,
+        glob_address        => glob_address,
+        glob_frame_length   => glob_frame_length,
+        glob_frame_done     => glob_frame_done,
+        glob_burst_length   => glob_burst_length,
+        glob_fifo_threshold => glob_fifo_threshold,
+        glob_line_length    => glob_line_length,
+        glob_stride         => glob_stride,
+        glob_stall          => glob_stall,
+        glob_drop           => glob_drop,
+        glob_stream         => glob_stream,
 
         -- Avalon Interface
         AM_address      => AM_address,
         AM_dataWrite    => AM_dataWrite,
         AM_burstCount   => AM_burstCount,
         AM_write        => AM_write,
-        AM_waitRequest  => AM_waitRequest
+        AM_waitRequest  => AM_waitRequest,
+
+        -- Avalon-ST Source
+        ST_data          => ST_data,
+        ST_valid         => ST_valid,
+        ST_ready         => ST_ready,
+        ST_startofpacket => ST_startofpacket,
+        ST_endofpacket   => ST_endofpacket,
+
+        sys_soft_rst => sys_soft_rst
 );
 
 p_clock :process
@@ -108,49 +188,190 @@ p_clock :process
     wait for clock_period/2;
 end process;
 
+-- The FIFO always holds enough data, the slave is the only bottleneck
+fifo_usedw <= x"FF";
+fifo_full <= '0';
+glob_drop <= '0';
+fifo_empty <= '0';
+fifo_RGB2_pixel <= x"12345678";
+
+p_wait: process(clk)
+begin
+    if rising_edge(clk) then
+        wait_phase <= (wait_phase + 1) mod 4;
+    end if;
+end process;
+
+AM_waitRequest <= '1' when (wait_phase < wait_duty) or (wait_hold = '1') else
+                  '0';
+ST_ready <= not AM_waitRequest;
+
 p_stim: process
-    variable cnt : unsigned(31 downto 0) := (others => '0') ;
+    variable cycles : natural;
+    variable beats  : natural;
+    variable rate   : natural;
+    variable burst_left : natural;
+    variable expected   : natural;
+    variable held_len   : natural;
 begin
 
 ------------------------------------------------------------------------------
 -- Test-setup
 ------------------------------------------------------------------------------
-    cnt := cnt + 1;
-    glob_address <= (others => '0');
-    fifo_almost_full <= '0';
-    fifo_RGB2_pixel <= std_logic_vector(cnt);
-    AM_waitRequest <= '0';
+    glob_address <= x"00001000";
+    glob_frame_length <= std_logic_vector(to_unsigned(frame_length, 32));
+    glob_burst_length <= (others => '0');
+    glob_fifo_threshold <= (others => '0');
+    glob_line_length <= (others => '0');
+    glob_stride <= (others => '0');
+    glob_stream <= '0';
+    sys_soft_rst <= '0';
 
     wait for clock_period;
     rst_n <= '0';
     wait for clock_period;
     rst_n <= '1';
 
-    wait for 3*clock_period;
-    glob_address <= x"AAAAAAAA";
-
-    wait for 3*clock_period;
-
-    fifo_almost_full <= '1';
-
-    for I in 0 to frame_length/burst_count - 1 loop
-        AM_waitRequest <= '1';
-
-        wait for clock_period;
-
-        AM_waitRequest <= '0';
-
-        for J in 0 to burst_count - 1 loop
-           wait for clock_period;
-
-           if I = frame_length/burst_count - 1 then
-               fifo_almost_full <= '0';
-           end if;
-
-           cnt := cnt + 1;
-           fifo_RGB2_pixel <= std_logic_vector(cnt);
+    for I in burst_list'range loop
+        for D in 0 to 3 loop
+            wait until falling_edge(clk);
+            glob_burst_length <= std_logic_vector(to_unsigned(burst_list(I), 8));
+            wait_duty <= D;
+            sys_soft_rst <= '1';
+            wait until falling_edge(clk);
+            sys_soft_rst <= '0';
+
+            cycles := 0;
+            beats := 0;
+            loop
+                wait until rising_edge(clk);
+                cycles := cycles + 1;
+                if fifo_read = '1' then
+                    beats := beats + 1;
+                end if;
+                exit when glob_frame_done = '1';
+            end loop;
+
+            assert beats = frame_length
+                report "burst " & integer'image(burst_list(I)) & ": " &
+                       integer'image(beats) & " beats for " &
+                       integer'image(frame_length) & " words"
+                severity error;
+
+            -- Hundredths of a byte per clock
+            rate := (beats * 4 * 100) / cycles;
+            report "burst " & integer'image(burst_list(I)) &
+                   ", waitrequest " & integer'image(D * 25) & " %: " &
+                   integer'image(rate / 100) & "." &
+                   integer'image((rate mod 100) / 10) & integer'image(rate mod 10) &
+                   " bytes/clk (" & integer'image(cycles) & " cycles)";
+        end loop;
+    end loop;
 
+    -- Lines of line_words words, stride bytes apart, bursts split at line ends
+    wait until falling_edge(clk);
+    glob_burst_length <= std_logic_vector(to_unsigned(32, 8));
+    glob_line_length <= std_logic_vector(to_unsigned(line_words, 24));
+    glob_stride <= std_logic_vector(to_unsigned(stride_bytes, 32));
+    wait_duty <= 1;
+    sys_soft_rst <= '1';
+    wait until falling_edge(clk);
+    sys_soft_rst <= '0';
+
+    beats := 0;
+    burst_left := 0;
+    loop
+        wait until rising_edge(clk);
+        if fifo_read = '1' then
+            if burst_left = 0 then
+                expected := 16#1000# + (beats / line_words) * stride_bytes + (beats mod line_words) * 4;
+                assert to_integer(unsigned(AM_address)) = expected
+                    report "line " & integer'image(beats / line_words) &
+                           ": burst at " & integer'image(to_integer(unsigned(AM_address))) &
+                           " instead of " & integer'image(expected)
+                    severity error;
+                assert (beats mod line_words) + to_integer(unsigned(AM_burstCount)) <= line_words
+                    report "burst crosses a line end" severity error;
+                burst_left := to_integer(unsigned(AM_burstCount));
+            end if;
+            burst_left := burst_left - 1;
+            beats := beats + 1;
+        end if;
+        exit when glob_frame_done = '1';
+    end loop;
+    assert beats = frame_length
+        report "strided frame: " & integer'image(beats) & " beats" severity error;
+    glob_line_length <= (others => '0');
+    glob_stride <= (others => '0');
+
+    -- The short length of a compressed frame arrives while the first beat is
+    -- held, the burst keeps its burstcount and closes the frame
+    wait until falling_edge(clk);
+    wait_duty <= 0;
+    wait_hold <= '1';
+    sys_soft_rst <= '1';
+    wait until falling_edge(clk);
+    sys_soft_rst <= '0';
+    wait until rising_edge(clk) and AM_write = '1';
+    held_len := to_integer(unsigned(AM_burstCount));
+    wait until falling_edge(clk);
+    glob_frame_length <= std_logic_vector(to_unsigned(5, 32));
+    for I in 1 to 4 loop
+        wait until rising_edge(clk);
+        assert AM_write = '1' and to_integer(unsigned(AM_burstCount)) = held_len
+            report "held burst: burstcount " & integer'image(to_integer(unsigned(AM_burstCount))) &
+                   " instead of " & integer'image(held_len)
+            severity error;
+    end loop;
+    wait until falling_edge(clk);
+    wait_hold <= '0';
+
+    beats := 0;
+    loop
+        wait until rising_edge(clk);
+        if fifo_read = '1' then
+            beats := beats + 1;
+        end if;
+        exit when glob_frame_done = '1';
+    end loop;
+    assert beats = held_len
+        report "held burst: " & integer'image(beats) & " beats for a burstcount of " &
+               integer'image(held_len)
+        severity error;
+    glob_frame_length <= std_logic_vector(to_unsigned(frame_length, 32));
+
+    -- Stream source, nothing may reach the Avalon master
+    glob_stream <= '1';
+    for D in 0 to 3 loop
+        wait until falling_edge(clk);
+        wait_duty <= D;
+        sys_soft_rst <= '1';
+        wait until falling_edge(clk);
+        sys_soft_rst <= '0';
+
+        cycles := 0;
+        beats := 0;
+        loop
+            wait until rising_edge(clk);
+            cycles := cycles + 1;
+            if fifo_read = '1' then
+                assert (ST_startofpacket = '1') = (beats = 0)
+                    report "stream: start of packet on beat " & integer'image(beats) severity error;
+                assert (ST_endofpacket = '1') = (beats = frame_length - 1)
+                    report "stream: end of packet on beat " & integer'image(beats) severity error;
+                beats := beats + 1;
+            end if;
+            assert AM_write = '0'
+                report "Avalon write in stream mode" severity error;
+            exit when glob_frame_done = '1';
         end loop;
+
+        assert beats = frame_length
+            report "stream: " & integer'image(beats) & " beats for " &
+                   integer'image(frame_length) & " words"
+            severity error;
+        report "stream, ready " & integer'image(100 - D * 25) & " %: " &
+               integer'image(cycles) & " cycles";
     end loop;
 
     wait for 10*clock_period;
@@ -159,10 +380,4 @@ begin
 
 end process;
 
-CLOCK: process
-begin
-    wait for clock_period/2;
-    clk <= not clk;
-end process;
-
 end rtl;
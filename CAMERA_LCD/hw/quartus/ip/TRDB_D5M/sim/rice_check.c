@@ -0,0 +1,83 @@
+/*
+ * rice_check.c
+ *
+ * Round trip of CAMERA_FORMAT_RICE: camera_module_tb writes the same frame in
+ * RGB565 ("p" lines) and compressed ("c" lines) to rice_frame.txt, this
+ * decodes the compressed words with trdb_d5m_rice_decode() and compares them
+ * with the RGB565 ones. Built on the host from the application directory:
+ *
+ *   gcc -I<app> -o rice_check rice_check.c <app>/trdb_d5m_rice.c
+ *   ./rice_check rice_frame.txt
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trdb_d5m.h"
+
+#define RICE_CHECK_WORDS 65536
+
+static uint32_t raw[RICE_CHECK_WORDS];
+static uint32_t packed[RICE_CHECK_WORDS];
+static uint16_t decoded[2 * RICE_CHECK_WORDS];
+
+int main(int argc, char **argv){
+	FILE *file;
+	char kind;
+	unsigned int value;
+	uint32_t k = 0;
+	uint32_t raw_words = 0;
+	uint32_t packed_words = 0;
+	uint32_t errors = 0;
+	int32_t used;
+
+	if (argc != 2 || !(file = fopen(argv[1], "r"))) {
+		fprintf(stderr, "usage: %s rice_frame.txt\n", argv[0]);
+		return 2;
+	}
+
+	while (fscanf(file, " %c %x", &kind, &value) == 2) {
+		if (kind == 'k') {
+			k = value;
+		} else if (kind == 'p' && raw_words < RICE_CHECK_WORDS) {
+			raw[raw_words++] = value;
+		} else if (kind == 'c' && packed_words < RICE_CHECK_WORDS) {
+			packed[packed_words++] = value;
+		}
+	}
+	fclose(file);
+
+	if (raw_words == 0 || packed_words == 0) {
+		fprintf(stderr, "rice_check: no frame in %s\n", argv[1]);
+		return 2;
+	}
+
+	// Two pixels per RGB565 word, the first one in the low half
+	used = trdb_d5m_rice_decode(packed, packed_words, decoded, 2 * raw_words, k);
+	if (used < 0) {
+		printf("rice_check: compressed frame ends before the last pixel\n");
+		return 1;
+	}
+	if ((uint32_t)used != packed_words) {
+		printf("rice_check: %ld words decoded, %lu written\n", (long)used, (unsigned long)packed_words);
+		errors++;
+	}
+
+	for (uint32_t i = 0; i < raw_words; i++) {
+		uint16_t low = raw[i] & 0xFFFF;
+		uint16_t high = raw[i] >> 16;
+
+		if (decoded[2 * i] != low || decoded[2 * i + 1] != high) {
+			if (errors < 10) {
+				printf("rice_check: word %lu is %04X%04X, decoded %04X%04X\n", (unsigned long)i,
+						high, low, decoded[2 * i + 1], decoded[2 * i]);
+			}
+			errors++;
+		}
+	}
+
+	printf("rice_check: %lu pixels, %lu -> %lu words, %lu errors\n", (unsigned long)(2 * raw_words),
+			(unsigned long)raw_words, (unsigned long)packed_words, (unsigned long)errors);
+	return errors ? 1 : 0;
+}
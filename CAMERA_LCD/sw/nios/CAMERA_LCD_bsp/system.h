@@ -215,11 +215,11 @@
  */
 
 #define ALT_MODULE_CLASS_camera_module_0 camera_module
-#define CAMERA_MODULE_0_BASE 0x10000810
-#define CAMERA_MODULE_0_IRQ -1
-#define CAMERA_MODULE_0_IRQ_INTERRUPT_CONTROLLER_ID -1
+#define CAMERA_MODULE_0_BASE 0x10001000
+#define CAMERA_MODULE_0_IRQ 2
+#define CAMERA_MODULE_0_IRQ_INTERRUPT_CONTROLLER_ID 0
 #define CAMERA_MODULE_0_NAME "/dev/camera_module_0"
-#define CAMERA_MODULE_0_SPAN 16
+#define CAMERA_MODULE_0_SPAN 2048
 #define CAMERA_MODULE_0_TYPE "camera_module"
 
 
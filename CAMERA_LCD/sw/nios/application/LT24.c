@@ -27,6 +27,8 @@
 #define AM_CTL_GO 		0x00000001
 #define AM_CTL_STOP		0x00000002
 #define AM_CTL_PAUSE 	0x00000004
+#define AM_CTL_STREAM 	0x00000008 // FIFO fed by the camera stream instead of the AM
+#define AM_CTL_TRIG 	0x00000010 // AM started by the camera on each completed frame
 #define AM_STAT_BUSY 	0x00000002
 #define ALLZERO32 		0x00000000
 
@@ -108,3 +110,23 @@ void lcd_read(alt_u32 address, alt_u32 read_len, alt_32 burst_len) {
 	  LT24_WR_REG(ADD_CONTROL, AM_CTL_GO);
 	  LT24_WR_REG(ADD_CONTROL, ALLZERO32); // de-assert GO
 }
+
+/*
+ * Feed the LCD from the camera preview stream instead of reading frames from
+ * memory. The stream issues its own memory write command at the start of
+ * every frame, so this can be enabled while the camera is running.
+ */
+void lcd_stream(alt_u8 enable) {
+	lcd_wait();
+	LT24_WR_REG(ADD_CONTROL, enable ? AM_CTL_STREAM : ALLZERO32);
+}
+
+/*
+ * Let the camera start the AM on every frame it completes, at the address of
+ * that frame. read_len and burst_len are used for every triggered read.
+ */
+void lcd_trigger(alt_u32 read_len, alt_32 burst_len, alt_u8 enable) {
+	LT24_WR_REG(ADD_LENGTH, read_len);
+	LT24_WR_REG(ADD_BURSTCOUNT, burst_len);
+	LT24_WR_REG(ADD_CONTROL, enable ? AM_CTL_TRIG : ALLZERO32);
+}
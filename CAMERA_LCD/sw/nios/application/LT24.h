@@ -26,5 +26,7 @@ void lcd_read(alt_u32 address, alt_u32 read_len, alt_32 burst_len);
 void Delay_Ms(alt_u16);
 void lcd_reset();
 void lcd_wait();
+void lcd_stream(alt_u8 enable);
+void lcd_trigger(alt_u32 read_len, alt_32 burst_len, alt_u8 enable);
 
 #endif /* LT24_H_ */
@@ -10,29 +10,59 @@
 #include "LT24.h"
 
 #define FRAME_SPAN 153600
-int main(void) {
+#define FRAME_BUFFERS 3
+// How frames reach the LCD
+#define DISPLAY_QUEUE 0		// dequeued and displayed by the CPU
+#define DISPLAY_HANDOFF 1	// the camera starts the display of each frame it completes
+#define DISPLAY_PREVIEW 2	// streamed straight to the LCD, not stored
+#define DISPLAY_PATH DISPLAY_QUEUE
 
+int main(void) {
+	uint32_t buffers[FRAME_BUFFERS];
+	static trdb_d5m_queue queue;
 
-	trdb_d5m_init();
+	trdb_d5m_init(false);
 	lcd_on();
 	lcd_init();
 
+	for (int i = 0; i < FRAME_BUFFERS; i++) {
+		buffers[i] = HPS_0_BRIDGES_BASE + i*FRAME_SPAN;
+	}
+	trdb_d5m_ring_setup(buffers, FRAME_BUFFERS, FRAME_SPAN);
+	trdb_d5m_set_video_mode(true);
+	trdb_d5m_irq_init(NULL, NULL);
+
 	printf("End of configuration\n");
 
-	trdb_d5m_start_acq(HPS_0_BRIDGES_BASE);
-	trdb_d5m_wait_end();
-	printf("Done\n");
+	if (DISPLAY_PATH == DISPLAY_PREVIEW && trdb_d5m_set_preview(true)) {
+		lcd_stream(1);
+		trdb_d5m_start_stream();
+		while(1){
+			trdb_d5m_wait_frame();
+		}
+	}
+
+	if (DISPLAY_PATH == DISPLAY_HANDOFF) {
+		lcd_trigger(FRAME_SPAN/4, 10, 1);
+		trdb_d5m_set_handoff(true);
+		trdb_d5m_start_stream();
+		while(1){
+			trdb_d5m_wait_frame();
+		}
+	}
+
+	// The camera fills the next buffers while a completed one is displayed
+	trdb_d5m_queue_init(&queue, buffers, FRAME_BUFFERS, FRAME_SPAN);
+	trdb_d5m_queue_start(&queue);
 
 	while(1){
-		trdb_d5m_start_acq(HPS_0_BRIDGES_BASE+FRAME_SPAN);
-		lcd_read(HPS_0_BRIDGES_BASE, FRAME_SPAN/4, 10);
-		lcd_wait();
-		trdb_d5m_wait_end();
+		trdb_d5m_frame frame;
+
+		trdb_d5m_queue_dequeue(&queue, &frame);
 
-		trdb_d5m_start_acq(HPS_0_BRIDGES_BASE);
-		lcd_read(HPS_0_BRIDGES_BASE+FRAME_SPAN, FRAME_SPAN/4, 10);
+		lcd_read(frame.address, FRAME_SPAN/4, 10);
 		lcd_wait();
-		trdb_d5m_wait_end();
+		trdb_d5m_queue_release(&queue, &frame);
 	}
 
 
@@ -1,10 +1,13 @@
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 
 #include "i2c/i2c.h"
 #include "io.h"
 #include "system.h"
+#include "sys/alt_cache.h"
+#include "sys/alt_irq.h"
 
 #include "trdb_d5m.h"
 
@@ -12,89 +15,1165 @@
 #define TRDB_D5M_I2C_ADDRESS  (0xba)
 
 #define CAMERA_FRAME_SPAN (320*240*2)
+// Words copied from memory for each fwrite() of trdb_d5m_dump_image()
+#define TRDB_D5M_DUMP_WORDS (1024)
 
 #define RED_MASK   0b1111100000000000
 #define GREEN_MASK 0b0000011111100000
 #define BLUE_MASK  0b0000000000011111
 
+#define TRDB_D5M_REG_ROW_START    (1)
+#define TRDB_D5M_REG_COL_START    (2)
+#define TRDB_D5M_REG_ROW_SIZE     (3)
+#define TRDB_D5M_REG_COL_SIZE     (4)
+#define TRDB_D5M_REG_HBLANK       (5)
+#define TRDB_D5M_REG_VBLANK       (6)
+#define TRDB_D5M_REG_SHUTTER_HI   (8)
+#define TRDB_D5M_REG_SHUTTER_LO   (9)
+#define TRDB_D5M_REG_RESTART      (11)
+#define TRDB_D5M_REG_RESET        (13)
+#define TRDB_D5M_REG_READ_MODE    (30)
+#define TRDB_D5M_REG_ROW_ADDRESS  (34)
+#define TRDB_D5M_REG_COL_ADDRESS  (35)
+#define TRDB_D5M_SNAPSHOT         (1 << 8)
 
-bool trdb_d5m_write(i2c_dev *i2c, uint8_t register_offset, uint16_t data) {
-    uint8_t byte_data[2] = {(data >> 8) & 0xff, data & 0xff};
+// Origin of the active pixel array
+#define TRDB_D5M_ROW_START_DEFAULT (54)
+#define TRDB_D5M_COL_START_DEFAULT (16)
 
-    int success = i2c_write_array(i2c, TRDB_D5M_I2C_ADDRESS, register_offset, byte_data, sizeof(byte_data));
+// Frame timing of the sensor, see the MT9P031 datasheet
+#define TRDB_D5M_VBLANK_MIN        (8)
+#define TRDB_D5M_MODE_REGS         (11)
 
-    if (success != I2C_SUCCESS) {
+static i2c_dev i2c;
+
+#define TRDB_D5M_TABLE_SIZE(table) (sizeof(table) / sizeof((table)[0]))
+
+// Snapshot mode without test pattern, the window is set by trdb_d5m_set_mode()
+static const trdb_d5m_reg trdb_d5m_init_table[] = {
+	{160, 0},		// test pattern off
+	{161, 4095},	// test pattern green, red and blue
+	{162, 4095},
+	{163, 4095},
+	{TRDB_D5M_REG_READ_MODE, TRDB_D5M_SNAPSHOT},
+};
+
+/*
+ * Sensor readout of each TRDB_D5M_MODE_*. The window is width*skip x
+ * height*skip pixels from (row_start, col_start), skip being applied by
+ * binning so the whole window is exposed. The shutter of each mode is as long
+ * as the frame allows without slowing it down.
+ */
+typedef struct {
+	const char *name;
+	uint32_t width;			// sensor output pixels
+	uint32_t height;
+	uint32_t row_start;
+	uint32_t col_start;
+	uint32_t skip;			// 1, 2 or 4, rows and columns
+	uint32_t hblank;		// pixclk pairs, raised to the minimum of the skip
+	uint32_t vblank;		// rows
+	uint32_t shutter;		// rows
+} trdb_d5m_mode;
+
+static const trdb_d5m_mode trdb_d5m_modes[TRDB_D5M_MODES] = {
+	[TRDB_D5M_MODE_320X240] = {"320x240", 640, 480,
+		TRDB_D5M_ROW_START_DEFAULT, TRDB_D5M_COL_START_DEFAULT, 4, 0, 25, 504},
+	[TRDB_D5M_MODE_640X480] = {"640x480", 1280, 960,
+		TRDB_D5M_ROW_START_DEFAULT, TRDB_D5M_COL_START_DEFAULT, 2, 0, 25, 984},
+	// Centre of the 2592x1944 array without binning, fewer and shorter rows
+	[TRDB_D5M_MODE_CROP_320X240] = {"320x240 crop", 640, 480,
+		TRDB_D5M_ROW_START_DEFAULT + 732, TRDB_D5M_COL_START_DEFAULT + 976, 1, 0, TRDB_D5M_VBLANK_MIN, 487},
+	[TRDB_D5M_MODE_CROP_160X120] = {"160x120 crop", 320, 240,
+		TRDB_D5M_ROW_START_DEFAULT + 852, TRDB_D5M_COL_START_DEFAULT + 1136, 1, 0, TRDB_D5M_VBLANK_MIN, 247},
+};
+
+static uint32_t sensor_mode = TRDB_D5M_MODE_320X240;
+
+// Last value written to or read from each sensor register
+static uint16_t sensor_shadow[TRDB_D5M_REGS];
+static uint32_t sensor_shadow_valid[TRDB_D5M_REGS / 32];
+
+// Frame completion state shared with the interrupt handler
+static volatile uint32_t frames_pending = 0;
+static trdb_d5m_frame_cb frame_callback = NULL;
+static void *frame_callback_context = NULL;
+static trdb_d5m_queue *frame_queue = NULL;
+
+// Bytes each frame may take, 0 when unknown: ring buffers and frame span
+static uint32_t ring_buffer_size = 0;
+static uint32_t frame_span = 0;
+
+// Owner of each buffer of a frame queue
+#define QUEUE_FREE   0
+#define QUEUE_CAMERA 1
+#define QUEUE_READY  2
+#define QUEUE_HELD   3
+
+
+// Registers acting as commands, always sent and never cached
+static bool trdb_d5m_volatile(uint8_t register_offset){
+	return register_offset == TRDB_D5M_REG_RESTART || register_offset == TRDB_D5M_REG_RESET;
+}
+
+static bool trdb_d5m_shadow_hit(uint8_t register_offset, uint16_t data){
+	return (sensor_shadow_valid[register_offset / 32] & (1u << (register_offset % 32))) &&
+			sensor_shadow[register_offset] == data;
+}
+
+static void trdb_d5m_shadow_set(uint8_t register_offset, uint16_t data, bool valid){
+	if (valid && !trdb_d5m_volatile(register_offset)) {
+		sensor_shadow[register_offset] = data;
+		sensor_shadow_valid[register_offset / 32] |= 1u << (register_offset % 32);
+	} else {
+		sensor_shadow_valid[register_offset / 32] &= ~(1u << (register_offset % 32));
+	}
+}
+
+// Forget every register, the next accesses go to the sensor
+void trdb_d5m_shadow_invalidate(void){
+	for (uint32_t i = 0; i < TRDB_D5M_REGS / 32; i++) {
+		sensor_shadow_valid[i] = 0;
+	}
+}
+
+/*
+ * Write count consecutive registers from register_offset in a single I2C
+ * transfer, the sensor increments the register address after each one.
+ * Always goes to the sensor and updates the shadow.
+ */
+bool trdb_d5m_write_burst(i2c_dev *i2c, uint8_t register_offset, const uint16_t *data, uint32_t count) {
+    uint8_t byte_data[2 * TRDB_D5M_BURST_MAX];
+
+    if (count == 0 || count > TRDB_D5M_BURST_MAX) {
         return false;
-    } else {
-        return true;
     }
+
+    for (uint32_t i = 0; i < count; i++) {
+        byte_data[2 * i] = (data[i] >> 8) & 0xff;
+        byte_data[2 * i + 1] = data[i] & 0xff;
+    }
+
+    int success = i2c_write_array(i2c, TRDB_D5M_I2C_ADDRESS, register_offset, byte_data, 2 * count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        trdb_d5m_shadow_set(register_offset + i, data[i], success == I2C_SUCCESS);
+        // A reset brings every register back to its default
+        if (register_offset + i == TRDB_D5M_REG_RESET) {
+            trdb_d5m_shadow_invalidate();
+        }
+    }
+
+    return success == I2C_SUCCESS;
 }
 
-bool trdb_d5m_read(i2c_dev *i2c, uint8_t register_offset, uint16_t *data) {
-    uint8_t byte_data[2] = {0, 0};
+bool trdb_d5m_read_burst(i2c_dev *i2c, uint8_t register_offset, uint16_t *data, uint32_t count) {
+    uint8_t byte_data[2 * TRDB_D5M_BURST_MAX];
 
-    int success = i2c_read_array(i2c, TRDB_D5M_I2C_ADDRESS, register_offset, byte_data, sizeof(byte_data));
+    if (count == 0 || count > TRDB_D5M_BURST_MAX) {
+        return false;
+    }
+
+    int success = i2c_read_array(i2c, TRDB_D5M_I2C_ADDRESS, register_offset, byte_data, 2 * count);
 
     if (success != I2C_SUCCESS) {
         return false;
-    } else {
-        *data = ((uint16_t) byte_data[0] << 8) + byte_data[1];
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        data[i] = ((uint16_t) byte_data[2 * i] << 8) + byte_data[2 * i + 1];
+        trdb_d5m_shadow_set(register_offset + i, data[i], true);
+    }
+    return true;
+}
+
+// Skipped when the register already holds data
+bool trdb_d5m_write(i2c_dev *i2c, uint8_t register_offset, uint16_t data) {
+    if (trdb_d5m_shadow_hit(register_offset, data)) {
         return true;
     }
+    return trdb_d5m_write_burst(i2c, register_offset, &data, 1);
 }
 
-bool trdb_d5m_init(void){
+// Served from the shadow once the register has been written or read
+bool trdb_d5m_read(i2c_dev *i2c, uint8_t register_offset, uint16_t *data) {
+    if (sensor_shadow_valid[register_offset / 32] & (1u << (register_offset % 32))) {
+        *data = sensor_shadow[register_offset];
+        return true;
+    }
+    return trdb_d5m_read_burst(i2c, register_offset, data, 1);
+}
+
+// Number of registers from table[0] that follow each other, up to a burst
+static uint32_t trdb_d5m_table_run(const trdb_d5m_reg *table, uint32_t count){
+	uint32_t n = 1;
+
+	while (n < count && n < TRDB_D5M_BURST_MAX && table[n].reg == table[0].reg + n) {
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Program a table of sensor registers in order, sending only the ones that
+ * differ from the shadow. The changed registers of each run of consecutive
+ * ones go in a single transfer, with the unchanged ones between them, which
+ * is cheaper than starting another transfer. A command such as the restart is
+ * sent only if a register before it in the table was.
+ */
+bool trdb_d5m_write_table(const trdb_d5m_reg *table, uint32_t count){
+	uint16_t data[TRDB_D5M_BURST_MAX];
+	bool success = true;
+	bool written = false;
+
+	for (uint32_t i = 0; i < count; ) {
+		uint32_t n = trdb_d5m_table_run(&table[i], count - i);
+		int first = -1;
+		int last = -1;
+
+		for (uint32_t j = 0; j < n; j++) {
+			bool changed;
+
+			if (trdb_d5m_volatile(table[i + j].reg)) {
+				changed = written || first >= 0;
+			} else {
+				changed = !trdb_d5m_shadow_hit(table[i + j].reg, table[i + j].value);
+			}
+			if (changed) {
+				if (first < 0) {
+					first = j;
+				}
+				last = j;
+			}
+			data[j] = table[i + j].value;
+		}
+
+		if (first >= 0) {
+			success &= trdb_d5m_write_burst(&i2c, table[i + first].reg, &data[first], last - first + 1);
+			written = true;
+		}
+		i += n;
+	}
+
+	return success;
+}
+
+/*
+ * Read a table of sensor registers back from the sensor, not the shadow, and
+ * report the ones that differ. The commands clear themselves and are not
+ * checked.
+ */
+bool trdb_d5m_verify_table(const trdb_d5m_reg *table, uint32_t count){
+	uint16_t data[TRDB_D5M_BURST_MAX];
+	bool success = true;
+
+	for (uint32_t i = 0; i < count; ) {
+		uint32_t n = trdb_d5m_table_run(&table[i], count - i);
+
+		if (!trdb_d5m_read_burst(&i2c, table[i].reg, data, n)) {
+			return false;
+		}
+		for (uint32_t j = 0; j < n; j++) {
+			if (!trdb_d5m_volatile(table[i + j].reg) && data[j] != table[i + j].value) {
+				printf("Register %u: wrote %u, read %u\n", table[i + j].reg, table[i + j].value, data[j]);
+				success = false;
+			}
+		}
+		i += n;
+	}
+
+	return success;
+}
+
+// Registers of a sensor mode, the restart applying them comes last
+static uint32_t trdb_d5m_mode_table(const trdb_d5m_mode *m, trdb_d5m_reg *table){
+	uint32_t address_mode = ((m->skip - 1) << 4) | (m->skip - 1);
+	uint32_t n = 0;
+
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_ROW_START, m->row_start};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_COL_START, m->col_start};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_ROW_SIZE, m->height * m->skip - 1};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_COL_SIZE, m->width * m->skip - 1};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_HBLANK, m->hblank};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_VBLANK, m->vblank};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_SHUTTER_HI, m->shutter >> 16};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_SHUTTER_LO, m->shutter & 0xffff};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_ROW_ADDRESS, address_mode};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_COL_ADDRESS, address_mode};
+	table[n++] = (trdb_d5m_reg){TRDB_D5M_REG_RESTART, 1};
+
+	return n;
+}
+
+/*
+ * Set up the sensor from trdb_d5m_init_table in TRDB_D5M_MODE_320X240. With
+ * verify set, the registers are read back afterwards, which doubles the I2C
+ * traffic.
+ */
+bool trdb_d5m_init(bool verify){
 	printf("Setting up i2c\n");
-		i2c_dev i2c = i2c_inst((void *) I2C_0_BASE);
-	    i2c_init(&i2c, I2C_FREQ);
+	i2c = i2c_inst((void *) I2C_0_BASE);
+	i2c_init(&i2c, I2C_FREQ);
+	trdb_d5m_shadow_invalidate();
+
+	bool success = true;
+
+	printf("Setting parameters...\n");
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MODE, 0);
+	success &= trdb_d5m_write_table(trdb_d5m_init_table, TRDB_D5M_TABLE_SIZE(trdb_d5m_init_table));
+	success &= trdb_d5m_set_mode(TRDB_D5M_MODE_320X240);
+
+	if (verify) {
+		trdb_d5m_reg table[TRDB_D5M_MODE_REGS];
+
+		success &= trdb_d5m_verify_table(trdb_d5m_init_table, TRDB_D5M_TABLE_SIZE(trdb_d5m_init_table));
+		success &= trdb_d5m_verify_table(table, trdb_d5m_mode_table(&trdb_d5m_modes[sensor_mode], table));
+	}
+
+	return success;
+}
+
+/*
+ * Frames per second of a mode, in hundredths, from the row time and the rows
+ * of a frame given by the MT9P031 datasheet for a pixclk of
+ * TRDB_D5M_PIXCLK_HZ. 0 for an unknown mode.
+ */
+uint32_t trdb_d5m_mode_fps(uint32_t mode){
+	if (mode >= TRDB_D5M_MODES) {
+		return 0;
+	}
 
-	    bool success = true;
+	const trdb_d5m_mode *m = &trdb_d5m_modes[mode];
+	uint32_t hblank_min = 346 * m->skip + 64 + 40 / m->skip;
+	uint32_t hblank = m->hblank > hblank_min ? m->hblank : hblank_min;
+	uint32_t vblank = m->vblank > TRDB_D5M_VBLANK_MIN ? m->vblank : TRDB_D5M_VBLANK_MIN;
+	uint32_t row_pairs = m->width / 2 + hblank;
+	uint32_t rows = m->height + vblank;
 
-	    //Reset camera
-	    //success &= trdb_d5m_write(&i2c, 16, 1);
-	    //for(int i = 0; i < 1000; i++);
-	    //success &= trdb_d5m_write(&i2c, 16, 0);
-	    //for(int i = 0; i < 100000; i++);
+	if (row_pairs < 41 + 346 * m->skip + 99) {
+		row_pairs = 41 + 346 * m->skip + 99;
+	}
+	// A longer shutter stretches the frame
+	if (rows < m->shutter + 1) {
+		rows = m->shutter + 1;
+	}
 
-	    uint16_t data = 0;
+	return (uint64_t)TRDB_D5M_PIXCLK_HZ * 100 / (2 * row_pairs * rows);
+}
 
-	    printf("Setting parameters...\n");
+/*
+ * Exposure time in rows, from the next frame on. Only the words that change
+ * are sent, usually the low one, so it can be called for every frame. A
+ * shutter longer than the frame slows the frame rate down.
+ */
+bool trdb_d5m_set_shutter(uint32_t rows){
+	const trdb_d5m_reg table[] = {
+		{TRDB_D5M_REG_SHUTTER_HI, rows >> 16},
+		{TRDB_D5M_REG_SHUTTER_LO, rows & 0xffff},
+	};
 
-	    success &= trdb_d5m_write(&i2c, 3, (uint16_t) 1919);
-	    data = 0;
-	    success &= trdb_d5m_read(&i2c, 3, &data);
-	    printf("Should be 1919: %u\n", data);
+	if (rows == 0 || rows > 0xfffff) {
+		return false;
+	}
 
-	    success &= trdb_d5m_write(&i2c, 4, (uint16_t)2559);
+	return trdb_d5m_write_table(table, TRDB_D5M_TABLE_SIZE(table));
+}
 
-	    success &= trdb_d5m_write(&i2c, 34, 0x0033);
-		success &= trdb_d5m_write(&i2c, 35, 0x0033);
+/*
+ * Switch the sensor to one of the TRDB_D5M_MODE_* presets and capture its
+ * whole output, the frame written to memory being half its size in each
+ * direction. Refused when that frame, in the current format, does not fit
+ * in the buffers, see trdb_d5m_set_geometry(). The mode and the geometry are
+ * left unchanged when the sensor cannot be programmed. Must be called while
+ * the camera is idle.
+ */
+bool trdb_d5m_set_mode(uint32_t mode){
+	trdb_d5m_reg table[TRDB_D5M_MODE_REGS];
 
-		success &= trdb_d5m_write(&i2c, 160, (0<<3) + 0);
-		success &= trdb_d5m_write(&i2c, 161, 4095 );
-		success &= trdb_d5m_write(&i2c, 162, 4095 );
-		success &= trdb_d5m_write(&i2c, 163, 4095 );
+	if (mode >= TRDB_D5M_MODES) {
+		return false;
+	}
 
-		// Set snapshot
-		success &= trdb_d5m_write(&i2c, 30, 1 << 8);
+	const trdb_d5m_mode *m = &trdb_d5m_modes[mode];
+	uint32_t fps = trdb_d5m_mode_fps(mode);
+	uint32_t width = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_WIDTH);
+	uint32_t height = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_HEIGHT);
+	uint32_t roi_x = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_ROI_X);
+	uint32_t roi_y = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_ROI_Y);
 
-		success &= trdb_d5m_write(&i2c, 11, 1);
-		printf("Restarting camera\n");
+	if (!trdb_d5m_set_geometry(m->width, m->height, 0, 0)) {
+		return false;
+	}
+
+	// Only the registers that differ from the current mode are sent
+	if (!trdb_d5m_write_table(table, trdb_d5m_mode_table(m, table))) {
+		trdb_d5m_set_geometry(width, height, roi_x, roi_y);
+		return false;
+	}
 
-		return success;
+	sensor_mode = mode;
+	printf("Sensor mode %s, %" PRIu32 ".%02" PRIu32 " fps\n", m->name, fps / 100, fps % 100);
+	return true;
 }
 
 void trdb_d5m_start_acq(uint32_t address){
-	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, 4, address);
-	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, 0, 1);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_ADDRESS, address);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_CTRL, CAMERA_CTRL_START);
 }
 
 void trdb_d5m_wait_end(void){
-	while(IORD_32DIRECT(CAMERA_MODULE_0_BASE, 0) != 0){
+	while(IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_CTRL) & CAMERA_STAT_BUSY){
 			//printf("Waiting...\n");
 	}
 }
 
+/*
+ * Program the frame buffers the DMA cycles through in streaming mode, each
+ * of size bytes. They must hold trdb_d5m_frame_size(), so the geometry and
+ * format are set first. A count of 0 falls back to the single shot mode of
+ * trdb_d5m_start_acq(). Must be called while the camera is idle.
+ */
+bool trdb_d5m_ring_setup(const uint32_t *addresses, uint32_t count, uint32_t size){
+	if (count > CAMERA_RING_MAX || (count != 0 && size < trdb_d5m_frame_size())) {
+		return false;
+	}
+
+	// The buffers are no longer managed by a frame queue
+	frame_queue = NULL;
+
+	for (uint32_t i = 0; i < count; i++) {
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_RING_ADDR(i), addresses[i]);
+	}
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_RING_SIZE, count);
+	ring_buffer_size = count ? size : 0;
+
+	return true;
+}
+
+void trdb_d5m_start_stream(void){
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_CTRL, CAMERA_CTRL_START);
+}
+
+// The frame in progress is still completed, use trdb_d5m_wait_end() to wait for it
+void trdb_d5m_stop_stream(void){
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_CTRL, CAMERA_CTRL_STOP);
+}
+
+/*
+ * Switch between snapshot mode, where each frame is triggered by the camera
+ * module, and video mode, where the sensor runs free and the camera module
+ * locks onto the next frame start. Must be called while the camera is idle.
+ */
+bool trdb_d5m_set_video_mode(bool enable){
+	bool success = true;
+	uint32_t mode = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MODE) & ~CAMERA_MODE_VIDEO;
+
+	success &= trdb_d5m_write(&i2c, TRDB_D5M_REG_READ_MODE, enable ? 0 : TRDB_D5M_SNAPSHOT);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MODE, enable ? mode | CAMERA_MODE_VIDEO : mode);
+	success &= trdb_d5m_write(&i2c, TRDB_D5M_REG_RESTART, 1);
+
+	return success;
+}
+
+/*
+ * Send the frames straight to the LCD controller instead of memory. Once
+ * started, frames are streamed until trdb_d5m_stop_stream(), the ring and
+ * address registers are left unused. The LCD expects RGB565 frames of its own
+ * size, 320x240, and must be switched to its stream input with lcd_stream()
+ * before the camera is started. Must be called while the camera is idle.
+ */
+bool trdb_d5m_set_preview(bool enable){
+	uint32_t mode = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MODE) & ~CAMERA_MODE_PREVIEW;
+
+	if (enable && IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FORMAT) != CAMERA_FORMAT_RGB565) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MODE, enable ? mode | CAMERA_MODE_PREVIEW : mode);
+	return true;
+}
+
+/*
+ * Hand every completed frame to the LCD controller, which reads it from memory
+ * while the DMA fills the next buffer. The LCD side is set up by lcd_trigger().
+ * The ring skips the buffer being displayed and frames completed meanwhile are
+ * not displayed, so the ring needs at least two buffers. Not for use with a
+ * frame queue, which relies on the ring order. Must be called while the camera
+ * is idle.
+ */
+void trdb_d5m_set_handoff(bool enable){
+	uint32_t mode = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MODE) & ~CAMERA_MODE_HANDOFF;
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MODE, enable ? mode | CAMERA_MODE_HANDOFF : mode);
+}
+
+// The frame of the current window, scale and format fits in the buffers
+static bool trdb_d5m_frame_fits(void){
+	uint32_t size = trdb_d5m_frame_size();
+
+	return (ring_buffer_size == 0 || size <= ring_buffer_size) && (frame_span == 0 || size <= frame_span);
+}
+
+/*
+ * Select the window captured by the camera module, in sensor output pixels.
+ * The frame written to memory is (width/2)x(height/2) RGB565 pixels, so the
+ * width is a multiple of 4 and at most CAMERA_WIDTH_MAX, the height at most
+ * CAMERA_HEIGHT_MAX. Every format of such a window fits in
+ * CAMERA_FRAME_WORDS_MAX, the frames the DMA writes whole, but a window
+ * whose frame exceeds the buffers of trdb_d5m_ring_setup() or the span of
+ * trdb_d5m_set_frame_count() is refused and the previous one kept.
+ * Must be called while the camera is idle.
+ */
+bool trdb_d5m_set_geometry(uint32_t width, uint32_t height, uint32_t roi_x, uint32_t roi_y){
+	uint32_t old_width = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_WIDTH);
+	uint32_t old_height = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_HEIGHT);
+	uint32_t old_roi_x = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_ROI_X);
+	uint32_t old_roi_y = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_ROI_Y);
+
+	if ((width & 3) || ((height | roi_x | roi_y) & 1)) {
+		return false;
+	}
+	if (width == 0 || height == 0 || width > CAMERA_WIDTH_MAX || height > CAMERA_HEIGHT_MAX) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_WIDTH, width);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_HEIGHT, height);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_ROI_X, roi_x);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_ROI_Y, roi_y);
+
+	if (!trdb_d5m_frame_fits()) {
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_WIDTH, old_width);
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_HEIGHT, old_height);
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_ROI_X, old_roi_x);
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_ROI_Y, old_roi_y);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Shrink the sensor readout to a region of interest, in sensor output pixels
+ * relative to the window of the current mode. Fewer rows read out means a
+ * higher frame rate, and the camera module captures the whole reduced window.
+ */
+bool trdb_d5m_set_roi(uint32_t width, uint32_t height, uint32_t roi_x, uint32_t roi_y){
+	const trdb_d5m_mode *m = &trdb_d5m_modes[sensor_mode];
+	bool success = true;
+
+	if (!trdb_d5m_set_geometry(width, height, 0, 0)) {
+		return false;
+	}
+
+	const trdb_d5m_reg table[] = {
+		{TRDB_D5M_REG_ROW_START, m->row_start + roi_y * m->skip},
+		{TRDB_D5M_REG_COL_START, m->col_start + roi_x * m->skip},
+		{TRDB_D5M_REG_ROW_SIZE, height * m->skip - 1},
+		{TRDB_D5M_REG_COL_SIZE, width * m->skip - 1},
+		{TRDB_D5M_REG_RESTART, 1},
+	};
+
+	success &= trdb_d5m_write_table(table, TRDB_D5M_TABLE_SIZE(table));
+
+	return success;
+}
+
+/*
+ * Decimate the output by 2^scale in each direction, on top of the window set
+ * by trdb_d5m_set_geometry(). Every line must keep an even number of pixels
+ * and every frame whole groups of lines, and the frame must fit in the
+ * buffers.
+ */
+bool trdb_d5m_set_scale(uint32_t scale){
+	uint32_t width = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_WIDTH);
+	uint32_t height = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_HEIGHT);
+	uint32_t old_scale = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_SCALE);
+
+	if (scale > CAMERA_SCALE_QUARTER) {
+		return false;
+	}
+	if (width % (4 << scale) != 0 || height % (2 << scale) != 0) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_SCALE, scale);
+	if (!trdb_d5m_frame_fits()) {
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_SCALE, old_scale);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Select the pixel format written to memory. GRAY8 packs four pixels per
+ * word, so the scaled frame must hold a multiple of four pixels. RICE
+ * compresses the RGB565 frame, its length is given by trdb_d5m_rice_length()
+ * and it is read back with trdb_d5m_rice_decode(). A compressed frame can take
+ * up to 7/4 of the RGB565 one, the size of the buffers given by
+ * trdb_d5m_frame_size(). YUV422 is converted from
+ * the 8-bit components before RGB565 truncation, its Y is the GRAY8
+ * luminance with the default matrix, see trdb_d5m_set_yuv(). A format whose
+ * frame does not fit in the buffers is refused, RAW12 of the 640x480 mode
+ * takes four times the RGB565 frame.
+ */
+bool trdb_d5m_set_format(uint32_t format){
+	uint32_t width = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_WIDTH);
+	uint32_t height = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_HEIGHT);
+	uint32_t scale = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_SCALE);
+	uint32_t old_format = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FORMAT);
+
+	if (format > CAMERA_FORMAT_YUV422) {
+		return false;
+	}
+	if (format == CAMERA_FORMAT_GRAY8 && ((width / 2) >> scale) * ((height / 2) >> scale) % 4 != 0) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FORMAT, format);
+	if (!trdb_d5m_frame_fits()) {
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FORMAT, old_format);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Select the conversion of CAMERA_FORMAT_YUV422, a combination of the
+ * CAMERA_YUV_* flags. Must be called while the camera is idle.
+ */
+bool trdb_d5m_set_yuv(uint32_t flags){
+	if (flags & ~(CAMERA_YUV_STUDIO | CAMERA_YUV_BT709)) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_YUV, flags);
+	return true;
+}
+
+/*
+ * Select the 3x3 convolution applied to the scaled frame, one of the
+ * CAMERA_CONV_* modes. The result is shifted right by shift and saturated to
+ * 255. k0 and k1 hold 9 coefficients row by row from the top left one, NULL
+ * keeps the kernel in place. The border pixels are written as 0. Not applied
+ * to CAMERA_FORMAT_RAW12. Must be called while the camera is idle.
+ */
+bool trdb_d5m_set_conv(uint32_t mode, uint32_t shift, const int8_t *k0, const int8_t *k1){
+	uint32_t width = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_WIDTH);
+	uint32_t scale = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_SCALE);
+	const int8_t *kernels[2] = {k0, k1};
+	uint32_t k, row, i;
+
+	if (mode > CAMERA_CONV_GRADIENT || shift > CAMERA_CONV_SHIFT_MAX) {
+		return false;
+	}
+
+	if (mode != CAMERA_CONV_OFF && ((width / 2) >> scale) > CAMERA_CONV_WIDTH_MAX) {
+		return false;
+	}
+
+	for (k = 0; k < 2; k++) {
+		if (kernels[k] == NULL) {
+			continue;
+		}
+
+		for (row = 0; row < 3; row++) {
+			uint32_t value = 0;
+
+			for (i = 0; i < 3; i++) {
+				value |= (uint32_t)(uint8_t)kernels[k][3 * row + i] << (8 * i);
+			}
+
+			IOWR_32DIRECT(CAMERA_MODULE_0_BASE, k == 0 ? CAMERA_REG_CONV_K0(row) : CAMERA_REG_CONV_K1(row), value);
+		}
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_CONV, (shift << 8) | mode);
+	return true;
+}
+
+/*
+ * Configure the DMA bursts towards memory. burst_length is in 32-bit words,
+ * up to CAMERA_DMA_BURST_MAX, 0 selecting the longest. A burst starts once
+ * fifo_threshold words are buffered, 0 waiting for a whole burst; a lower
+ * threshold cuts latency at the cost of bursts that may stall on the FIFO.
+ * It must be 0 when a stage placed on the pixel stream shortens the frames,
+ * the last burst of a frame would otherwise wait for the next one.
+ */
+bool trdb_d5m_set_dma(uint32_t burst_length, uint32_t fifo_threshold){
+	if (burst_length > CAMERA_DMA_BURST_MAX || fifo_threshold > CAMERA_DMA_BURST_MAX) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_BURST_LENGTH, burst_length);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FIFO_THRESHOLD, fifo_threshold);
+
+	return true;
+}
+
+/*
+ * Place each output line stride bytes after the previous one, so a frame can
+ * be written into a window of a larger buffer. The line length follows the
+ * current geometry, scale and format, set them first. A stride of 0 writes
+ * the frame as one block again. Must be called while the camera is idle.
+ */
+bool trdb_d5m_set_stride(uint32_t stride){
+	uint32_t width = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_WIDTH);
+	uint32_t scale = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_SCALE);
+	uint32_t format = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FORMAT);
+	uint32_t line_bytes;
+
+	if (format == CAMERA_FORMAT_RAW12) {
+		line_bytes = width * 2;
+	} else if (format == CAMERA_FORMAT_GRAY8) {
+		line_bytes = (width / 2) >> scale;
+	} else {
+		line_bytes = ((width / 2) >> scale) * 2;
+	}
+
+	if (stride == 0) {
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_LINE_LENGTH, 0);
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_STRIDE, 0);
+		return true;
+	}
+	if (format == CAMERA_FORMAT_RICE || stride % 4 != 0 || line_bytes % 4 != 0 || stride < line_bytes) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_LINE_LENGTH, line_bytes / 4);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_STRIDE, stride);
+	return true;
+}
+
+/*
+ * Capture count frames from each start command. Without a ring the frames
+ * are written span bytes apart from the address of trdb_d5m_start_acq(), a
+ * span of 0 places them back to back. A count of 0 takes one frame, or runs a
+ * ring or the preview until stopped. A dropped frame of the run, the last one
+ * included, is taken again. Must be called while the camera is idle.
+ */
+bool trdb_d5m_set_frame_count(uint32_t count, uint32_t span){
+	if (span % 4 != 0 || (span != 0 && span < trdb_d5m_frame_size())) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FRAME_SPAN, span);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FRAME_COUNT, count);
+	frame_span = span;
+	return true;
+}
+
+/*
+ * Rice parameter of the compressed format, 0 to 3. Small values suit smooth
+ * images, large ones noisy images. Must be called while the camera is idle.
+ */
+bool trdb_d5m_set_rice(uint32_t k){
+	if (k > CAMERA_RICE_K_MAX) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_RICE_K, k);
+	return true;
+}
+
+/*
+ * Size in bytes of the last frame written to memory. Below
+ * trdb_d5m_frame_size() for a compressed frame, or one shortened by a stage
+ * placed on the pixel stream.
+ */
+uint32_t trdb_d5m_rice_length(void){
+	return IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_RICE_LENGTH) * sizeof(uint32_t);
+}
+
+/*
+ * Size in bytes of the frames currently written to memory, the size every
+ * buffer must hold. For CAMERA_FORMAT_RICE the largest compressed frame.
+ */
+uint32_t trdb_d5m_frame_size(void){
+	return IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FRAME_LENGTH) * sizeof(uint32_t);
+}
+
+// Number of frames completed since the last start command
+uint32_t trdb_d5m_frame_sequence(void){
+	return IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_FRAME_SEQ);
+}
+
+/*
+ * Frames discarded since the last start because end_fifo overflowed. A dropped
+ * frame never completes, so the ring keeps the last good buffer.
+ */
+uint32_t trdb_d5m_frames_dropped(void){
+	return IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_DROPPED);
+}
+
+int trdb_d5m_ring_write_index(void){
+	return IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_RING_WRITE_IDX);
+}
+
+// Index of the last completely written buffer, -1 if no frame completed yet
+int trdb_d5m_ring_last_index(void){
+	uint32_t last = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_RING_LAST_IDX);
+
+	if (!(last & CAMERA_RING_LAST_VALID)) {
+		return -1;
+	}
+	return last & ~CAMERA_RING_LAST_VALID;
+}
+
+/*
+ * Queue the frame completed in a ring slot and give the slot a buffer nobody
+ * else owns. When the application holds all the others, the oldest queued
+ * frame is given back to the camera and lost.
+ */
+static void trdb_d5m_queue_complete(trdb_d5m_queue *queue, uint32_t slot, uint32_t seq){
+	uint32_t done = queue->slots[slot];
+	trdb_d5m_frame *frame = &queue->frames[done];
+	uint32_t next;
+
+	frame->seq = seq;
+	frame->address = queue->addresses[done];
+	frame->size = trdb_d5m_rice_length();
+	frame->status = queue->gap ? TRDB_D5M_FRAME_GAP : TRDB_D5M_FRAME_OK;
+	frame->buffer = done;
+	queue->gap = false;
+
+	queue->ready[(queue->ready_head + queue->ready_level) % queue->count] = done;
+	queue->ready_level++;
+	queue->state[done] = QUEUE_READY;
+
+	for (next = 0; next < queue->count && queue->state[next] != QUEUE_FREE; next++) {
+	}
+	if (next == queue->count) {
+		next = queue->ready[queue->ready_head];
+		queue->ready_head = (queue->ready_head + 1) % queue->count;
+		queue->ready_level--;
+		queue->lost++;
+		queue->gap = true;
+	}
+
+	queue->state[next] = QUEUE_CAMERA;
+	queue->slots[slot] = next;
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_RING_ADDR(slot), queue->addresses[next]);
+}
+
+/*
+ * Runs in interrupt context, a late interrupt may cover several frames. Only
+ * the slots up to the last one written are completed: the slot after it is
+ * being written, so a frame older than the other slots is lost and the next
+ * one is marked as following a gap.
+ */
+static void trdb_d5m_queue_done(trdb_d5m_queue *queue){
+	uint32_t seq;
+	uint32_t dropped = trdb_d5m_frames_dropped();
+	int last;
+	int write;
+	uint32_t done;
+
+	// A frame completing between the reads moves all of them, read again
+	do {
+		seq = trdb_d5m_frame_sequence();
+		last = trdb_d5m_ring_last_index();
+		write = trdb_d5m_ring_write_index();
+	} while (seq != trdb_d5m_frame_sequence());
+
+	done = seq - queue->seq;
+	if (last < 0 || done == 0) {
+		return;
+	}
+
+	if (dropped != queue->dropped) {
+		queue->dropped = dropped;
+		queue->gap = true;
+	}
+	if (done > TRDB_D5M_QUEUE_SLOTS - 1) {
+		queue->gap = true;
+		done = TRDB_D5M_QUEUE_SLOTS - 1;
+	}
+
+	for (uint32_t i = done; i > 0; i--) {
+		uint32_t slot = (last + TRDB_D5M_QUEUE_SLOTS - (i - 1)) % TRDB_D5M_QUEUE_SLOTS;
+
+		if ((int)slot == write) {
+			queue->gap = true;
+			continue;
+		}
+		trdb_d5m_queue_complete(queue, slot, seq - (i - 1));
+	}
+	queue->seq = seq;
+}
+
+static void trdb_d5m_isr(void *context){
+	uint32_t status = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_IRQ_STATUS);
+
+	// Acknowledge before handling so a frame completing meanwhile is not lost
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_IRQ_STATUS, status);
+
+	if (status & CAMERA_IRQ_FRAME_DONE) {
+		if (frame_queue) {
+			trdb_d5m_queue_done(frame_queue);
+		}
+		frames_pending++;
+		if (frame_callback) {
+			frame_callback(frame_callback_context);
+		}
+	}
+}
+
+/*
+ * Register the frame completion interrupt. The callback (may be NULL) runs in
+ * interrupt context each time a frame has been fully written to memory.
+ */
+bool trdb_d5m_irq_init(trdb_d5m_frame_cb callback, void *context){
+	frame_callback = callback;
+	frame_callback_context = context;
+	frames_pending = 0;
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_IRQ_STATUS, CAMERA_IRQ_FRAME_DONE);
+
+	if (alt_ic_isr_register(CAMERA_MODULE_0_IRQ_INTERRUPT_CONTROLLER_ID, CAMERA_MODULE_0_IRQ,
+			trdb_d5m_isr, NULL, NULL) != 0) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_IRQ_ENABLE, CAMERA_IRQ_FRAME_DONE);
+	return true;
+}
+
+// Non-blocking: consume one completed frame if there is one
+bool trdb_d5m_frame_ready(void){
+	bool ready = false;
+	alt_irq_context irq_context = alt_irq_disable_all();
+
+	if (frames_pending) {
+		frames_pending--;
+		ready = true;
+	}
+
+	alt_irq_enable_all(irq_context);
+	return ready;
+}
+
+// Wait for a completed frame without touching the camera registers
+void trdb_d5m_wait_frame(void){
+	while (!trdb_d5m_frame_ready()) {
+	}
+}
+
+/*
+ * Set up a queue of count frame buffers, 3 to TRDB_D5M_QUEUE_MAX, each of
+ * size bytes, see trdb_d5m_ring_setup(). The camera streams into TRDB_D5M_QUEUE_SLOTS of them
+ * while the application holds the others, a completed buffer being swapped
+ * for a free one by the interrupt handler, so trdb_d5m_irq_init() must have
+ * been called. Replaces trdb_d5m_ring_setup(). Must be called while the
+ * camera is idle.
+ */
+bool trdb_d5m_queue_init(trdb_d5m_queue *queue, const uint32_t *addresses, uint32_t count, uint32_t size){
+	if (count <= TRDB_D5M_QUEUE_SLOTS || count > TRDB_D5M_QUEUE_MAX) {
+		return false;
+	}
+
+	if (!trdb_d5m_ring_setup(addresses, TRDB_D5M_QUEUE_SLOTS, size)) {
+		return false;
+	}
+
+	queue->count = count;
+	for (uint32_t i = 0; i < count; i++) {
+		queue->addresses[i] = addresses[i];
+	}
+	return true;
+}
+
+// Give every buffer back to the camera and start streaming into the queue
+void trdb_d5m_queue_start(trdb_d5m_queue *queue){
+	alt_irq_context irq_context = alt_irq_disable_all();
+
+	for (uint32_t i = 0; i < queue->count; i++) {
+		queue->state[i] = i < TRDB_D5M_QUEUE_SLOTS ? QUEUE_CAMERA : QUEUE_FREE;
+	}
+	for (uint32_t i = 0; i < TRDB_D5M_QUEUE_SLOTS; i++) {
+		queue->slots[i] = i;
+		IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_RING_ADDR(i), queue->addresses[i]);
+	}
+	queue->ready_head = 0;
+	queue->ready_level = 0;
+	queue->seq = 0;
+	queue->dropped = 0;
+	queue->lost = 0;
+	queue->gap = false;
+	frame_queue = queue;
+
+	trdb_d5m_start_stream();
+	alt_irq_enable_all(irq_context);
+}
+
+/*
+ * Non-blocking: take the oldest completed frame, false if there is none. The
+ * buffer is not written by the camera until trdb_d5m_queue_release().
+ */
+bool trdb_d5m_queue_try_dequeue(trdb_d5m_queue *queue, trdb_d5m_frame *frame){
+	bool ready = false;
+	alt_irq_context irq_context = alt_irq_disable_all();
+
+	if (queue->ready_level) {
+		uint32_t buffer = queue->ready[queue->ready_head];
+
+		queue->ready_head = (queue->ready_head + 1) % queue->count;
+		queue->ready_level--;
+		queue->state[buffer] = QUEUE_HELD;
+		*frame = queue->frames[buffer];
+		ready = true;
+	}
+
+	alt_irq_enable_all(irq_context);
+	return ready;
+}
+
+void trdb_d5m_queue_dequeue(trdb_d5m_queue *queue, trdb_d5m_frame *frame){
+	while (!trdb_d5m_queue_try_dequeue(queue, frame)) {
+	}
+}
+
+// Hand the buffer of a dequeued frame back to the camera
+void trdb_d5m_queue_release(trdb_d5m_queue *queue, const trdb_d5m_frame *frame){
+	alt_irq_context irq_context = alt_irq_disable_all();
+
+	if (frame->buffer < queue->count && queue->state[frame->buffer] == QUEUE_HELD) {
+		queue->state[frame->buffer] = QUEUE_FREE;
+	}
+
+	alt_irq_enable_all(irq_context);
+}
+
+// Completed frames given back to the camera before being dequeued
+uint32_t trdb_d5m_queue_lost(trdb_d5m_queue *queue){
+	return queue->lost;
+}
+
+/*
+ * Snapshot the performance counters and read them back. With clear set, the
+ * counters restart from zero in the same write, so consecutive reads cover
+ * back to back intervals.
+ */
+void trdb_d5m_perf_read(trdb_d5m_perf *perf, bool clear){
+	uint32_t ctrl = CAMERA_PERF_SNAPSHOT;
+
+	if (clear) {
+		ctrl |= CAMERA_PERF_CLEAR;
+	}
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_PERF_CTRL, ctrl);
+
+	perf->frames_started = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_PERF_STARTED);
+	perf->frames_done = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_PERF_DONE);
+	perf->fifo_overflows = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_PERF_OVERFLOW);
+	perf->fifo_peak = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_PERF_FIFO_PEAK);
+	perf->dma_stall_cycles = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_PERF_STALL);
+	perf->frame_cycles = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_PERF_CYCLES);
+}
+
+/*
+ * Read the statistics of the last complete frame, false if no frame has been
+ * captured yet. The block is updated when a frame ends, independently of the
+ * bus, so it is read again if a new frame was published meanwhile.
+ */
+bool trdb_d5m_stats_read(trdb_d5m_stats *stats){
+	uint32_t seq;
+	int i;
+
+	do {
+		seq = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_STATS_SEQ);
+		stats->pixels = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_STATS_PIXELS);
+		stats->sum_r = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_STATS_SUM_R);
+		stats->sum_g = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_STATS_SUM_G);
+		stats->sum_b = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_STATS_SUM_B);
+		for (i = 0; i < CAMERA_STATS_BINS; i++) {
+			stats->hist[i] = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_STATS_HIST(i));
+		}
+		stats->seq = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_STATS_SEQ);
+	} while (stats->seq != seq);
+
+	return stats->seq != 0;
+}
+
+/*
+ * Compare each frame written with the previous one. A tile is set in the map
+ * when the sum of its luminance differences is above threshold. Frames must
+ * be packed (no stride) and keep the same size, in RGB565, GRAY8 or YUV422.
+ * The previous frame is read back from memory by the camera while the new
+ * one is written, also when both share a buffer.
+ */
+bool trdb_d5m_set_motion(bool enable, uint32_t threshold){
+	if (threshold > CAMERA_MOTION_THRESHOLD_MAX) {
+		return false;
+	}
+
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MOTION_THRESHOLD, threshold);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MOTION_CTRL, enable ? 1 : 0);
+	return true;
+}
+
+/*
+ * Read the motion of the last frame compared, false if none was yet. Read
+ * again if a new result was published meanwhile, as trdb_d5m_stats_read().
+ */
+bool trdb_d5m_motion_read(trdb_d5m_motion *motion){
+	uint32_t seq;
+	int i;
+
+	do {
+		seq = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MOTION_SEQ);
+		motion->score = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MOTION_SCORE);
+		motion->changed = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MOTION_CHANGED);
+		for (i = 0; i < CAMERA_MOTION_TILES_Y; i++) {
+			motion->map[i] = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MOTION_MAP(i));
+		}
+		motion->seq = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MOTION_SEQ);
+	} while (motion->seq != seq);
+
+	return motion->seq != 0;
+}
+
+// Frames that were dropped or could not be compared while motion was enabled
+uint32_t trdb_d5m_motion_skipped(void){
+	return IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_MOTION_SKIPPED);
+}
+
+static uint64_t trdb_d5m_read64(uint32_t lo_reg, uint32_t hi_reg){
+	uint32_t lo = IORD_32DIRECT(CAMERA_MODULE_0_BASE, lo_reg);
+	uint32_t hi = IORD_32DIRECT(CAMERA_MODULE_0_BASE, hi_reg);
+
+	return ((uint64_t)hi << 32) | lo;
+}
+
+// Current value of the timestamp counter, the low word read first latches the high one
+uint64_t trdb_d5m_time_now(void){
+	return trdb_d5m_read64(CAMERA_REG_TS_COUNT_LO, CAMERA_REG_TS_COUNT_HI);
+}
+
+// Records waiting in the history, new ones are lost beyond CAMERA_TS_DEPTH
+uint32_t trdb_d5m_timestamp_count(void){
+	return IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_TS_LEVEL);
+}
+
+/*
+ * Take the oldest frame record out of the history. Returns false when it is
+ * empty. done - start is the capture to memory latency, done - last_pixel the
+ * time the DMA needed to drain the frame. The record stays in place until
+ * popped, a gap in seq counts the ones lost while the history was full.
+ */
+bool trdb_d5m_timestamp_pop(trdb_d5m_timestamp *ts){
+	if (trdb_d5m_timestamp_count() == 0) {
+		return false;
+	}
+
+	ts->seq = IORD_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_TS_SEQ);
+	ts->start = trdb_d5m_read64(CAMERA_REG_TS_START_LO, CAMERA_REG_TS_START_HI);
+	ts->last_pixel = trdb_d5m_read64(CAMERA_REG_TS_LAST_LO, CAMERA_REG_TS_LAST_HI);
+	ts->done = trdb_d5m_read64(CAMERA_REG_TS_DONE_LO, CAMERA_REG_TS_DONE_HI);
+	IOWR_32DIRECT(CAMERA_MODULE_0_BASE, CAMERA_REG_TS_POP, 0);
+
+	return true;
+}
+
 void trdb_d5m_write_image(void){
 	// Write result
 		printf("Writing result\n");
@@ -109,7 +1188,7 @@ void trdb_d5m_write_image(void){
 		fprintf(foutput, "P3\n320 240 \n32\n");
 
 		uint32_t addr = HPS_0_BRIDGES_BASE;
-		for (uint32_t i = 0; i <= CAMERA_FRAME_SPAN; i += sizeof(uint32_t)) {
+		for (uint32_t i = 0; i < CAMERA_FRAME_SPAN; i += sizeof(uint32_t)) {
 			addr = HPS_0_BRIDGES_BASE + i;
 			// Read through address span expander
 			uint32_t readdata = IORD_32DIRECT(addr, 0);
@@ -129,3 +1208,79 @@ void trdb_d5m_write_image(void){
 	    }
 		printf("Done\n");
 }
+
+// RGB565 components scaled to 8 bits
+static uint8_t *trdb_d5m_put_rgb888(uint8_t *out, uint16_t pixel){
+	uint8_t r = (pixel & RED_MASK) >> 11;
+	uint8_t g = (pixel & GREEN_MASK) >> 5;
+	uint8_t b = (pixel & BLUE_MASK) >> 0;
+
+	*out++ = (r << 3) | (r >> 2);
+	*out++ = (g << 2) | (g >> 4);
+	*out++ = (b << 3) | (b >> 2);
+	return out;
+}
+
+/*
+ * Write a width x height RGB565 frame from memory to the host, as a binary
+ * P6 image or, with raw set, the RGB565 pixels as written by the camera. An
+ * index of 0 or more is added to the file name to dump a sequence. The frame
+ * is copied TRDB_D5M_DUMP_WORDS words at a time through an uncached mapping,
+ * the camera writes behind the data cache, and written one block per
+ * fwrite(), far fewer host transfers than trdb_d5m_write_image().
+ */
+bool trdb_d5m_dump_image(uint32_t address, uint32_t width, uint32_t height, bool raw, int index){
+	static uint32_t copy[TRDB_D5M_DUMP_WORDS];
+	static uint8_t block[TRDB_D5M_DUMP_WORDS * 6];
+	const uint32_t *frame;
+	const char *extension = raw ? "rgb565" : "ppm";
+	uint32_t words = width * height / 2;
+	bool success = true;
+	char filename[48];
+
+	if ((width * height) % 2 != 0) {
+		return false;
+	}
+
+	if (index < 0) {
+		snprintf(filename, sizeof(filename), "/mnt/host/image.%s", extension);
+	} else {
+		snprintf(filename, sizeof(filename), "/mnt/host/image_%04d.%s", index, extension);
+	}
+
+	FILE *foutput = fopen(filename, "wb");
+	if (!foutput) {
+		printf("Error: could not open \"%s\" for writing\n", filename);
+		return false;
+	}
+
+	if (!raw) {
+		success &= fprintf(foutput, "P6\n%" PRIu32 " %" PRIu32 "\n255\n", width, height) > 0;
+	}
+
+	// Read through address span expander
+	frame = (const uint32_t *)alt_remap_uncached((void *)(uintptr_t)address, words * sizeof(uint32_t));
+
+	for (uint32_t i = 0; i < words && success; ) {
+		uint32_t n = words - i < TRDB_D5M_DUMP_WORDS ? words - i : TRDB_D5M_DUMP_WORDS;
+
+		memcpy(copy, frame + i, n * sizeof(uint32_t));
+
+		// The words are little-endian like the file, a raw block is written as is
+		if (raw) {
+			success &= fwrite(copy, sizeof(uint32_t), n, foutput) == n;
+		} else {
+			uint8_t *out = block;
+
+			for (uint32_t j = 0; j < n; j++) {
+				out = trdb_d5m_put_rgb888(out, copy[j] & 0x0000ffffUL);
+				out = trdb_d5m_put_rgb888(out, (copy[j] & 0xffff0000UL) >> 16);
+			}
+			success &= fwrite(block, 1, out - block, foutput) == (size_t)(out - block);
+		}
+		i += n;
+	}
+
+	success &= fclose(foutput) == 0;
+	return success;
+}
@@ -8,9 +8,273 @@
 #ifndef TRDB_D5M_H_
 #define TRDB_D5M_H_
 
-bool trdb_d5m_init(void);
+// === CONSTANTS ===
+// Register Map, using byte address
+#define CAMERA_REG_CTRL				0x00
+#define CAMERA_REG_ADDRESS			0x04
+#define CAMERA_REG_FIFO				0x08
+#define CAMERA_REG_RING_SIZE		0x0C
+#define CAMERA_REG_RING_WRITE_IDX	0x10
+#define CAMERA_REG_RING_LAST_IDX	0x14
+#define CAMERA_REG_MODE				0x18
+#define CAMERA_REG_FRAME_SEQ		0x1C
+#define CAMERA_REG_RING_ADDR(i)		(0x20 + 4 * (i))
+#define CAMERA_REG_IRQ_ENABLE		0x40
+#define CAMERA_REG_IRQ_STATUS		0x44
+#define CAMERA_REG_WIDTH			0x48
+#define CAMERA_REG_HEIGHT			0x4C
+#define CAMERA_REG_ROI_X			0x50
+#define CAMERA_REG_ROI_Y			0x54
+#define CAMERA_REG_FRAME_LENGTH		0x58
+#define CAMERA_REG_BURST_LENGTH		0x5C
+#define CAMERA_REG_FIFO_THRESHOLD	0x60
+#define CAMERA_REG_PERF_CTRL		0x64
+#define CAMERA_REG_PERF_STARTED		0x68
+#define CAMERA_REG_PERF_DONE		0x6C
+#define CAMERA_REG_PERF_OVERFLOW	0x70
+#define CAMERA_REG_PERF_FIFO_PEAK	0x74
+#define CAMERA_REG_PERF_STALL		0x78
+#define CAMERA_REG_PERF_CYCLES		0x7C
+#define CAMERA_REG_DROPPED			0x80
+#define CAMERA_REG_SCALE			0x84
+#define CAMERA_REG_FORMAT			0x88
+#define CAMERA_REG_LINE_LENGTH		0x8C
+#define CAMERA_REG_STRIDE			0x90
+#define CAMERA_REG_FRAME_COUNT		0x94
+#define CAMERA_REG_FRAME_SPAN		0x98
+#define CAMERA_REG_RICE_K			0x9C
+#define CAMERA_REG_RICE_LENGTH		0xA0	// words of the last frame written
+#define CAMERA_REG_YUV				0xA4
+#define CAMERA_REG_CONV				0xA8
+#define CAMERA_REG_CONV_K0(row)		(0xAC + 4 * (row))	// 3 signed coefficients from the left one in the low byte
+#define CAMERA_REG_CONV_K1(row)		(0xB8 + 4 * (row))
+// Frame timestamp block, 64-bit values as low and high words
+#define CAMERA_REG_TS_COUNT_LO		0x100	// reading it latches COUNT_HI
+#define CAMERA_REG_TS_COUNT_HI		0x104
+#define CAMERA_REG_TS_LEVEL			0x108
+#define CAMERA_REG_TS_POP			0x10C
+#define CAMERA_REG_TS_SEQ			0x110
+#define CAMERA_REG_TS_START_LO		0x114
+#define CAMERA_REG_TS_START_HI		0x118
+#define CAMERA_REG_TS_LAST_LO		0x11C
+#define CAMERA_REG_TS_LAST_HI		0x120
+#define CAMERA_REG_TS_DONE_LO		0x124
+#define CAMERA_REG_TS_DONE_HI		0x128
+// Frame statistics block
+#define CAMERA_REG_STATS_HIST(i)	(0x200 + 4 * (i))
+#define CAMERA_REG_STATS_SEQ		0x300
+#define CAMERA_REG_STATS_PIXELS		0x304
+#define CAMERA_REG_STATS_SUM_R		0x308
+#define CAMERA_REG_STATS_SUM_G		0x30C
+#define CAMERA_REG_STATS_SUM_B		0x310
+// Motion detection block
+#define CAMERA_REG_MOTION_CTRL		0x400
+#define CAMERA_REG_MOTION_THRESHOLD	0x404
+#define CAMERA_REG_MOTION_SEQ		0x408
+#define CAMERA_REG_MOTION_SCORE		0x40C
+#define CAMERA_REG_MOTION_CHANGED	0x410
+#define CAMERA_REG_MOTION_SKIPPED	0x414
+#define CAMERA_REG_MOTION_MAP(row)	(0x440 + 4 * (row))
+
+#define CAMERA_CTRL_START			0x00000001
+#define CAMERA_CTRL_STOP			0x00000002
+#define CAMERA_STAT_BUSY			0x00000001
+#define CAMERA_STAT_STREAMING		0x00000002
+#define CAMERA_RING_LAST_VALID		0x80000000
+#define CAMERA_MODE_VIDEO			0x00000001
+#define CAMERA_MODE_PREVIEW			0x00000002	// frames go to the LCD, not memory
+#define CAMERA_MODE_HANDOFF			0x00000004	// completed frames start the LCD read
+#define CAMERA_IRQ_FRAME_DONE		0x00000001
+#define CAMERA_IRQ_FRAME_DROPPED	0x00000002
+// Output size divided by 2^scale in each direction
+#define CAMERA_SCALE_FULL			0
+#define CAMERA_SCALE_HALF			1
+#define CAMERA_SCALE_QUARTER		2
+// Pixel formats, the earliest pixel is in the low bits of a word
+#define CAMERA_FORMAT_RGB565		0	// 2 pixels per word
+#define CAMERA_FORMAT_GRAY8			1	// 4 pixels per word
+#define CAMERA_FORMAT_RAW12			2	// 2 Bayer samples per word, not scaled
+#define CAMERA_FORMAT_RICE			3	// RGB565 compressed, variable length
+#define CAMERA_FORMAT_YUV422		4	// 2 pixels per word, Y0 U Y1 V from the low byte
+// YUV422 conversion, BT.601 full range when no flag is set
+#define CAMERA_YUV_STUDIO			0x1	// Y 16-235, U and V 16-240
+#define CAMERA_YUV_BT709			0x2
+// 3x3 convolution of the luminance, written as grey pixels. The kernels
+// are the Sobel ones after reset, K0 the horizontal gradient.
+#define CAMERA_CONV_OFF				0
+#define CAMERA_CONV_K0				1	// |K0|
+#define CAMERA_CONV_GRADIENT		2	// |K0| + |K1|
+#define CAMERA_CONV_SHIFT_MAX		15
+#define CAMERA_CONV_WIDTH_MAX		1024	// scaled pixels per line
+// Rice code of the compressed format, see rice.vhd
+#define CAMERA_RICE_K_MAX			3
+#define CAMERA_RICE_ESC				4
+#define CAMERA_PERF_SNAPSHOT		0x00000001
+#define CAMERA_PERF_CLEAR			0x00000002
+
+#define CAMERA_RING_MAX				8
+#define CAMERA_WIDTH_MAX			2048	// sensor pixels per captured line
+#define CAMERA_HEIGHT_MAX			2048	// sensor lines per captured frame
+// Largest frame the DMA writes, in words, FRAME_WORDS_MAX of camera_pkg.vhd
+#define CAMERA_FRAME_WORDS_MAX		(CAMERA_WIDTH_MAX * CAMERA_HEIGHT_MAX / 2)
+#define CAMERA_STATS_BINS			64
+// Tiles of the motion map, the last row and column take what is left
+#define CAMERA_MOTION_TILES_X		20
+#define CAMERA_MOTION_TILES_Y		15
+#define CAMERA_MOTION_THRESHOLD_MAX	0xFFFFFF
+#define CAMERA_TS_DEPTH				8
+// Timestamps count cycles of the camera module clock, clk_0 in soc_system.qsys
+#define CAMERA_TS_HZ				50000000
+// burst_count parameter of camera_module_0 in soc_system.qsys
+#define CAMERA_DMA_BURST_MAX		128
+
+// Frame queue, see trdb_d5m_queue_init()
+#define TRDB_D5M_QUEUE_MAX			16	// buffers of a queue
+#define TRDB_D5M_QUEUE_SLOTS		2	// of them in the camera ring at any time
+#define TRDB_D5M_FRAME_OK			0x00000000
+#define TRDB_D5M_FRAME_GAP			0x00000001	// frames were lost just before this one
+
+// Longest run of sensor registers written in a single I2C transfer
+#define TRDB_D5M_BURST_MAX			16
+// Sensor registers held in the driver shadow
+#define TRDB_D5M_REGS				256
+// Sensor clock, XCLKIN is driven by FPGA_CLK1_50 and the sensor PLL is off
+#define TRDB_D5M_PIXCLK_HZ			50000000
+// Sensor modes, named after the frame written to memory
+#define TRDB_D5M_MODE_320X240		0	// full array, 4x binning
+#define TRDB_D5M_MODE_640X480		1	// full array, 2x binning
+#define TRDB_D5M_MODE_CROP_320X240	2	// 640x480 centre of the array
+#define TRDB_D5M_MODE_CROP_160X120	3	// 320x240 centre of the array
+#define TRDB_D5M_MODES				4
+
+typedef void (*trdb_d5m_frame_cb)(void *context);
+
+// Sensor register and the value it is programmed with
+typedef struct {
+	uint8_t reg;
+	uint16_t value;
+} trdb_d5m_reg;
+
+// Statistics of the last complete frame, on the RGB565 pixels
+typedef struct {
+	uint32_t seq;						// frames published since reset
+	uint32_t pixels;
+	uint32_t sum_r;						// R and B range 0-31, G 0-63
+	uint32_t sum_g;
+	uint32_t sum_b;
+	uint32_t hist[CAMERA_STATS_BINS];	// luminance / 4
+} trdb_d5m_stats;
+
+// Motion of the last frame compared with the one before, on the luminance
+typedef struct {
+	uint32_t seq;							// frames compared since reset
+	uint32_t score;							// sum of the absolute differences
+	uint32_t changed;						// tiles above the threshold
+	uint32_t map[CAMERA_MOTION_TILES_Y];	// one row of tiles each, left tile in bit 0
+} trdb_d5m_motion;
+
+// Times of a committed frame, in CAMERA_TS_HZ cycles
+typedef struct {
+	uint32_t seq;			// frames committed since reset
+	uint64_t start;			// frame_valid rise
+	uint64_t last_pixel;	// frame_valid fall, just after the last pixel
+	uint64_t done;			// last DMA burst committed
+} trdb_d5m_timestamp;
+
+// A frame taken out of the queue, owned by the application until released
+typedef struct {
+	uint32_t seq;		// trdb_d5m_frame_sequence() when it completed
+	uint32_t address;	// buffer holding the frame
+	uint32_t size;		// bytes written, see trdb_d5m_frame_size() and trdb_d5m_rice_length()
+	uint32_t status;	// TRDB_D5M_FRAME_* flags
+	uint32_t buffer;	// index of the buffer in the queue
+} trdb_d5m_frame;
+
+// Buffers cycled through the camera ring, filled by trdb_d5m_queue_init()
+typedef struct {
+	uint32_t count;
+	uint32_t addresses[TRDB_D5M_QUEUE_MAX];
+	uint8_t state[TRDB_D5M_QUEUE_MAX];
+	trdb_d5m_frame frames[TRDB_D5M_QUEUE_MAX];
+	// Completed buffers, oldest first
+	uint8_t ready[TRDB_D5M_QUEUE_MAX];
+	uint32_t ready_head;
+	uint32_t ready_level;
+	// Buffer in each slot of the camera ring
+	uint8_t slots[TRDB_D5M_QUEUE_SLOTS];
+	uint32_t seq;
+	uint32_t dropped;
+	uint32_t lost;
+	bool gap;
+} trdb_d5m_queue;
+
+// Capture path counters, all taken at the same instant
+typedef struct {
+	uint32_t frames_started;	// frames seen by the acquisition while armed
+	uint32_t frames_done;		// frames fully written by the DMA
+	uint32_t fifo_overflows;	// pixel writes refused by a full end_fifo
+	uint32_t fifo_peak;			// highest end_fifo level, in words
+	uint32_t dma_stall_cycles;	// cycles the DMA waited on the bridge
+	uint32_t frame_cycles;		// pixclk cycles of the last sensor frame
+} trdb_d5m_perf;
+
+bool trdb_d5m_init(bool verify);
+bool trdb_d5m_set_mode(uint32_t mode);
+uint32_t trdb_d5m_mode_fps(uint32_t mode);
+bool trdb_d5m_set_shutter(uint32_t rows);
+void trdb_d5m_shadow_invalidate(void);
+bool trdb_d5m_write_table(const trdb_d5m_reg *table, uint32_t count);
+bool trdb_d5m_verify_table(const trdb_d5m_reg *table, uint32_t count);
 void trdb_d5m_start_acq(uint32_t address);
 void trdb_d5m_wait_end(void);
 void trdb_d5m_write_image(void);
+bool trdb_d5m_dump_image(uint32_t address, uint32_t width, uint32_t height, bool raw, int index);
+
+bool trdb_d5m_ring_setup(const uint32_t *addresses, uint32_t count, uint32_t size);
+void trdb_d5m_start_stream(void);
+void trdb_d5m_stop_stream(void);
+bool trdb_d5m_set_video_mode(bool enable);
+bool trdb_d5m_set_preview(bool enable);
+void trdb_d5m_set_handoff(bool enable);
+bool trdb_d5m_set_geometry(uint32_t width, uint32_t height, uint32_t roi_x, uint32_t roi_y);
+bool trdb_d5m_set_roi(uint32_t width, uint32_t height, uint32_t roi_x, uint32_t roi_y);
+bool trdb_d5m_set_scale(uint32_t scale);
+bool trdb_d5m_set_format(uint32_t format);
+bool trdb_d5m_set_yuv(uint32_t flags);
+bool trdb_d5m_set_conv(uint32_t mode, uint32_t shift, const int8_t *k0, const int8_t *k1);
+bool trdb_d5m_set_dma(uint32_t burst_length, uint32_t fifo_threshold);
+bool trdb_d5m_set_stride(uint32_t stride);
+bool trdb_d5m_set_frame_count(uint32_t count, uint32_t span);
+bool trdb_d5m_set_rice(uint32_t k);
+uint32_t trdb_d5m_rice_length(void);
+uint32_t trdb_d5m_frame_size(void);
+uint32_t trdb_d5m_frame_sequence(void);
+uint32_t trdb_d5m_frames_dropped(void);
+int trdb_d5m_ring_write_index(void);
+int trdb_d5m_ring_last_index(void);
+
+bool trdb_d5m_irq_init(trdb_d5m_frame_cb callback, void *context);
+bool trdb_d5m_frame_ready(void);
+void trdb_d5m_wait_frame(void);
+
+bool trdb_d5m_queue_init(trdb_d5m_queue *queue, const uint32_t *addresses, uint32_t count, uint32_t size);
+void trdb_d5m_queue_start(trdb_d5m_queue *queue);
+bool trdb_d5m_queue_try_dequeue(trdb_d5m_queue *queue, trdb_d5m_frame *frame);
+void trdb_d5m_queue_dequeue(trdb_d5m_queue *queue, trdb_d5m_frame *frame);
+void trdb_d5m_queue_release(trdb_d5m_queue *queue, const trdb_d5m_frame *frame);
+uint32_t trdb_d5m_queue_lost(trdb_d5m_queue *queue);
+
+void trdb_d5m_perf_read(trdb_d5m_perf *perf, bool clear);
+bool trdb_d5m_stats_read(trdb_d5m_stats *stats);
+
+bool trdb_d5m_set_motion(bool enable, uint32_t threshold);
+bool trdb_d5m_motion_read(trdb_d5m_motion *motion);
+uint32_t trdb_d5m_motion_skipped(void);
+
+uint64_t trdb_d5m_time_now(void);
+uint32_t trdb_d5m_timestamp_count(void);
+bool trdb_d5m_timestamp_pop(trdb_d5m_timestamp *ts);
+
+int32_t trdb_d5m_rice_decode(const uint32_t *src, uint32_t words, uint16_t *dst, uint32_t pixels, uint32_t k);
 
 #endif /* TRDB_D5M_H_ */
@@ -0,0 +1,88 @@
+/*
+ * trdb_d5m_rice.c
+ *
+ * Decoder of CAMERA_FORMAT_RICE, kept apart from the driver so that it builds
+ * without the Nios II HAL.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "trdb_d5m.h"
+
+// Bits of a compressed frame, read from the low bit of each word
+typedef struct {
+	const uint32_t *src;
+	uint32_t words;
+	uint32_t pos;
+	uint64_t bits;
+	uint32_t fill;
+} rice_reader;
+
+static bool rice_take(rice_reader *r, uint32_t n, uint32_t *value){
+	if (r->fill < n && r->pos < r->words) {
+		r->bits |= (uint64_t)r->src[r->pos++] << r->fill;
+		r->fill += 32;
+	}
+	if (r->fill < n) {
+		return false;
+	}
+
+	*value = (uint32_t)(r->bits & ((1ULL << n) - 1));
+	r->bits >>= n;
+	r->fill -= n;
+	return true;
+}
+
+/*
+ * Decode a frame of pixels written in CAMERA_FORMAT_RICE with the parameter
+ * k into RGB565, see rice.vhd for the code. It does not touch the hardware
+ * and also builds on the host, see sim/rice_check.c of the camera module.
+ * The frames of a run start on a word boundary, the next one follows the
+ * returned number of words. Returns -1 when src ends before the last pixel.
+ */
+int32_t trdb_d5m_rice_decode(const uint32_t *src, uint32_t words, uint16_t *dst, uint32_t pixels, uint32_t k){
+	static const uint32_t shift[3] = {11, 5, 0};
+	static const uint32_t width[3] = {5, 6, 5};
+	rice_reader r = {src, words, 0, 0, 0};
+	uint16_t prev = 0;
+
+	for (uint32_t p = 0; p < pixels; p++) {
+		uint16_t pixel = 0;
+
+		for (int c = 0; c < 3; c++) {
+			uint32_t mask = (1u << width[c]) - 1;
+			uint32_t q = 0;
+			uint32_t bit, e, d;
+
+			while (q < CAMERA_RICE_ESC) {
+				if (!rice_take(&r, 1, &bit)) {
+					return -1;
+				}
+				if (!bit) {
+					break;
+				}
+				q++;
+			}
+			if (q == CAMERA_RICE_ESC) {
+				if (!rice_take(&r, width[c], &e)) {
+					return -1;
+				}
+			} else {
+				if (!rice_take(&r, k, &e)) {
+					return -1;
+				}
+				e |= q << k;
+			}
+
+			// Even codes are positive differences, odd ones negative
+			d = (e >> 1) ^ ((e & 1) ? mask : 0);
+			pixel |= (((prev >> shift[c]) + d) & mask) << shift[c];
+		}
+
+		dst[p] = pixel;
+		prev = pixel;
+	}
+
+	return r.pos;
+}